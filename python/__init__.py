@@ -9,3 +9,5 @@ Array=api.Array
 RecordReader=api.RecordReader
 RecordWriter=api.RecordWriter
 
+Compiler=api.Compiler
+
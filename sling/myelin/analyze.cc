@@ -20,6 +20,7 @@
 #include "sling/base/logging.h"
 #include "sling/base/types.h"
 #include "sling/file/file.h"
+#include "sling/myelin/compile-stats.h"
 #include "sling/myelin/compute.h"
 #include "sling/myelin/elf-linker.h"
 #include "sling/myelin/flow.h"
@@ -49,6 +50,7 @@ DEFINE_string(o, "", "ELF object output file for generated code");
 DEFINE_bool(gendata, false, "Output tensor data to ELF object file");
 DEFINE_bool(gpu, false, "Run kernels on GPU");
 DEFINE_bool(argmax, false, "Use argmax for predictions");
+DEFINE_bool(compile_stats, false, "Output compilation statistics");
 
 using namespace sling;
 using namespace sling::myelin;
@@ -114,10 +116,14 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  // Compilation statistics.
+  CompileStats stats;
+  CompileStats *compile_stats = FLAGS_compile_stats ? &stats : nullptr;
+
   if (!FLAGS_raw) {
     // Analyze flow.
     LOG(INFO) << "Analyzing flow";
-    flow.Analyze(library);
+    flow.Analyze(library, compile_stats);
   }
 
   // Check flow consistency.
@@ -159,11 +165,17 @@ int main(int argc, char *argv[]) {
     }
     if (FLAGS_profile) network.options().profiling = true;
     if (FLAGS_dynalloc) network.options().dynamic_allocation = true;
+    network.set_compile_stats(compile_stats);
     if (!network.Compile(flow, library)) {
       std::cout << "Compilation of flow failed\n";
       return 1;
     }
 
+    // Output compilation statistics.
+    if (FLAGS_compile_stats) {
+      std::cout << stats.ToString();
+    }
+
     // Analyze cells.
     for (Cell *cell : network.cells()) {
       if (!FLAGS_cell.empty() && FLAGS_cell != cell->name()) continue;
@@ -83,6 +83,16 @@ class Builder {
     return Op("Reshape", {x, shape});
   }
 
+  // Look up embedding vectors for indices. The pooling variants add up or
+  // average the embedding vectors for all non-negative indices.
+  Variable *Gather(Variable *M, Variable *f) { return Op("Gather", {M, f}); }
+  Variable *GatherSum(Variable *M, Variable *f) {
+    return Op("GatherSum", {M, f});
+  }
+  Variable *GatherAvg(Variable *M, Variable *f) {
+    return Op("GatherAvg", {M, f});
+  }
+
   // Return unique name for operation.
   string OpName(const string &op);
 
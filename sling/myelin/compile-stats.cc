@@ -0,0 +1,108 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/myelin/compile-stats.h"
+
+#include "sling/string/printf.h"
+
+namespace sling {
+namespace myelin {
+
+void CompileStats::AddTime(const string &phase, double us) {
+  auto f = phase_index_.find(phase);
+  if (f == phase_index_.end()) {
+    f = phase_index_.emplace(phase, phases_.size()).first;
+    phases_.emplace_back();
+    phases_.back().name = phase;
+  }
+  Phase &p = phases_[f->second];
+  p.us += us;
+  p.calls++;
+}
+
+void CompileStats::Increment(const string &counter, int64 delta) {
+  auto f = counter_index_.find(counter);
+  if (f == counter_index_.end()) {
+    f = counter_index_.emplace(counter, counters_.size()).first;
+    counters_.emplace_back();
+    counters_.back().name = counter;
+  }
+  counters_[f->second].value += delta;
+}
+
+void CompileStats::Add(const CompileStats &other) {
+  for (const Phase &phase : other.phases_) {
+    auto f = phase_index_.find(phase.name);
+    if (f == phase_index_.end()) {
+      f = phase_index_.emplace(phase.name, phases_.size()).first;
+      phases_.emplace_back();
+      phases_.back().name = phase.name;
+    }
+    Phase &p = phases_[f->second];
+    p.us += phase.us;
+    p.calls += phase.calls;
+  }
+  for (const Counter &counter : other.counters_) {
+    Increment(counter.name, counter.value);
+  }
+}
+
+const CompileStats::Phase *CompileStats::GetPhase(const string &name) const {
+  auto f = phase_index_.find(name);
+  return f == phase_index_.end() ? nullptr : &phases_[f->second];
+}
+
+const CompileStats::Counter *CompileStats::GetCounter(
+    const string &name) const {
+  auto f = counter_index_.find(name);
+  return f == counter_index_.end() ? nullptr : &counters_[f->second];
+}
+
+double CompileStats::total_us() const {
+  double total = 0.0;
+  for (const Phase &phase : phases_) total += phase.us;
+  return total;
+}
+
+void CompileStats::Clear() {
+  phases_.clear();
+  counters_.clear();
+  phase_index_.clear();
+  counter_index_.clear();
+}
+
+string CompileStats::ToString() const {
+  string str;
+  double total = total_us();
+  StringAppendF(&str, "%-28s %12s %8s %6s\n", "phase", "time (ms)", "percent",
+                "calls");
+  for (const Phase &phase : phases_) {
+    double percent = total > 0 ? phase.us / total * 100.0 : 0.0;
+    StringAppendF(&str, "%-28s %12.3f %7.2f%% %6d\n",
+                  phase.name.c_str(), phase.us / 1000.0, percent, phase.calls);
+  }
+  StringAppendF(&str, "%-28s %12.3f\n", "total", total / 1000.0);
+  if (!counters_.empty()) {
+    str.append("\n");
+    StringAppendF(&str, "%-28s %12s\n", "counter", "value");
+    for (const Counter &counter : counters_) {
+      StringAppendF(&str, "%-28s %12lld\n", counter.name.c_str(),
+                    counter.value);
+    }
+  }
+  return str;
+}
+
+}  // namespace myelin
+}  // namespace sling
@@ -0,0 +1,108 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_MYELIN_COMPILE_STATS_H_
+#define SLING_MYELIN_COMPILE_STATS_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/types.h"
+
+namespace sling {
+namespace myelin {
+
+// Compilation statistics with the time spent in each phase of analyzing and
+// compiling a flow together with counters for the work done in the phases.
+// Phases and counters are reported in the order they were first recorded.
+// The statistics are not thread-safe, so threads compiling in parallel must
+// collect their statistics separately.
+class CompileStats {
+ public:
+  // Time spent in compilation phase.
+  struct Phase {
+    string name;          // phase name
+    double us = 0.0;      // accumulated time in microseconds
+    int calls = 0;        // number of times phase has been run
+  };
+
+  // Counter for compilation.
+  struct Counter {
+    string name;          // counter name
+    int64 value = 0;      // counter value
+  };
+
+  // Timer for measuring the time of consecutive compilation phases. The timer
+  // does nothing if there is no stats object.
+  class Timer {
+   public:
+    explicit Timer(CompileStats *stats) : stats_(stats) {
+      if (stats_ != nullptr) clock_.start();
+    }
+
+    // Add the time since the timer was started or last marked to the phase.
+    void Mark(const string &phase) {
+      if (stats_ == nullptr) return;
+      clock_.stop();
+      stats_->AddTime(phase, clock_.us());
+      clock_.start();
+    }
+
+   private:
+    CompileStats *stats_;
+    Clock clock_;
+  };
+
+  // Add time to compilation phase.
+  void AddTime(const string &phase, double us);
+
+  // Add value to counter.
+  void Increment(const string &counter, int64 delta = 1);
+
+  // Add phases and counters from other statistics.
+  void Add(const CompileStats &other);
+
+  // Return phase or counter. Returns null if it has not been recorded.
+  const Phase *GetPhase(const string &name) const;
+  const Counter *GetCounter(const string &name) const;
+
+  // Total time for all phases in microseconds.
+  double total_us() const;
+
+  // Clear all phases and counters.
+  void Clear();
+
+  // Return report with compilation statistics.
+  string ToString() const;
+
+  // Phases and counters.
+  const std::vector<Phase> &phases() const { return phases_; }
+  const std::vector<Counter> &counters() const { return counters_; }
+
+ private:
+  // Compilation phases and counters in recording order.
+  std::vector<Phase> phases_;
+  std::vector<Counter> counters_;
+
+  // Mapping from names to indices in phase and counter lists.
+  std::unordered_map<string, int> phase_index_;
+  std::unordered_map<string, int> counter_index_;
+};
+
+}  // namespace myelin
+}  // namespace sling
+
+#endif  // SLING_MYELIN_COMPILE_STATS_H_
@@ -16,14 +16,18 @@
 
 #include <stdlib.h>
 #include <algorithm>
+#include <atomic>
 #include <list>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 #include "sling/base/logging.h"
 #include "sling/base/types.h"
 #include "sling/file/file.h"
 #include "sling/myelin/macro-assembler.h"
+#include "sling/myelin/memory-pool.h"
+#include "sling/myelin/numa.h"
 #include "sling/string/printf.h"
 
 namespace sling {
@@ -53,6 +57,10 @@ const char *placename[] = {
   "nowhere", "host", "device", "host and device"
 };
 
+// Minimum size of constants placed on NUMA nodes. Smaller constants are not
+// worth padding to whole pages.
+static const size_t kNumaMinSize = 64 * 1024;
+
 static int LeastCommonMultiple(int n, int m) {
   int a = n;
   int b = m;
@@ -97,13 +105,13 @@ static void MemFree(char *data) {
 class BasicRuntime : public Runtime {
  public:
   void AllocateInstance(Instance *instance) override {
-    char *data = MemAlloc(instance->size(), instance->alignment());
+    char *data = MemoryPool::Allocate(instance->size(), instance->alignment());
     memset(data, 0, instance->size());
     instance->set_data(data);
   }
 
   void FreeInstance(Instance *instance) override {
-    MemFree(instance->data());
+    MemoryPool::Free(instance->data());
   }
 
   void ClearInstance(Instance *instance) override {
@@ -112,12 +120,7 @@ class BasicRuntime : public Runtime {
 
   char *AllocateChannel(char *data, size_t old_size, size_t new_size,
                         size_t alignment, Placement placement) override {
-    char *buffer = MemAlloc(new_size, alignment);
-    if (data != nullptr) {
-      memcpy(buffer, data, old_size);
-      MemFree(data);
-    }
-    return buffer;
+    return MemoryPool::Reallocate(data, old_size, new_size, alignment);
   }
 
   void ClearChannel(char *data, size_t pos, size_t size,
@@ -126,7 +129,7 @@ class BasicRuntime : public Runtime {
   }
 
   void FreeChannel(char *data, Placement placement) override {
-    MemFree(data);
+    MemoryPool::Free(data);
   }
 
   bool SupportsAsync() override {
@@ -161,6 +164,8 @@ class JITLinker : public Linker {
     // Allocate executable code object in memory.
     code->Allocate(generator);
   }
+
+  bool ThreadSafe() override { return true; }
 };
 
 static JITLinker jit_linker;
@@ -610,6 +615,12 @@ ProfileSummary::~ProfileSummary() {
   delete [] data_;
 }
 
+void ProfileSummary::Add(const ProfileSummary &other) {
+  CHECK(other.cell_ == cell_);
+  int size = cell_->profile()->elements();
+  for (int i = 0; i < size; ++i) data_[i] += other.data_[i];
+}
+
 Instance::Instance(const Cell *cell) : cell_(cell) {
   cell_->runtime()->AllocateInstance(this);
 }
@@ -808,6 +819,7 @@ static bool CompareUsage(const std::pair<int, Tensor *> &a,
 
 bool Network::Compile(const Flow &flow, const Library &library) {
   // Fetch information about the CPU we are running on.
+  CompileStats::Timer timer(stats_);
   jit::CPU::Probe();
 
   // Create tensors for all the variables (parameters and constants).
@@ -884,6 +896,8 @@ bool Network::Compile(const Flow &flow, const Library &library) {
     }
   }
 
+  timer.Mark("create tensors");
+
   // Let linker configure network before compilation.
   linker_->BeginNetwork(this);
 
@@ -968,6 +982,7 @@ bool Network::Compile(const Flow &flow, const Library &library) {
     auto &kernels = library.Lookup(step->type());
     for (int k = kernels.size() - 1; k >= 0; --k) {
       Kernel *kernel = kernels[k];
+      if (stats_ != nullptr) stats_->Increment("kernels probed");
       if (kernel->Supports(step)) {
         // Check that kernel location is compatible with task placement.
         bool compatible = true;
@@ -1002,6 +1017,7 @@ bool Network::Compile(const Flow &flow, const Library &library) {
     VLOG(3) << "Step " << step->name() << " implemented by "
             << step->kernel_->Name();
   }
+  timer.Mark("kernel selection");
 
   // Add tensors for profiling.
   if (options_.profiling) {
@@ -1043,12 +1059,14 @@ bool Network::Compile(const Flow &flow, const Library &library) {
   for (Step *step : steps_) {
     step->kernel_->Adjust(step);
   }
+  timer.Mark("kernel adjustment");
 
   // Propagate constraints between linked tensors.
   bool again = true;
   while (again) {
     // Keep propagating alignment constraints until there are no more
     // constraints to propagate.
+    if (stats_ != nullptr) stats_->Increment("propagation iterations");
     again = false;
     for (auto it : tensors) {
       Tensor *t = it.second;
@@ -1115,6 +1133,8 @@ bool Network::Compile(const Flow &flow, const Library &library) {
     }
   }
 
+  timer.Mark("constraint propagation");
+
   // Compute tensor sizes.
   for (auto it : tensors) {
     Tensor *tensor = it.second;
@@ -1238,6 +1258,8 @@ bool Network::Compile(const Flow &flow, const Library &library) {
             << " on " << placename[connector->placement_];
   }
 
+  timer.Mark("tensor layout");
+
   // Move all variables that are shared with a constant to the constant pool.
   for (auto it = parameters_.begin(); it != parameters_.end();) {
     // Check if tensor is shared with a constant.
@@ -1254,6 +1276,7 @@ bool Network::Compile(const Flow &flow, const Library &library) {
 
   // Compute live ranges for all variables.
   ComputeLiveRanges();
+  timer.Mark("live ranges");
   std::vector<std::pair<int, Tensor *>> enter;
   std::vector<std::pair<int, Tensor *>> leave;
   for (Tensor *var : parameters_) {
@@ -1308,6 +1331,8 @@ bool Network::Compile(const Flow &flow, const Library &library) {
     }
   }
 
+  timer.Mark("instance allocation");
+
   // Copy and align constants.
   for (Tensor *tensor : constants_) {
     if (tensor->shared_ != nullptr) {
@@ -1343,109 +1368,289 @@ bool Network::Compile(const Flow &flow, const Library &library) {
       } else {
         MemFree(data);
       }
+      if (stats_ != nullptr) stats_->Increment("constant bytes", tensor->size_);
+    }
+  }
+  timer.Mark("constants");
+
+  // Generate code for each cell. Cells have separate code generators, so
+  // this can be done in parallel if the linker and runtime allow it.
+  bool parallel = options_.parallel_compilation &&
+                  cells_.size() > 1 &&
+                  linker_->ThreadSafe() &&
+                  runtime_->Device() == nullptr;
+  if (parallel) {
+    int num_workers = std::thread::hardware_concurrency();
+    if (num_workers < 1) num_workers = 1;
+    if (num_workers > cells_.size()) num_workers = cells_.size();
+    std::atomic<int> next(0);
+    std::atomic<bool> success(true);
+    std::vector<std::thread> workers;
+
+    // Each cell collects compilation statistics separately, since the
+    // statistics are not thread-safe. These are merged in cell order when
+    // all the cells have been generated.
+    std::vector<CompileStats> cell_stats(stats_ != nullptr ? cells_.size() : 0);
+    for (int c = 0; c < cell_stats.size(); ++c) {
+      cells_[c]->stats_ = &cell_stats[c];
+    }
+    for (int i = 0; i < num_workers; ++i) {
+      workers.emplace_back([this, &next, &success]() {
+        int c;
+        while ((c = next++) < cells_.size()) {
+          if (!GenerateCell(cells_[c])) success = false;
+        }
+      });
+    }
+    for (std::thread &worker : workers) worker.join();
+    for (int c = 0; c < cell_stats.size(); ++c) {
+      stats_->Add(cell_stats[c]);
+      cells_[c]->stats_ = nullptr;
+    }
+    if (!success) return false;
+  } else {
+    for (Cell *cell : cells_) {
+      if (!GenerateCell(cell)) return false;
+    }
+  }
+  timer.Mark("code generation");
+  if (stats_ != nullptr) {
+    stats_->Increment("cells", cells_.size());
+    stats_->Increment("steps", steps_.size());
+    for (Cell *cell : cells_) {
+      stats_->Increment("code bytes", cell->code_.size());
     }
   }
 
-  // Compile each cell computation.
-  for (Cell *cell : cells_) {
-    // Start code generation for cell.
-    linker_->BeginCell(cell);
+  // Notify linker that compilation of network has completed.
+  linker_->EndNetwork(this);
 
-    // Create macro assembler for code generation.
-    MacroAssembler masm(nullptr, 0, options_);
-    masm.set_runtime(runtime_);
+  return true;
+}
 
-    // Declare the number of registers needed by the cell.
-    if (!masm.rr().usage(cell->register_usage_)) return false;
+bool Network::GenerateCell(Cell *cell) {
+  // Start code generation for cell.
+  linker_->BeginCell(cell);
 
-    // Insert break point in the beginning of the generated code in debug mode.
-    if (options_.debug) masm.Breakpoint();
+  // Create macro assembler for code generation.
+  MacroAssembler masm(nullptr, 0, options_);
+  masm.set_runtime(runtime_);
 
-    // Generate prologue for main cell computation.
-    masm.Prologue();
-    runtime_->GeneratePrologue(cell, &masm);
-
-    // Increment the invocation counter.
-    if (options_.profiling) {
-      // Invocation counter is the first element of the timing block.
-      masm.IncrementInvocations(cell->profile()->offset());
-
-      // Start runtime profiler.
-      masm.CallInstanceFunction(runtime_->StartProfilerFunc(),
-                                "MyelinStartProfiler");
-    }
-
-    // Copy input variables that do not have the placement required by the
-    // consumers.
-    bool sync = false;
-    Transfers xfers;
-    for (Tensor *tensor : parameters_) {
-      if (tensor->cell_ != cell) continue;
-      if (!tensor->in_) continue;
-      if (tensor->placement_ != EVERYWHERE) continue;
-
-      int task = tensor->ConsumerTask();
-      if (tensor->current_placement_ == HOST) {
-        // Copy parameter tensor from host to device.
-        xfers.add_host_to_device(tensor, task);
-        tensor->AddNewPlace(DEVICE);
-      } else if (tensor->current_placement_ == DEVICE) {
-        // Copy parameter tensor from device to host.
-        xfers.add_device_to_host(tensor, task);
-        tensor->AddNewPlace(HOST);
-        if (task == -1) sync = true;
-      }
-    }
-    runtime_->EmitTensorTransfers(xfers, cell, &masm);
+  // Declare the number of registers needed by the cell.
+  if (!masm.rr().usage(cell->register_usage_)) return false;
+
+  // Insert break point in the beginning of the generated code in debug mode.
+  if (options_.debug) masm.Breakpoint();
+
+  // Generate prologue for main cell computation.
+  masm.Prologue();
+  runtime_->GeneratePrologue(cell, &masm);
 
-    // Profile entry overhead.
-    if (options_.profiling) {
-      int timing = cell->profile()->offset();
-      masm.TimeStep(timing, 1 * sizeof(int64));
+  // Increment the invocation counter.
+  if (options_.profiling) {
+    // Invocation counter is the first element of the timing block.
+    masm.IncrementInvocations(cell->profile()->offset());
+
+    // Start runtime profiler.
+    masm.CallInstanceFunction(runtime_->StartProfilerFunc(),
+                              "MyelinStartProfiler");
+  }
+
+  // Copy input variables that do not have the placement required by the
+  // consumers.
+  bool sync = false;
+  Transfers xfers;
+  for (Tensor *tensor : parameters_) {
+    if (tensor->cell_ != cell) continue;
+    if (!tensor->in_) continue;
+    if (tensor->placement_ != EVERYWHERE) continue;
+
+    int task = tensor->ConsumerTask();
+    if (tensor->current_placement_ == HOST) {
+      // Copy parameter tensor from host to device.
+      xfers.add_host_to_device(tensor, task);
+      tensor->AddNewPlace(DEVICE);
+    } else if (tensor->current_placement_ == DEVICE) {
+      // Copy parameter tensor from device to host.
+      xfers.add_device_to_host(tensor, task);
+      tensor->AddNewPlace(HOST);
+      if (task == -1) sync = true;
     }
+  }
+  runtime_->EmitTensorTransfers(xfers, cell, &masm);
 
-    // Let kernels generate code for each step.
-    int stepnum = 0;
-    for (Step *step : cell->steps_) {
-      if (step->task_index_ == -1) {
-        // Wait for completion of all inputs.
-        for (Tensor *input : step->inputs_) {
-          // Check if input is produced by parallel task.
-          if (input->producer() == nullptr) continue;
-          int tidx = input->producer()->task_index();
-          if (tidx == -1) continue;
-
-          // Wait for producing task to complete.
-          auto &t = cell->tasks_[tidx];
-          CHECK(t.state != PENDING) << cell->name_ << " task " << t.task;
-          if (t.state == ACTIVE) {
-            // Wait for parallel task to complete.
-            masm.WaitForTask(t.offset);
-            t.state = COMPLETED;
-
-            // Profile task wait.
-            if (options_.profiling) {
-              int timing = cell->profile()->offset();
-              int slot = 2 + cell->steps_.size() + tidx * 2 + 1;
-              masm.TimeStep(timing, slot * sizeof(int64));
-            }
+  // Profile entry overhead.
+  if (options_.profiling) {
+    int timing = cell->profile()->offset();
+    masm.TimeStep(timing, 1 * sizeof(int64));
+  }
+
+  // Let kernels generate code for each step.
+  int stepnum = 0;
+  for (Step *step : cell->steps_) {
+    if (step->task_index_ == -1) {
+      // Wait for completion of all inputs.
+      for (Tensor *input : step->inputs_) {
+        // Check if input is produced by parallel task.
+        if (input->producer() == nullptr) continue;
+        int tidx = input->producer()->task_index();
+        if (tidx == -1) continue;
+
+        // Wait for producing task to complete.
+        auto &t = cell->tasks_[tidx];
+        CHECK(t.state != PENDING) << cell->name_ << " task " << t.task;
+        if (t.state == ACTIVE) {
+          // Wait for parallel task to complete.
+          masm.WaitForTask(t.offset);
+          t.state = COMPLETED;
+
+          // Profile task wait.
+          if (options_.profiling) {
+            int timing = cell->profile()->offset();
+            int slot = 2 + cell->steps_.size() + tidx * 2 + 1;
+            masm.TimeStep(timing, slot * sizeof(int64));
+          }
+        }
+      }
+
+      // Synchronize main task if needed before executing step.
+      if (options_.sync_steps || (sync && step->NeedsSynchronization())) {
+        VLOG(8) << "Sync main task";
+        masm.CallInstanceFunction(runtime_->SyncMainFunc(), "MyelinSyncMain");
+        sync = false;
+      }
+
+      // Generate code for step.
+      auto pc = masm.pc_offset();
+      VLOG(8) << "Generate " << step->name() << " @ "
+              << reinterpret_cast<uint64 *>(pc)
+              << " with " << step->kernel_->Name()
+              << " on " << placename[step->placement()];
+      linker_->AddStep(step, pc);
+      step->kernel_->Generate(step, &masm);
+      if (masm.pc_offset() == pc) step->noop_ = true;
+
+      // No registers are preserved between steps, so reset register
+      // allocation.
+      masm.ResetRegisterUsage();
+
+      // Copy outputs that do not have the placement required by the
+      // consumers.
+      Transfers xfers;
+      for (Tensor *output : step->outputs_) {
+        output->AddNewPlace(step->placement());
+        if (output->placement_ == EVERYWHERE) {
+          int task = output->ConsumerTask();
+          if (output->current_placement_ == HOST) {
+            // Copy output from host to device.
+            xfers.add_host_to_device(output, task);
+            output->AddNewPlace(DEVICE);
+          } else if (output->current_placement_ == DEVICE) {
+            // Copy output from device to host.
+            xfers.add_device_to_host(output, task);
+            output->AddNewPlace(HOST);
+            if (task == -1) sync = true;
           }
         }
+      }
+      runtime_->EmitTensorTransfers(xfers, cell, &masm);
 
-        // Synchronize main task if needed before executing step.
-        if (options_.sync_steps || (sync && step->NeedsSynchronization())) {
-          VLOG(8) << "Sync main task";
-          masm.CallInstanceFunction(runtime_->SyncMainFunc(), "MyelinSyncMain");
+      // Profile step.
+      if (options_.profiling && !step->noop_) {
+        int timing = cell->profile()->offset();
+        masm.TimeStep(timing, (stepnum + 2) * sizeof(int64));
+      }
+    } else {
+      // Parallel step.
+      int tidx = step->task_index_;
+      auto &t = cell->tasks_[tidx];
+      CHECK(t.state != COMPLETED) << cell->name_ << " task " << t.task;
+      if (t.state == PENDING) {
+        // Flush asynchronous operations.
+        if (sync) {
+          masm.CallInstanceFunction(runtime_->SyncMainFunc(),
+                                    "MyelinSyncMain");
           sync = false;
         }
 
+        // Start parallel task.
+        masm.StartTask(t.offset, t.task, step->task_index_, &t.entry);
+        t.state = ACTIVE;
+
+        // Profile task start.
+        if (options_.profiling) {
+          int timing = cell->profile()->offset();
+          int slot = 2 + cell->steps_.size() + tidx * 2;
+          masm.TimeStep(timing, slot * sizeof(int64));
+        }
+      }
+
+      // Update output placements.
+      for (Tensor *output : step->outputs_) {
+        output->AddNewPlace(step->placement());
+        if (output->placement_ == EVERYWHERE) {
+          if (output->current_placement_ == HOST) {
+            // Set deferred copy from host to device.
+            VLOG(8) << "Deferred transfer " << output->name()
+                    << " from host to device";
+            output->deferred_placement_ = DEVICE;
+            output->AddNewPlace(DEVICE);
+          } else if (output->current_placement_ == DEVICE) {
+            // Set deferred copy from device to host.
+            VLOG(8) << "Deferred transfer " << output->name()
+                    << " from device to host";
+            output->deferred_placement_ = HOST;
+            output->AddNewPlace(HOST);
+          }
+        }
+      }
+    }
+    stepnum++;
+  }
+
+  // Make sure all tasks have completed.
+  for (auto &task : cell->tasks_) {
+    if (task.state == ACTIVE) {
+      masm.WaitForTask(task.offset);
+      task.state = COMPLETED;
+    }
+  }
+
+  // Synchronize main task.
+  masm.CallInstanceFunction(runtime_->SyncMainFunc(), "MyelinSyncMain");
+
+  // Stop runtime profiler.
+  if (options_.profiling) {
+    masm.CallInstanceFunction(runtime_->StopProfilerFunc(),
+                              "MyelinStopProfiler");
+  }
+
+  // Profile exit overhead.
+  if (options_.profiling) {
+    int timing = cell->profile()->offset();
+    masm.TimeStep(timing, 1 * sizeof(int64));
+  }
+
+  // Generate epilogue for main cell computation.
+  runtime_->GenerateEpilogue(cell, &masm);
+  masm.Epilogue();
+
+  // Generate code for parallel tasks.
+  int task_index = 0;
+  for (auto &task : cell->tasks_) {
+    // Set entry for task function.
+    masm.bind(&task.entry);
+
+    // Generate parallel task prologue.
+    masm.Prologue();
+
+    // Let kernels generate code for each step.
+    int stepnum = 0;
+    for (Step *step : cell->steps_) {
+      if (step->task_index_ == task_index) {
         // Generate code for step.
         auto pc = masm.pc_offset();
-        VLOG(8) << "Generate " << step->name() << " @ "
-                << reinterpret_cast<uint64 *>(pc)
-                << " with " << step->kernel_->Name()
-                << " on " << placename[step->placement()];
-        linker_->AddStep(step, pc);
+        VLOG(8) << step->name() << " @ " << reinterpret_cast<uint64 *>(pc);
         step->kernel_->Generate(step, &masm);
         if (masm.pc_offset() == pc) step->noop_ = true;
 
@@ -1457,19 +1662,12 @@ bool Network::Compile(const Flow &flow, const Library &library) {
         // consumers.
         Transfers xfers;
         for (Tensor *output : step->outputs_) {
-          output->AddNewPlace(step->placement());
-          if (output->placement_ == EVERYWHERE) {
-            int task = output->ConsumerTask();
-            if (output->current_placement_ == HOST) {
-              // Copy output from host to device.
-              xfers.add_host_to_device(output, task);
-              output->AddNewPlace(DEVICE);
-            } else if (output->current_placement_ == DEVICE) {
-              // Copy output from device to host.
-              xfers.add_device_to_host(output, task);
-              output->AddNewPlace(HOST);
-              if (task == -1) sync = true;
-            }
+          if (output->deferred_placement_ == DEVICE) {
+            // Copy output from host to device.
+            xfers.add_host_to_device(output, task_index);
+          } else if (output->deferred_placement_ == HOST) {
+            // Copy output from device to host.
+            xfers.add_device_to_host(output, task_index);
           }
         }
         runtime_->EmitTensorTransfers(xfers, cell, &masm);
@@ -1479,152 +1677,102 @@ bool Network::Compile(const Flow &flow, const Library &library) {
           int timing = cell->profile()->offset();
           masm.TimeStep(timing, (stepnum + 2) * sizeof(int64));
         }
-      } else {
-        // Parallel step.
-        int tidx = step->task_index_;
-        auto &t = cell->tasks_[tidx];
-        CHECK(t.state != COMPLETED) << cell->name_ << " task " << t.task;
-        if (t.state == PENDING) {
-          // Flush asynchronous operations.
-          if (sync) {
-            masm.CallInstanceFunction(runtime_->SyncMainFunc(),
-                                      "MyelinSyncMain");
-            sync = false;
-          }
-
-          // Start parallel task.
-          masm.StartTask(t.offset, t.task, step->task_index_, &t.entry);
-          t.state = ACTIVE;
-
-          // Profile task start.
-          if (options_.profiling) {
-            int timing = cell->profile()->offset();
-            int slot = 2 + cell->steps_.size() + tidx * 2;
-            masm.TimeStep(timing, slot * sizeof(int64));
-          }
-        }
-
-        // Update output placements.
-        for (Tensor *output : step->outputs_) {
-          output->AddNewPlace(step->placement());
-          if (output->placement_ == EVERYWHERE) {
-            if (output->current_placement_ == HOST) {
-              // Set deferred copy from host to device.
-              VLOG(8) << "Deferred transfer " << output->name()
-                      << " from host to device";
-              output->deferred_placement_ = DEVICE;
-              output->AddNewPlace(DEVICE);
-            } else if (output->current_placement_ == DEVICE) {
-              // Set deferred copy from device to host.
-              VLOG(8) << "Deferred transfer " << output->name()
-                      << " from device to host";
-              output->deferred_placement_ = HOST;
-              output->AddNewPlace(HOST);
-            }
-          }
-        }
       }
       stepnum++;
     }
 
-    // Make sure all tasks have completed.
-    for (auto &task : cell->tasks_) {
-      if (task.state == ACTIVE) {
-        masm.WaitForTask(task.offset);
-        task.state = COMPLETED;
-      }
-    }
+    // Generate parallel task epilogue.
+    masm.Epilogue();
 
-    // Synchronize main task.
-    masm.CallInstanceFunction(runtime_->SyncMainFunc(), "MyelinSyncMain");
+    task_index++;
+  }
 
-    // Stop runtime profiler.
-    if (options_.profiling) {
-      masm.CallInstanceFunction(runtime_->StopProfilerFunc(),
-                                "MyelinStopProfiler");
-    }
+  // Generate static data blocks.
+  auto code_size = masm.pc_offset();
+  masm.GenerateDataBlocks();
 
-    // Profile exit overhead.
-    if (options_.profiling) {
-      int timing = cell->profile()->offset();
-      masm.TimeStep(timing, 1 * sizeof(int64));
-    }
+  // Add generated code to linker.
+  linker_->EndCell(cell, &masm, &cell->code_, masm.pc_offset() - code_size);
+  VLOG(5) << cell->name()
+          << " entry address: " << cell->code_.entry()
+          << " code size: " << cell->code_.size()
+          << " data size: " << cell->instance_size();
 
-    // Generate epilogue for main cell computation.
-    runtime_->GenerateEpilogue(cell, &masm);
-    masm.Epilogue();
+  return true;
+}
 
-    // Generate code for parallel tasks.
-    int task_index = 0;
-    for (auto &task : cell->tasks_) {
-      // Set entry for task function.
-      masm.bind(&task.entry);
-
-      // Generate parallel task prologue.
-      masm.Prologue();
-
-      // Let kernels generate code for each step.
-      int stepnum = 0;
-      for (Step *step : cell->steps_) {
-        if (step->task_index_ == task_index) {
-          // Generate code for step.
-          auto pc = masm.pc_offset();
-          VLOG(8) << step->name() << " @ " << reinterpret_cast<uint64 *>(pc);
-          step->kernel_->Generate(step, &masm);
-          if (masm.pc_offset() == pc) step->noop_ = true;
-
-          // No registers are preserved between steps, so reset register
-          // allocation.
-          masm.ResetRegisterUsage();
-
-          // Copy outputs that do not have the placement required by the
-          // consumers.
-          Transfers xfers;
-          for (Tensor *output : step->outputs_) {
-            if (output->deferred_placement_ == DEVICE) {
-              // Copy output from host to device.
-              xfers.add_host_to_device(output, task_index);
-            } else if (output->deferred_placement_ == HOST) {
-              // Copy output from device to host.
-              xfers.add_device_to_host(output, task_index);
-            }
-          }
-          runtime_->EmitTensorTransfers(xfers, cell, &masm);
+bool Network::Compile(const string &flowfile, const Library &library) {
+  // Load flow file.
+  Flow flow;
+  if (!flow.Load(flowfile).ok()) {
+    LOG(ERROR) << "Error loading flow file " << flowfile;
+    return false;
+  }
 
-          // Profile step.
-          if (options_.profiling && !step->noop_) {
-            int timing = cell->profile()->offset();
-            masm.TimeStep(timing, (stepnum + 2) * sizeof(int64));
-          }
-        }
-        stepnum++;
-      }
+  // Analyze flow graph.
+  flow.Analyze(library, stats_);
 
-      // Generate parallel task epilogue.
-      masm.Epilogue();
+  // Generate code for flow.
+  return Compile(flow, library);
+}
+
+bool Network::ReloadWeights(const Flow &flow) {
+  // Find constants in flow.
+  std::unordered_map<string, Flow::Variable *> weights;
+  for (Flow::Variable *var : flow.vars()) {
+    if (var->data != nullptr) weights[var->name] = var;
+  }
 
-      task_index++;
+  // Check that the weights are compatible with the compiled network before
+  // updating any of the constants.
+  std::vector<std::pair<Tensor *, Flow::Variable *>> updates;
+  for (Tensor *tensor : constants_) {
+    // Shared constants use the data of the tensor they are shared with.
+    if (tensor->shared_ != nullptr) continue;
+
+    auto f = weights.find(tensor->name());
+    if (f == weights.end()) {
+      LOG(ERROR) << "No weights for constant " << tensor->name();
+      return false;
+    }
+    Flow::Variable *var = f->second;
+    size_t size = tensor->elements() * tensor->element_size();
+    if (var->type != tensor->type() || var->shape != tensor->shape() ||
+        var->size != size) {
+      LOG(ERROR) << "Incompatible weights for constant " << tensor->name()
+                 << " " << tensor->TypeString() << " vs. " << var->TypeString();
+      return false;
     }
+    if (tensor->placement_ & DEVICE) {
+      LOG(ERROR) << "Reloading device constant not supported: "
+                 << tensor->name();
+      return false;
+    }
+    if (tensor->data_ == nullptr) continue;
 
-    // Generate static data blocks.
-    auto code_size = masm.pc_offset();
-    masm.GenerateDataBlocks();
+    // Scalar constants can be embedded in the generated code.
+    if (tensor->elements() == 1 && memcmp(tensor->data_, var->data, size)) {
+      LOG(ERROR) << "Scalar constant " << tensor->name()
+                 << " cannot be changed without recompiling";
+      return false;
+    }
 
-    // Add generated code to linker.
-    linker_->EndCell(cell, &masm, &cell->code_, masm.pc_offset() - code_size);
-    VLOG(5) << cell->name()
-            << " entry address: " << cell->code_.entry()
-            << " code size: " << cell->code_.size()
-            << " data size: " << cell->instance_size();
+    updates.emplace_back(tensor, var);
   }
 
-  // Notify linker that compilation of network has completed.
-  linker_->EndNetwork(this);
+  // Copy new weights into the existing constant data blocks, since the
+  // addresses of these are referenced from the generated code.
+  for (auto &update : updates) {
+    Tensor *tensor = update.first;
+    char *data = const_cast<char *>(tensor->data_);
+    if (!CopyTensorData(tensor, update.second->data, data)) return false;
+  }
 
+  VLOG(3) << "Reloaded " << updates.size() << " constants";
   return true;
 }
 
-bool Network::Compile(const string &flowfile, const Library &library) {
+bool Network::ReloadWeights(const string &flowfile, const Library &library) {
   // Load flow file.
   Flow flow;
   if (!flow.Load(flowfile).ok()) {
@@ -1633,10 +1781,10 @@ bool Network::Compile(const string &flowfile, const Library &library) {
   }
 
   // Analyze flow graph.
-  flow.Analyze(library);
+  flow.Analyze(library, stats_);
 
-  // Generate code for flow.
-  return Compile(flow, library);
+  // Reload constants from flow.
+  return ReloadWeights(flow);
 }
 
 void Network::ComputeLiveRanges() {
@@ -1680,18 +1828,46 @@ char *Network::AllocateTensor(Tensor *tensor) {
     alignment = jit::CPU::CacheLineSize();
   }
 
+  // Large constants are page-aligned so their pages can be placed on NUMA
+  // nodes. The placement must be done before the memory is touched.
+  bool numa = options_.numa_interleave || options_.numa_node != -1;
+  if (numa && tensor->size_ >= kNumaMinSize) {
+    if (alignment < Numa::PageSize()) alignment = Numa::PageSize();
+  } else {
+    numa = false;
+  }
+
   // Allocate memory for tensor.
   char *data = MemAlloc(tensor->size_, alignment);
+  if (numa) {
+    bool placed;
+    if (options_.numa_interleave) {
+      placed = Numa::InterleaveMemory(data, tensor->size_);
+    } else {
+      placed = Numa::BindMemory(data, tensor->size_, options_.numa_node);
+    }
+    if (!placed) {
+      LOG(WARNING) << "Cannot set NUMA placement for " << tensor->name();
+    }
+  }
   memset(data, 0, tensor->size_);
 
   // Copy data.
+  if (!CopyTensorData(tensor, tensor->data_, data)) {
+    MemFree(data);
+    return nullptr;
+  }
+
+  return data;
+}
+
+bool Network::CopyTensorData(Tensor *tensor, const char *src, char *data) {
   if (tensor->rank() == 0 || tensor->rank() == 1) {
     // Vectors and scalars can just be copied regardless of alignment and
     // order.
-    memcpy(data, tensor->data_, tensor->size_);
+    memcpy(data, src, tensor->elements() * tensor->element_size());
   } else if (tensor->rank() == 2) {
     // Copy matrix one element at a time.
-    const char *src = tensor->data_;
     int element_size = tensor->element_size();
     for (int r = 0; r < tensor->dim(0); ++r) {
       for (int c = 0; c < tensor->dim(1); ++c) {
@@ -1700,7 +1876,6 @@ char *Network::AllocateTensor(Tensor *tensor) {
       }
     }
   } else if (tensor->rank() == 3) {
-    const char *src = tensor->data_;
     int element_size = tensor->element_size();
     for (int r = 0; r < tensor->dim(0); ++r) {
       for (int c = 0; c < tensor->dim(1); ++c) {
@@ -1711,7 +1886,6 @@ char *Network::AllocateTensor(Tensor *tensor) {
       }
     }
   } else if (tensor->rank() == 4) {
-    const char *src = tensor->data_;
     int element_size = tensor->element_size();
     for (int r = 0; r < tensor->dim(0); ++r) {
       for (int c = 0; c < tensor->dim(1); ++c) {
@@ -1726,10 +1900,10 @@ char *Network::AllocateTensor(Tensor *tensor) {
   } else {
     LOG(ERROR) << tensor->rank() << "D tensor not supported: "
                << tensor->name();
-    return nullptr;
+    return false;
   }
 
-  return data;
+  return true;
 }
 
 Cell *Network::GetCell(const string &name) const {
@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "sling/base/types.h"
+#include "sling/myelin/express.h"
 #include "sling/myelin/flow.h"
 #include "sling/string/printf.h"
 #include "third_party/jit/code.h"
@@ -291,6 +292,9 @@ class Linker {
 
   // Add device code for step.
   virtual void AddDeviceCode(Step *step, const string &code) {}
+
+  // Whether the cell methods can be called concurrently for different cells.
+  virtual bool ThreadSafe() { return false; }
 };
 
 // A tensor is a multi-dimensional array that can be used for constants and
@@ -808,6 +812,9 @@ class Channel {
   // Return the number of elements in the channel.
   int size() const { return size_; }
 
+  // Return the number of elements allocated for the channel.
+  int capacity() const { return capacity_; }
+
   // Return runtime for channel.
   inline Runtime *runtime() const;
 
@@ -911,6 +918,9 @@ class ProfileSummary {
   // Pointer to profile buffer.
   int64 *data() const { return data_; }
 
+  // Add profiling data from another summary for the same cell.
+  void Add(const ProfileSummary &other);
+
  private:
   Cell *cell_;              // cell being profiled
   int64 *data_ = nullptr;   // profile data
@@ -1074,6 +1084,11 @@ class Cell {
   // Tensor with profiling information.
   Tensor *profile() const { return profile_; }
 
+  // Compilation statistics for the code generation of the cell. These are the
+  // statistics for the network unless the cells are generated in parallel, in
+  // which case each cell collects its own statistics until they are merged.
+  inline CompileStats *compile_stats() const;
+
   // Return cell in text format.
   string ToString() const;
 
@@ -1123,6 +1138,9 @@ class Cell {
   // Tensor with profiling information.
   Tensor *profile_ = nullptr;
 
+  // Separate compilation statistics for cell during parallel code generation.
+  CompileStats *stats_ = nullptr;
+
   friend class Network;
   friend class Step;
   friend class InstanceAllocator;
@@ -1136,6 +1154,10 @@ struct Options {
   bool external_profiler = false;            // external profiling buffer
   bool dynamic_allocation = false;           // dynamic instance allocation
   bool sync_steps = false;                   // synchronize all steps
+  Express::Precision math_precision = Express::PRECISE;  // intrinsics precision
+  bool parallel_compilation = false;         // generate cell code in parallel
+  int numa_node = -1;                        // NUMA node for large constants
+  bool numa_interleave = false;              // interleave large constants
 };
 
 // A network is a collection of cells and variables that are compiled as a unit.
@@ -1150,6 +1172,18 @@ class Network {
   // Load flow from file and compile all the cells.
   bool Compile(const string &flowfile, const Library &library);
 
+  // Replace the data for the constants in a compiled network with the data
+  // from the variables with the same names in the flow without recompiling the
+  // network. The flow must have been analyzed in the same way as the flow used
+  // for compiling the network, i.e. only the weights are allowed to change.
+  // Scalar constants can be folded into the generated code, so these must keep
+  // their values. The network is left unchanged if the flow is not compatible.
+  // This must not be called while the network is being used for computation.
+  bool ReloadWeights(const Flow &flow);
+
+  // Load flow from file, analyze it, and reload the weights from it.
+  bool ReloadWeights(const string &flowfile, const Library &library);
+
   // Get compiled cell.
   Cell *GetCell(const string &name) const;
 
@@ -1170,6 +1204,11 @@ class Network {
   Linker *linker() const { return linker_; }
   void set_linker(Linker *linker) { linker_ = linker; }
 
+  // Compilation statistics. If set, timing and counters for the compilation
+  // phases are added to these. The network does not own the statistics.
+  CompileStats *compile_stats() const { return stats_; }
+  void set_compile_stats(CompileStats *stats) { stats_ = stats; }
+
   // Compiler options.
   Options &options() { return options_; }
 
@@ -1190,6 +1229,28 @@ class Network {
     options_.dynamic_allocation = dynamic;
   }
 
+  // Generate code for the cells in parallel. This is only done if the linker
+  // is thread-safe and the network does not run on a device.
+  void set_parallel_compilation(bool parallel) {
+    options_.parallel_compilation = parallel;
+  }
+
+  // Place the memory for large constants on a NUMA node. Constants are placed
+  // according to the default memory policy if node is -1.
+  void set_numa_node(int node) { options_.numa_node = node; }
+
+  // Interleave the memory for large constants over all NUMA nodes. This
+  // spreads the memory traffic for networks shared between nodes.
+  void set_numa_interleave(bool interleave) {
+    options_.numa_interleave = interleave;
+  }
+
+  // Set precision tier for expanding intrinsic functions like exp and tanh.
+  // This can be overridden for individual steps with the precision attribute.
+  void set_math_precision(Express::Precision precision) {
+    options_.math_precision = precision;
+  }
+
   // Network cells.
   const std::vector<Cell *> cells() const { return cells_; }
 
@@ -1206,9 +1267,15 @@ class Network {
   // Compute live ranges for all the variables.
   void ComputeLiveRanges();
 
+  // Generate code for cell.
+  bool GenerateCell(Cell *cell);
+
   // Allocate aligned tensor from data in standard order.
   char *AllocateTensor(Tensor *tensor);
 
+  // Copy tensor data in standard order to aligned tensor data.
+  bool CopyTensorData(Tensor *tensor, const char *src, char *data);
+
   // Network cells.
   std::vector<Cell *> cells_;
 
@@ -1236,6 +1303,9 @@ class Network {
   // Linker for linking code and data.
   Linker *linker_;
 
+  // Compilation statistics.
+  CompileStats *stats_ = nullptr;
+
   // Compiler options.
   Options options_;
 
@@ -1287,6 +1357,10 @@ inline Runtime *Cell::runtime() const {
   return network_->runtime();
 }
 
+inline CompileStats *Cell::compile_stats() const {
+  return stats_ != nullptr ? stats_ : network_->compile_stats();
+}
+
 inline Runtime *Instance::runtime() const {
   return cell_->runtime();
 }
@@ -399,8 +399,48 @@ Express::Constant Express::constants[Express::NUM_CONSTANTS] = {
   FLTCONST(1.18534705686654e-04),  // BETA_2
   FLTCONST(2.26843463243900e-03),  // BETA_4
   FLTCONST(4.89352518554385e-03),  // BETA_6
+
+  // Polynomial coefficients for fast exponential function.
+  FLTCONST(4.127880733453e-02),    // EXP_FAST_P0
+  FLTCONST(1.675352195484e-01),    // EXP_FAST_P1
+  FLTCONST(5.000510801208e-01),    // EXP_FAST_P2
+  FLTCONST(1.666324431304e-01),    // EXP_FASTEST_P0
+  FLTCONST(5.039424603901e-01),    // EXP_FASTEST_P1
+
+  // Polynomial coefficients for fast natural logarithm.
+  FLTCONST(1.178186002432e-01),    // LOG_FAST_P0
+  FLTCONST(-1.840718664425e-01),   // LOG_FAST_P1
+  FLTCONST(2.044219439697e-01),    // LOG_FAST_P2
+  FLTCONST(-2.494383288373e-01),   // LOG_FAST_P3
+  FLTCONST(3.332086062574e-01),    // LOG_FAST_P4
+  FLTCONST(1.732494996713e-01),    // LOG_FASTEST_P0
+  FLTCONST(-2.646124448498e-01),   // LOG_FASTEST_P1
+  FLTCONST(3.356733766559e-01),    // LOG_FASTEST_P2
+
+  // Clamping interval and coefficients for 9/4-degree rational tanh
+  // approximation. The x and 1 terms are implicit.
+  FLTCONST(7.9),                   // TANH_FAST_HI
+  FLTCONST(-7.9),                  // TANH_FAST_LO
+  FLTCONST(1.112923223983e-01),    // TANH_FAST_ALPHA_3
+  FLTCONST(1.124844741115e-03),    // TANH_FAST_ALPHA_5
+  FLTCONST(-3.963526967203e-06),   // TANH_FAST_ALPHA_7
+  FLTCONST(1.230594390684e-08),    // TANH_FAST_ALPHA_9
+  FLTCONST(4.445746225532e-01),    // TANH_FAST_BETA_2
+  FLTCONST(1.604623335700e-02),    // TANH_FAST_BETA_4
+
+  // Clamping interval and coefficients for 5/4-degree rational tanh
+  // approximation.
+  FLTCONST(5.0),                   // TANH_FASTEST_HI
+  FLTCONST(-5.0),                  // TANH_FASTEST_LO
+  FLTCONST(1.024890282037e-01),    // TANH_FASTEST_ALPHA_3
+  FLTCONST(6.715966047248e-04),    // TANH_FASTEST_ALPHA_5
+  FLTCONST(4.355592174608e-01),    // TANH_FASTEST_BETA_2
+  FLTCONST(1.283469222819e-02),    // TANH_FASTEST_BETA_4
 };
 
+// Precision tier names.
+static const char *precision_names[] = {"precise", "fast", "fastest"};
+
 Express::OpType Express::Lookup(const string &opname) {
   auto f = optypes.find(opname);
   return f == optypes.end() ? INVALID : f->second;
@@ -410,6 +450,20 @@ const string &Express::OpName(OpType type) {
   return opname[type];
 }
 
+bool Express::LookupPrecision(const string &name, Precision *precision) {
+  for (int i = PRECISE; i <= FASTEST; ++i) {
+    if (name == precision_names[i]) {
+      *precision = static_cast<Precision>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *Express::PrecisionName(Precision precision) {
+  return precision_names[precision];
+}
+
 void Express::Parse(const string &recipe, bool expand) {
   RecipeParser parser(recipe, this, expand);
   parser.Parse();
@@ -745,6 +799,127 @@ void Express::CacheResults() {
   if (cached_vars > 0) CompactTempVars();
 }
 
+// Return the maximum number of temp variables produced in the body that are
+// live at the same time when the body operations are executed in order.
+static int MaxLiveTemps(const std::vector<Express::Op *> &order) {
+  std::set<Express::Op *> ops(order.begin(), order.end());
+  std::map<Express::Var *, int> last;
+  for (int i = 0; i < order.size(); ++i) {
+    for (Express::Var *arg : order[i]->args) last[arg] = i;
+  }
+  int active = 0;
+  int max_active = 0;
+  for (int i = 0; i < order.size(); ++i) {
+    Express::Var *result = order[i]->result;
+    if (result->type == Express::TEMP && last.count(result) > 0) active++;
+    if (active > max_active) max_active = active;
+    std::set<Express::Var *> freed;
+    for (Express::Var *arg : order[i]->args) {
+      if (arg->type != Express::TEMP || last[arg] != i) continue;
+      if (ops.count(arg->producer) == 0) continue;
+      if (freed.insert(arg).second) active--;
+    }
+  }
+  return max_active;
+}
+
+bool Express::Schedule() {
+  std::vector<Op *> body(ops_.begin() + body_, ops_.end());
+  int n = body.size();
+  if (n < 3) return false;
+
+  // Build dependency graph for the body operations.
+  std::map<Op *, int> position;
+  for (int i = 0; i < n; ++i) position[body[i]] = i;
+  std::vector<std::vector<int>> successors(n);
+  std::vector<int> pending(n);
+  auto depend = [&](int before, int after) {
+    successors[before].push_back(after);
+    pending[after]++;
+  };
+  for (int i = 0; i < n; ++i) {
+    Op *op = body[i];
+    std::set<int> producers;
+    for (Var *arg : op->args) {
+      auto f = position.find(arg->producer);
+      if (f != position.end()) producers.insert(f->second);
+    }
+    for (int p : producers) depend(p, i);
+
+    // Inputs and outputs can share memory, so input loads and output stores
+    // must keep their relative order.
+    bool store = op->result->type == OUTPUT;
+    bool load = false;
+    for (Var *arg : op->args) {
+      if (arg->type == INPUT) load = true;
+    }
+    for (int j = 0; j < i; ++j) {
+      if (producers.count(j) > 0) continue;
+      Op *prev = body[j];
+      bool prev_store = prev->result->type == OUTPUT;
+      bool prev_load = false;
+      for (Var *arg : prev->args) {
+        if (arg->type == INPUT) prev_load = true;
+      }
+      if ((load && prev_store) || (store && prev_load)) depend(j, i);
+    }
+  }
+
+  // Count the remaining uses of each temp variable produced in the body.
+  std::map<Var *, int> uses;
+  for (Op *op : body) {
+    std::set<Var *> args(op->args.begin(), op->args.end());
+    for (Var *arg : args) {
+      if (arg->type == TEMP && position.count(arg->producer) > 0) uses[arg]++;
+    }
+  }
+
+  // List schedule the operations. At each step, the ready operation with the
+  // smallest increase in live temps is selected. Ties are broken by the
+  // original order, which favors completing computations that have been
+  // started over starting new ones.
+  std::vector<Op *> order;
+  std::set<int> ready;
+  for (int i = 0; i < n; ++i) {
+    if (pending[i] == 0) ready.insert(i);
+  }
+  while (!ready.empty()) {
+    int best = -1;
+    int best_delta = 0;
+    for (int i : ready) {
+      Op *op = body[i];
+      int delta = op->result->type == TEMP ? 1 : 0;
+      std::set<Var *> args(op->args.begin(), op->args.end());
+      for (Var *arg : args) {
+        auto f = uses.find(arg);
+        if (f != uses.end() && f->second == 1) delta--;
+      }
+      if (best == -1 || delta < best_delta) {
+        best = i;
+        best_delta = delta;
+      }
+    }
+
+    Op *op = body[best];
+    order.push_back(op);
+    ready.erase(best);
+    std::set<Var *> args(op->args.begin(), op->args.end());
+    for (Var *arg : args) {
+      auto f = uses.find(arg);
+      if (f != uses.end()) f->second--;
+    }
+    for (int s : successors[best]) {
+      if (--pending[s] == 0) ready.insert(s);
+    }
+  }
+  CHECK_EQ(order.size(), n);
+
+  // Only use the new order if it reduces register pressure.
+  if (MaxLiveTemps(order) >= MaxLiveTemps(body)) return false;
+  std::copy(order.begin(), order.end(), ops_.begin() + body_);
+  return true;
+}
+
 void Express::ComputeLiveRanges() {
   // All variables assigned before the start of the body need to have their live
   // range extended to the end.
@@ -1456,16 +1631,30 @@ Express::Var *Express::Log(Var *x) {
     x = Add(x, tmp);
     Var *z = Mul(x, x);
 
-    // Part 3: Compute the polynomial approximation.
-    Var *y = Number(CEPHES_LOG_P0);
-    y = MulAdd(y, x, Number(CEPHES_LOG_P1));
-    y = MulAdd(y, x, Number(CEPHES_LOG_P2));
-    y = MulAdd(y, x, Number(CEPHES_LOG_P3));
-    y = MulAdd(y, x, Number(CEPHES_LOG_P4));
-    y = MulAdd(y, x, Number(CEPHES_LOG_P5));
-    y = MulAdd(y, x, Number(CEPHES_LOG_P6));
-    y = MulAdd(y, x, Number(CEPHES_LOG_P7));
-    y = MulAdd(y, x, Number(CEPHES_LOG_P8));
+    // Part 3: Compute the polynomial approximation. The lower precision tiers
+    // use fewer terms.
+    Var *y;
+    if (precision_ == FASTEST) {
+      y = Number(LOG_FASTEST_P0);
+      y = MulAdd(y, x, Number(LOG_FASTEST_P1));
+      y = MulAdd(y, x, Number(LOG_FASTEST_P2));
+    } else if (precision_ == FAST) {
+      y = Number(LOG_FAST_P0);
+      y = MulAdd(y, x, Number(LOG_FAST_P1));
+      y = MulAdd(y, x, Number(LOG_FAST_P2));
+      y = MulAdd(y, x, Number(LOG_FAST_P3));
+      y = MulAdd(y, x, Number(LOG_FAST_P4));
+    } else {
+      y = Number(CEPHES_LOG_P0);
+      y = MulAdd(y, x, Number(CEPHES_LOG_P1));
+      y = MulAdd(y, x, Number(CEPHES_LOG_P2));
+      y = MulAdd(y, x, Number(CEPHES_LOG_P3));
+      y = MulAdd(y, x, Number(CEPHES_LOG_P4));
+      y = MulAdd(y, x, Number(CEPHES_LOG_P5));
+      y = MulAdd(y, x, Number(CEPHES_LOG_P6));
+      y = MulAdd(y, x, Number(CEPHES_LOG_P7));
+      y = MulAdd(y, x, Number(CEPHES_LOG_P8));
+    }
     y = Mul(y, x);
     y = Mul(y, z);
 
@@ -1507,13 +1696,23 @@ Express::Var *Express::Exp(Var *x) {
     // Compute r^2.
     Var *r2 = Mul(r, r);
 
-    // Compute polynomial.
-    Var *y = Number(CEPHES_EXP_P0);
-    y = MulAdd(y, r, Number(CEPHES_EXP_P1));
-    y = MulAdd(y, r, Number(CEPHES_EXP_P2));
-    y = MulAdd(y, r, Number(CEPHES_EXP_P3));
-    y = MulAdd(y, r, Number(CEPHES_EXP_P4));
-    y = MulAdd(y, r, Number(CEPHES_EXP_P5));
+    // Compute polynomial. The lower precision tiers use fewer terms.
+    Var *y;
+    if (precision_ == FASTEST) {
+      y = Number(EXP_FASTEST_P0);
+      y = MulAdd(y, r, Number(EXP_FASTEST_P1));
+    } else if (precision_ == FAST) {
+      y = Number(EXP_FAST_P0);
+      y = MulAdd(y, r, Number(EXP_FAST_P1));
+      y = MulAdd(y, r, Number(EXP_FAST_P2));
+    } else {
+      y = Number(CEPHES_EXP_P0);
+      y = MulAdd(y, r, Number(CEPHES_EXP_P1));
+      y = MulAdd(y, r, Number(CEPHES_EXP_P2));
+      y = MulAdd(y, r, Number(CEPHES_EXP_P3));
+      y = MulAdd(y, r, Number(CEPHES_EXP_P4));
+      y = MulAdd(y, r, Number(CEPHES_EXP_P5));
+    }
     y = MulAdd(y, r2, r);
     y = Add(y, Number(ONE));
 
@@ -1529,10 +1728,37 @@ Express::Var *Express::Exp(Var *x) {
 // Compute 13/6-degree rational interpolant which is accurate up to a couple of
 // ulp in the range [-9, 9], outside of which the fl(tanh(x)) = +/-1.
 // See: https://git.io/vHyiz
+// The lower precision tiers use 9/4-degree and 5/4-degree rational
+// approximations in a narrower range, where the numerator and denominator are
+// normalized so tanh(x) ~ x around zero.
 Express::Var *Express::Tanh(Var *x) {
   if (target_ == NVIDIA) {
     // Compute tanh(x) = 2*sigmoid(2*x) - 1.
     return Sub(Mul(Sigmoid(Mul(x, Number(TWO))), Number(TWO)), Number(ONE));
+  } else if (precision_ == FASTEST) {
+    x = Max(Min(x, Number(TANH_FASTEST_HI)), Number(TANH_FASTEST_LO));
+    Var *x2 = Mul(x, x);
+    Var *p = Number(TANH_FASTEST_ALPHA_5);
+    p = MulAdd(x2, p, Number(TANH_FASTEST_ALPHA_3));
+    p = MulAdd(x2, p, Number(ONE));
+    p = Mul(x, p);
+    Var *q = Number(TANH_FASTEST_BETA_4);
+    q = MulAdd(x2, q, Number(TANH_FASTEST_BETA_2));
+    q = MulAdd(x2, q, Number(ONE));
+    return Div(p, q);
+  } else if (precision_ == FAST) {
+    x = Max(Min(x, Number(TANH_FAST_HI)), Number(TANH_FAST_LO));
+    Var *x2 = Mul(x, x);
+    Var *p = Number(TANH_FAST_ALPHA_9);
+    p = MulAdd(x2, p, Number(TANH_FAST_ALPHA_7));
+    p = MulAdd(x2, p, Number(TANH_FAST_ALPHA_5));
+    p = MulAdd(x2, p, Number(TANH_FAST_ALPHA_3));
+    p = MulAdd(x2, p, Number(ONE));
+    p = Mul(x, p);
+    Var *q = Number(TANH_FAST_BETA_4);
+    q = MulAdd(x2, q, Number(TANH_FAST_BETA_2));
+    q = MulAdd(x2, q, Number(ONE));
+    return Div(p, q);
   } else {
     // Clamp the inputs to the range [-9, 9] since anything outside this range
     // is +/-1.0.
@@ -129,9 +129,27 @@ class Express {
     CEPHES_EXP_P4, CEPHES_EXP_P5,
     ALPHA_1, ALPHA_3, ALPHA_5, ALPHA_7, ALPHA_9, ALPHA_11, ALPHA_13,
     BETA_0, BETA_2, BETA_4, BETA_6,
+    EXP_FAST_P0, EXP_FAST_P1, EXP_FAST_P2,
+    EXP_FASTEST_P0, EXP_FASTEST_P1,
+    LOG_FAST_P0, LOG_FAST_P1, LOG_FAST_P2, LOG_FAST_P3, LOG_FAST_P4,
+    LOG_FASTEST_P0, LOG_FASTEST_P1, LOG_FASTEST_P2,
+    TANH_FAST_HI, TANH_FAST_LO,
+    TANH_FAST_ALPHA_3, TANH_FAST_ALPHA_5, TANH_FAST_ALPHA_7, TANH_FAST_ALPHA_9,
+    TANH_FAST_BETA_2, TANH_FAST_BETA_4,
+    TANH_FASTEST_HI, TANH_FASTEST_LO,
+    TANH_FASTEST_ALPHA_3, TANH_FASTEST_ALPHA_5,
+    TANH_FASTEST_BETA_2, TANH_FASTEST_BETA_4,
     NUM_CONSTANTS,
   };
 
+  // Precision tiers for expanding intrinsic functions (exp, log, tanh, and
+  // sigmoid) into basic operations. The lower tiers use approximations with
+  // lower-degree polynomials which need fewer operations:
+  //   PRECISE: a couple of ulp (default).
+  //   FAST:    max error around 1e-5.
+  //   FASTEST: max error around 1e-4.
+  enum Precision {PRECISE, FAST, FASTEST};
+
   // Variable mapping.
   typedef std::map<Var *, Var *> Map;
 
@@ -255,6 +273,10 @@ class Express {
   // functions can be expanded into basic operations.
   void Parse(const string &recipe, bool expand = false);
 
+  // Precision used for expanding intrinsic functions.
+  Precision precision() const { return precision_; }
+  void set_precision(Precision precision) { precision_ = precision; }
+
   // Return recipe for expression.
   void GetRecipe(string *recipe) const;
   string AsRecipe() const {
@@ -304,6 +326,14 @@ class Express {
   // Cache inputs and results used in multiple ops in temporary variables.
   void CacheResults();
 
+  // Reorder the operations in the body to reduce the number of temporary
+  // variables that are live at the same time. Operations are list scheduled
+  // in dependency order, and loads from inputs are kept in order with respect
+  // to stores to outputs since these can share memory. The new order is only
+  // used if it lowers the register pressure. Returns true if the operations
+  // were reordered.
+  bool Schedule();
+
   // Compute live range for each variable.
   void ComputeLiveRanges();
 
@@ -409,6 +439,13 @@ class Express {
   // Return op name for op type.
   static const string &OpName(OpType type);
 
+  // Look up precision tier by name, i.e. "precise", "fast", or "fastest".
+  // Return false for unknown names.
+  static bool LookupPrecision(const string &name, Precision *precision);
+
+  // Return name for precision tier.
+  static const char *PrecisionName(Precision precision);
+
   // Return value for system-defined numeric constant.
   static float NumericFlt32(int number) { return constants[number].flt; }
   static double NumericFlt64(int number) { return constants[number].dbl; }
@@ -443,6 +480,9 @@ class Express {
   // Target platform.
   Target target_;
 
+  // Precision for expanding intrinsic functions.
+  Precision precision_ = PRECISE;
+
   // System-defined numeric constants.
   struct Constant { float flt; double dbl; };
   static Constant constants[NUM_CONSTANTS];
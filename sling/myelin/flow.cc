@@ -849,23 +849,40 @@ void Flow::Save(const string &filename, int version) const {
   }
 }
 
-void Flow::Analyze(const Transformations &transformations) {
+void Flow::Analyze(const Transformations &transformations,
+                   CompileStats *stats) {
+  CompileStats::Timer timer(stats);
+
   // Infer input and output variables.
   InferInputsAndOutputs();
+  timer.Mark("analyze inputs/outputs");
 
   // Run first round of transformations.
-  Transform(transformations);
+  Transform(transformations, stats);
+  timer.Mark("analyze transform");
 
   // Sort ops and vars in dependency order.
   Sort();
+  timer.Mark("analyze sort");
 
   // Infer missing types and shapes for variables.
   InferTypes(transformations);
+  timer.Mark("analyze type inference");
 
   // Run second round of transformations after types have been resolved.
-  if (Transform(transformations)) {
+  if (Transform(transformations, stats)) {
+    timer.Mark("analyze transform");
+
     // Make sure ops are still sorted after second round of transformations.
     Sort();
+    timer.Mark("analyze sort");
+  } else {
+    timer.Mark("analyze transform");
+  }
+
+  if (stats != nullptr) {
+    stats->Increment("flow operations", ops_.size());
+    stats->Increment("flow variables", vars_.size());
   }
 }
 
@@ -916,7 +933,8 @@ void Flow::InferInputsAndOutputs() {
   }
 }
 
-bool Flow::Transform(const Transformations &transformations) {
+bool Flow::Transform(const Transformations &transformations,
+                     CompileStats *stats) {
   // Keep transforming flow until no more transformations can be applied.
   bool again = true;
   bool transformed = false;
@@ -928,8 +946,10 @@ bool Flow::Transform(const Transformations &transformations) {
       if (transformers[t]->Transform(this)) {
         transformed = true;
         again = true;
+        if (stats != nullptr) stats->Increment("transformations applied");
       }
     }
+    if (stats != nullptr) stats->Increment("transform iterations");
   }
   return transformed;
 }
@@ -21,6 +21,7 @@
 
 #include "sling/base/status.h"
 #include "sling/base/types.h"
+#include "sling/myelin/compile-stats.h"
 
 namespace sling {
 namespace myelin {
@@ -486,8 +487,10 @@ class Flow {
   // Save flow to file.
   void Save(const string &filename, int version = kVersion) const;
 
-  // Analyze flow.
-  void Analyze(const Transformations &transformations);
+  // Analyze flow. Timing and counters for the analysis phases are added to the
+  // compilation statistics if these are provided.
+  void Analyze(const Transformations &transformations,
+               CompileStats *stats = nullptr);
 
   // Add variable.
   Variable *AddVariable(const string &name,
@@ -601,7 +604,8 @@ class Flow {
 
   // Apply transformations to flow graph. Returns false if no transformations
   // were applied.
-  bool Transform(const Transformations &transformations);
+  bool Transform(const Transformations &transformations,
+                 CompileStats *stats = nullptr);
 
   // Sort operations in topological order of computation.
   void Sort();
@@ -219,7 +219,7 @@ void ElementwiseIndexGenerator::EndLoop() {
   MacroAssembler *masm = masm_;
   if (!single_) {
     // Move to next output element.
-    __ addq(offset_, Immediate(vecsize_));
+    __ addq(offset_, Immediate(vecsize_ * unroll_));
 
     // Update iterators.
     for (Iterator *it : iterators_) {
@@ -267,6 +267,20 @@ void ElementwiseIndexGenerator::EndLoop() {
   }
 }
 
+int ElementwiseIndexGenerator::Unroll(int copies) {
+  // Loops with repeat or broadcast iterators cannot be unrolled.
+  if (single_) return 1;
+  for (Iterator *it : iterators_) {
+    if (it->type == REPEAT || it->type == BROADCAST) return 1;
+  }
+
+  // The number of elements must be a multiple of the unrolled loop size.
+  size_t size = element_size() * shape_.elements();
+  while (copies > 1 && size % (vecsize_ * copies) != 0) copies /= 2;
+  unroll_ = copies;
+  return unroll_;
+}
+
 Operand ElementwiseIndexGenerator::addr(Express::Var *var) {
   if (var->type == Express::NUMBER) {
     // System-defined constant.
@@ -323,14 +337,16 @@ Operand ElementwiseIndexGenerator::addr(Express::Var *var) {
             return Operand(masm_->instance(), loc->var->offset());
           }
         } else {
-          // Multiple iterations.
+          // Multiple iterations. Elements for unrolled copies of the loop
+          // body follow each other.
+          int disp = copy_ * vecsize_;
           if (loc->base.is_valid()) {
             // Index element using base register and index.
-            return Operand(loc->base, offset_);
+            return Operand(loc->base, offset_, times_1, disp);
           } else {
             // Index element using offset in instance and index.
             return Operand(masm_->instance(), offset_, times_1,
-                           loc->var->offset());
+                           loc->var->offset() + disp);
           }
         }
       case SCALAR:
@@ -49,6 +49,13 @@ class ElementwiseIndexGenerator : public IndexGenerator {
   // Return pointer to constant data.
   const void *data(Express::Var *var) override;
 
+  // Unroll loop. Only loops where all inputs are either scalars or have the
+  // same shape as the output can be unrolled.
+  int Unroll(int copies) override;
+
+  // Select copy of unrolled loop body.
+  void SelectCopy(int copy) override { copy_ = copy; }
+
   // Generate start and end of loop.
   void BeginLoop();
   void EndLoop();
@@ -124,6 +131,12 @@ class ElementwiseIndexGenerator : public IndexGenerator {
   // Whether only one iteration is needed.
   bool single_ = false;
 
+  // Number of copies of the loop body in each iteration.
+  int unroll_ = 1;
+
+  // Current copy of the loop body.
+  int copy_ = 0;
+
   // Input and output locators.
   std::vector<Locator> input_;
   std::vector<Locator> output_;
@@ -36,6 +36,7 @@ ExpressionGenerator *CreateVectorIntAVX256Generator();
 void ExpressionGenerator::Initalize(const Express &expression,
                                     Type type,
                                     int spare_regs,
+                                    int unroll,
                                     IndexGenerator *index) {
   // Copy expression.
   expression_.Copy(expression);
@@ -59,6 +60,9 @@ void ExpressionGenerator::Initalize(const Express &expression,
   // Cache inputs and results used in multiple ops in temporary variables.
   expression_.CacheResults();
 
+  // Reorder operations to reduce register pressure.
+  scheduled_ = expression_.Schedule();
+
   // Convert expression to instructions using instruction model.
   CHECK(expression_.Rewrite(model_, &instructions_));
 
@@ -71,6 +75,30 @@ void ExpressionGenerator::Initalize(const Express &expression,
   // Initialize index generator.
   index->Initialize(VectorSize());
 
+  // Find the registers used for temps in the loop body. Loop-invariant
+  // registers are shared between the unrolled copies of the loop body.
+  auto &ops = instructions_.ops();
+  int body = instructions_.body();
+  replica_.assign(instructions_.NumRegs(), -1);
+  std::vector<bool> shared(replica_.size());
+  for (int i = 0; i < body; ++i) {
+    if (ops[i]->dst != -1) shared[ops[i]->dst] = true;
+  }
+  body_regs_ = 0;
+  for (int i = body; i < ops.size(); ++i) {
+    for (int r : {ops[i]->dst, ops[i]->src, ops[i]->src2}) {
+      if (r != -1 && !shared[r] && replica_[r] == -1) {
+        replica_[r] = body_regs_++;
+      }
+    }
+  }
+
+  // Unroll loop body. Register-based inputs cannot be replicated.
+  unroll_ = 1;
+  if (unroll > 1 && instructions_.NumVars(Express::REGISTER) == 0) {
+    unroll_ = index->Unroll(unroll);
+  }
+
   // Reserve registers.
   Reserve();
 }
@@ -86,9 +114,33 @@ void ExpressionGenerator::GenerateInit(MacroAssembler *masm) {
 void ExpressionGenerator::GenerateBody(MacroAssembler *masm) {
   auto &ops = instructions_.ops();
   int body = instructions_.body();
+  if (unroll_ == 1) {
+    for (int i = body; i < ops.size(); ++i) {
+      if (!ops[i]->nop()) Generate(ops[i], masm);
+    }
+    return;
+  }
+
+  // Interleave the instructions for the unrolled copies of the loop body.
+  // Each copy uses its own set of registers for the temps in the body, so
+  // the copies form independent dependency chains.
+  int base = instructions_.NumRegs();
+  auto rename = [&](int r, int copy) {
+    if (r == -1 || copy == 0 || replica_[r] == -1) return r;
+    return base + (copy - 1) * body_regs_ + replica_[r];
+  };
   for (int i = body; i < ops.size(); ++i) {
-    if (!ops[i]->nop()) Generate(ops[i], masm);
+    if (ops[i]->nop()) continue;
+    for (int copy = 0; copy < unroll_; ++copy) {
+      Express::Op instr(*ops[i]);
+      instr.dst = rename(instr.dst, copy);
+      instr.src = rename(instr.src, copy);
+      instr.src2 = rename(instr.src2, copy);
+      index_->SelectCopy(copy);
+      Generate(&instr, masm);
+    }
   }
+  index_->SelectCopy(0);
 }
 
 ExpressionGenerator *ExpressionGenerator::Select(const Express &expr,
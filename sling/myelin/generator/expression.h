@@ -55,10 +55,12 @@ class ExpressionGenerator {
   // Generate code for instruction.
   virtual void Generate(Express::Op *instr, MacroAssembler *masm) = 0;
 
-  // Initialize expression generator.
+  // Initialize expression generator. The loop body is unrolled into the
+  // requested number of copies if this is supported by the index generator.
   void Initalize(const Express &expression,
                  Type type,
                  int spare_regs,
+                 int unroll,
                  IndexGenerator *index);
 
   // Generate code for loop-invariant part of expression.
@@ -67,6 +69,24 @@ class ExpressionGenerator {
   // Generate code for loop body.
   void GenerateBody(MacroAssembler *masm);
 
+  // Instructions for generating expression.
+  const Express &instructions() const { return instructions_; }
+
+  // Whether the operations in the expression were reordered by the scheduler.
+  bool scheduled() const { return scheduled_; }
+
+  // Number of copies of the loop body in each loop iteration.
+  int unroll() const { return unroll_; }
+
+  // Number of registers for temps computed in the loop body. These registers
+  // are replicated for each unrolled copy of the loop body.
+  int BodyRegisters() const { return body_regs_; }
+
+  // Total number of registers needed for all copies of the loop body.
+  int RegisterCount() const {
+    return instructions_.NumRegs() + (unroll_ - 1) * body_regs_;
+  }
+
   // Select expression generator for expression that is supported by the CPU.
   static ExpressionGenerator *Select(const Express &expr,
                                      Type type, int size);
@@ -357,6 +377,17 @@ class ExpressionGenerator {
 
   // Instructions for generating expression.
   Express instructions_;
+
+  // Whether the expression operations were reordered by the scheduler.
+  bool scheduled_ = false;
+
+  // Number of copies of the loop body.
+  int unroll_ = 1;
+
+  // Mapping from registers to replicated body registers (-1 for registers
+  // that are shared between copies of the loop body).
+  std::vector<int> replica_;
+  int body_regs_ = 0;
 };
 
 // Error handler for unsupported operations.
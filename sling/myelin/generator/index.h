@@ -44,6 +44,14 @@ class IndexGenerator {
   // Return pointer to constant data.
   virtual const void *data(Express::Var *var) = 0;
 
+  // Unroll loop so each iteration computes the requested number of copies of
+  // the loop body. Returns the number of copies supported by the index
+  // generator, which is one if the loop cannot be unrolled.
+  virtual int Unroll(int copies) { return 1; }
+
+  // Select copy of the unrolled loop body for addressing memory variables.
+  virtual void SelectCopy(int copy) {}
+
   // Return register for accessing temporary variable.
   jit::Register reg(int idx) { return regs_[idx]; }
   jit::XMMRegister xmm(int idx) {
@@ -46,7 +46,7 @@ class ScalarFltAVXGenerator : public ExpressionGenerator {
 
   void Reserve() override {
     // Reserve XMM registers.
-    index_->ReserveXMMRegisters(instructions_.NumRegs());
+    index_->ReserveXMMRegisters(RegisterCount());
 
     // Allocate auxiliary registers.
     int num_mm_aux = 0;
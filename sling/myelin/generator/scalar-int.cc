@@ -42,7 +42,7 @@ class ScalarIntGenerator : public ExpressionGenerator {
 
   void Reserve() override {
     // Reserve registers for temps.
-    index_->ReserveRegisters(instructions_.NumRegs());
+    index_->ReserveRegisters(RegisterCount());
 
     if (instructions_.Has(Express::DIV)) {
       // Reserve rax and rdx for integer division.
@@ -48,7 +48,7 @@ class VectorFltAVX128Generator : public ExpressionGenerator {
 
   void Reserve() override {
     // Reserve XMM registers.
-    index_->ReserveXMMRegisters(instructions_.NumRegs());
+    index_->ReserveXMMRegisters(RegisterCount());
   }
 
   void Generate(Express::Op *instr, MacroAssembler *masm) override {
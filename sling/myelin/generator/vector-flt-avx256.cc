@@ -48,7 +48,7 @@ class VectorFltAVX256Generator : public ExpressionGenerator {
 
   void Reserve() override {
     // Reserve YMM registers.
-    index_->ReserveYMMRegisters(instructions_.NumRegs());
+    index_->ReserveYMMRegisters(RegisterCount());
 
     // Allocate auxiliary registers.
     int num_mm_aux = 0;
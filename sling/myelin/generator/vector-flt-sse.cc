@@ -43,7 +43,7 @@ class VectorFltSSEGenerator : public ExpressionGenerator {
 
   void Reserve() override {
     // Reserve XMM registers.
-    index_->ReserveXMMRegisters(instructions_.NumRegs());
+    index_->ReserveXMMRegisters(RegisterCount());
   }
 
   void Generate(Express::Op *instr, MacroAssembler *masm) override {
@@ -43,7 +43,7 @@ class VectorIntAVX128Generator : public ExpressionGenerator {
 
   void Reserve() override {
     // Reserve XMM registers for temps.
-    index_->ReserveXMMRegisters(instructions_.NumRegs());
+    index_->ReserveXMMRegisters(RegisterCount());
 
     // Reserve auxiliary registers.
     int num_rr_aux = 0;
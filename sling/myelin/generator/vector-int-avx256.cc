@@ -43,7 +43,7 @@ class VectorIntAVX256Generator : public ExpressionGenerator {
 
   void Reserve() override {
     // Reserve YMM registers for temps.
-    index_->ReserveYMMRegisters(instructions_.NumRegs());
+    index_->ReserveYMMRegisters(RegisterCount());
 
     // Allocate auxiliary registers.
     int num_mm_aux = 0;
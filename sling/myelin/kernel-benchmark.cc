@@ -0,0 +1,725 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmark for Myelin kernels. For each benchmark case a flow with a
+// single operation is built and compiled once for every kernel in the library
+// that implements the operation. The kernels are isolated using singleton
+// libraries, so kernels that are normally shadowed by other kernels are also
+// measured. Timings are reported together with the attained fraction of the
+// roofline bound computed from the measured peak compute throughput and memory
+// bandwidth of the machine. The read and write bandwidth is measured for each
+// level of the memory hierarchy and the roofline for a kernel uses the
+// bandwidth of the fastest level that can hold its working set. The number of
+// operations and bytes accessed are computed from the shape of the operation,
+// so all the kernels for the same case are measured against the same bound.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/myelin/builder.h"
+#include "sling/myelin/compute.h"
+#include "sling/myelin/flow.h"
+#include "sling/myelin/kernel/tensorflow.h"
+#include "sling/string/printf.h"
+#include "third_party/jit/assembler.h"
+#include "third_party/jit/code.h"
+#include "third_party/jit/cpu.h"
+
+DEFINE_string(ops, "", "Comma-separated list of operations to benchmark");
+DEFINE_string(kernels, "", "Comma-separated list of kernels to benchmark");
+DEFINE_double(min_time, 50, "Minimum measurement time (ms) per kernel");
+DEFINE_int32(bandwidth_mb, 256, "Buffer size (MB) for bandwidth measurement");
+DEFINE_bool(csv, false, "Output results in CSV format");
+
+using namespace sling;
+using namespace sling::jit;
+using namespace sling::myelin;
+
+// Argument for benchmark operation.
+struct Argument {
+  Argument(Type type, const Shape &shape, int limit = 0)
+      : type(type), shape(shape), limit(limit) {}
+
+  Type type;              // argument type
+  Shape shape;            // argument shape
+  int limit;              // values are in [0;limit) for integer arguments
+  bool weights = false;   // constant tensor with random values
+  bool constant = false;  // constant scalar argument
+  int value = 0;          // value of constant argument
+};
+
+// Benchmark case with single operation.
+struct Benchmark {
+  string op;                    // operation type
+  string label;                 // description of case for report
+  std::vector<Argument> args;   // operation arguments
+  Type type;                    // result type
+  Shape shape;                  // result shape
+  string expr;                  // expression recipe for Calculate ops
+  int sparse = -1;              // argument that is only accessed sparsely
+  int64 flops = 0;              // number of operations for the case
+
+  // Number of bytes read by the operation. Sparsely accessed arguments only
+  // contribute with the part that is copied to the output.
+  int64 reads() const {
+    int64 bytes = 0;
+    for (int i = 0; i < args.size(); ++i) {
+      const Argument &arg = args[i];
+      if (arg.constant || i == sparse) continue;
+      bytes += static_cast<int64>(arg.shape.elements()) *
+               TypeTraits::of(arg.type).size();
+    }
+    if (sparse != -1) bytes += writes();
+    return bytes;
+  }
+
+  // Number of bytes written by the operation.
+  int64 writes() const {
+    return static_cast<int64>(shape.elements()) * TypeTraits::of(type).size();
+  }
+};
+
+// Memory bandwidth for level in memory hierarchy.
+struct MemoryLevel {
+  string name;                  // level name
+  int64 size;                   // largest working set held by level
+  double read;                  // peak read bandwidth in GB/s
+  double write;                 // peak write bandwidth in GB/s
+};
+
+// Machine peak performance.
+struct Peak {
+  double gflops;                      // peak compute throughput
+  double gops;                        // peak 8-bit integer throughput
+  std::vector<MemoryLevel> levels;    // memory bandwidth for each level
+
+  // Return the fastest memory level that can hold the working set.
+  const MemoryLevel &level(int64 size) const {
+    for (const MemoryLevel &l : levels) {
+      if (size <= l.size) return l;
+    }
+    return levels.back();
+  }
+};
+
+// Run code repeatedly until the minimum measurement time has been reached and
+// return the time in nanoseconds per iteration.
+template <typename F> static double Measure(const F &func) {
+  func(1);
+  int64 n = 1;
+  for (;;) {
+    Clock clock;
+    clock.start();
+    func(n);
+    clock.stop();
+    if (clock.ms() >= FLAGS_min_time) return clock.ns() / n;
+    n *= 2;
+  }
+}
+
+// Measure code in short batches until the minimum measurement time has been
+// reached and return the time in nanoseconds per iteration for the fastest
+// batch. This is used for measuring the machine peak, which should not be
+// lowered by other activity on the machine.
+template <typename F> static double MeasureFastest(const F &func) {
+  static const double kBatchTime = 1.0;
+  func(1);
+  int64 n = 1;
+  double fastest;
+  for (;;) {
+    Clock clock;
+    clock.start();
+    func(n);
+    clock.stop();
+    fastest = clock.ns() / n;
+    if (clock.ms() >= kBatchTime) break;
+    n *= 2;
+  }
+  Clock total;
+  total.start();
+  do {
+    Clock clock;
+    clock.start();
+    func(n);
+    clock.stop();
+    double ns = clock.ns() / n;
+    if (ns < fastest) fastest = ns;
+    total.stop();
+  } while (total.ms() < FLAGS_min_time);
+  return fastest;
+}
+
+// Measure peak floating-point throughput using a loop of independent
+// multiply-add operations on the widest vector registers supported.
+static double MeasurePeakFlops() {
+  static const int kAccumulators = 12;
+  Assembler masm(nullptr, 0);
+  Label loop;
+  int flops;
+  if (CPU::Enabled(AVX)) {
+    for (int i = 0; i < 16; ++i) {
+      YMMRegister r = YMMRegister::from_code(i);
+      masm.vxorps(r, r, r);
+    }
+    masm.bind(&loop);
+    for (int i = 0; i < kAccumulators; ++i) {
+      YMMRegister acc = YMMRegister::from_code(i);
+      if (CPU::Enabled(FMA3)) {
+        masm.vfmadd231ps(acc, ymm14, ymm15);
+      } else if (i % 2 == 0) {
+        masm.vaddps(acc, acc, ymm15);
+      } else {
+        masm.vmulps(acc, acc, ymm15);
+      }
+    }
+    flops = kAccumulators * 8 * (CPU::Enabled(FMA3) ? 2 : 1);
+  } else {
+    for (int i = 0; i < 16; ++i) {
+      XMMRegister r = XMMRegister::from_code(i);
+      masm.xorps(r, r);
+    }
+    masm.bind(&loop);
+    for (int i = 0; i < kAccumulators; ++i) {
+      XMMRegister acc = XMMRegister::from_code(i);
+      if (i % 2 == 0) {
+        masm.addps(acc, xmm15);
+      } else {
+        masm.mulps(acc, xmm15);
+      }
+    }
+    flops = kAccumulators * 4;
+  }
+  masm.subq(arg_reg_1, Immediate(1));
+  masm.j(not_zero, &loop);
+  if (CPU::Enabled(AVX)) masm.vzeroupper();
+  masm.ret(0);
+
+  Code code;
+  code.Allocate(&masm);
+  double ns = MeasureFastest([&](int64 n) { code.Execute(n * 1024, 0); });
+  return flops * 1024 / ns;
+}
+
+// Measure peak 8-bit integer throughput using a loop of independent
+// multiply-add operations. Each multiply-add of a pair of bytes counts as two
+// operations. Returns zero if 8-bit multiply-adds are not supported.
+static double MeasurePeakIntOps() {
+  static const int kAccumulators = 12;
+  if (!CPU::Enabled(AVX2)) return 0.0;
+  Assembler masm(nullptr, 0);
+  Label loop;
+  for (int i = 0; i < 16; ++i) {
+    YMMRegister r = YMMRegister::from_code(i);
+    masm.vpxor(r, r, r);
+  }
+  masm.bind(&loop);
+  for (int i = 0; i < kAccumulators; ++i) {
+    masm.vpmaddubsw(YMMRegister::from_code(i), ymm14, ymm15);
+  }
+  int ops = kAccumulators * 32 * 2;
+  masm.subq(arg_reg_1, Immediate(1));
+  masm.j(not_zero, &loop);
+  masm.vzeroupper();
+  masm.ret(0);
+
+  Code code;
+  code.Allocate(&masm);
+  double ns = MeasureFastest([&](int64 n) { code.Execute(n * 1024, 0); });
+  return ops * 1024 / ns;
+}
+
+// Measure peak memory bandwidth by repeatedly loading or storing all the
+// vectors in a buffer. The buffer is split into a number of parts that are
+// accessed in parallel, like the rows of a weight matrix, so the hardware
+// prefetchers can track several streams.
+static double MeasurePeakBandwidth(int64 bytes, bool write) {
+  static const int kStreams = 4;
+  static const int kUnroll = 2;
+  int vecsize = CPU::Enabled(AVX) ? 32 : 16;
+  int stride = kUnroll * vecsize;
+  int64 part = bytes / kStreams / stride * stride;
+  bytes = part * kStreams;
+
+  Assembler masm(nullptr, 0);
+  Label loop;
+  Register ofs = rax;
+  Register base[kStreams] = {r8, r9, r10, r11};
+  for (int s = 0; s < kStreams; ++s) {
+    masm.leaq(base[s], Operand(arg_reg_1, s * part));
+  }
+  masm.xorq(ofs, ofs);
+  masm.bind(&loop);
+  for (int s = 0; s < kStreams; ++s) {
+    for (int i = 0; i < kUnroll; ++i) {
+      Operand mem(base[s], ofs, times_1, i * vecsize);
+      int reg = s * kUnroll + i;
+      if (CPU::Enabled(AVX)) {
+        YMMRegister acc = YMMRegister::from_code(reg);
+        if (write) {
+          masm.vmovaps(mem, acc);
+        } else {
+          masm.vmovaps(acc, mem);
+        }
+      } else {
+        XMMRegister acc = XMMRegister::from_code(reg);
+        if (write) {
+          masm.movaps(mem, acc);
+        } else {
+          masm.movaps(acc, mem);
+        }
+      }
+    }
+  }
+  masm.addq(ofs, Immediate(stride));
+  masm.cmpq(ofs, arg_reg_2);
+  masm.j(less, &loop);
+  if (CPU::Enabled(AVX)) masm.vzeroupper();
+  masm.ret(0);
+
+  Code code;
+  code.Allocate(&masm);
+  void *buffer;
+  CHECK_EQ(posix_memalign(&buffer, 64, bytes), 0);
+  memset(buffer, 0, bytes);
+  uint64 address = reinterpret_cast<uint64>(buffer);
+  double ns = MeasureFastest([&](int64 n) {
+    for (int64 i = 0; i < n; ++i) code.Execute(address, part);
+  });
+  free(buffer);
+  return bytes / ns;
+}
+
+// Measure peak store bandwidth for string stores. The copy and concat kernels
+// use string moves, which can store wider blocks than the vector registers
+// used by MeasurePeakBandwidth().
+static double MeasurePeakStringBandwidth(int64 bytes) {
+  Assembler masm(nullptr, 0);
+  masm.movq(rcx, arg_reg_2);
+  masm.repstosb();
+  masm.ret(0);
+
+  Code code;
+  code.Allocate(&masm);
+  void *buffer;
+  CHECK_EQ(posix_memalign(&buffer, 64, bytes), 0);
+  memset(buffer, 0, bytes);
+  uint64 address = reinterpret_cast<uint64>(buffer);
+  double ns = MeasureFastest([&](int64 n) {
+    for (int64 i = 0; i < n; ++i) code.Execute(address, bytes);
+  });
+  free(buffer);
+  return bytes / ns;
+}
+
+// Measure peak write bandwidth as the fastest of vector and string stores.
+static double MeasurePeakWriteBandwidth(int64 bytes) {
+  return std::max(MeasurePeakBandwidth(bytes, true),
+                  MeasurePeakStringBandwidth(bytes));
+}
+
+// Measure bandwidth for each cache level and main memory. A level holds the
+// working sets from the size of the level above it up to its own size, and
+// the bandwidth decreases with the size of the working set. The bandwidth for
+// a level is therefore measured at the small end of its range, i.e. just past
+// the size of the level above it, so it bounds the bandwidth for all the
+// working sets held by the level, including the ones that are still partially
+// held by the level above.
+static void MeasureMemoryLevels(std::vector<MemoryLevel> *levels) {
+  struct Cache { const char *name; int param; int64 fallback; };
+  static const Cache caches[] = {
+    {"L1", _SC_LEVEL1_DCACHE_SIZE, 32 << 10},
+    {"L2", _SC_LEVEL2_CACHE_SIZE, 256 << 10},
+    {"L3", _SC_LEVEL3_CACHE_SIZE, 8 << 20},
+  };
+  int64 above = 0;
+  for (const Cache &cache : caches) {
+    int64 size = sysconf(cache.param);
+    if (size <= 0) size = cache.fallback;
+    int64 bytes = above > 0 ? above + above / 4 : size / 2;
+    levels->push_back({cache.name, size,
+                       MeasurePeakBandwidth(bytes, false),
+                       MeasurePeakWriteBandwidth(bytes)});
+    above = size;
+  }
+  int64 bytes = static_cast<int64>(FLAGS_bandwidth_mb) << 20;
+  if (bytes < 2 * above) bytes = 2 * above;
+  levels->push_back({"DRAM", bytes,
+                     MeasurePeakBandwidth(bytes, false),
+                     MeasurePeakWriteBandwidth(bytes)});
+}
+
+// Fill buffer with n random values for argument.
+static void Randomize(const Argument &arg, char *data, int n) {
+  switch (arg.type) {
+    case DT_FLOAT: {
+      float *f = reinterpret_cast<float *>(data);
+      for (int i = 0; i < n; ++i) f[i] = (rand() % 2001 - 1000) / 1000.0;
+      break;
+    }
+    case DT_INT32: {
+      int32 *v = reinterpret_cast<int32 *>(data);
+      int limit = arg.limit > 0 ? arg.limit : 1000;
+      for (int i = 0; i < n; ++i) v[i] = rand() % limit;
+      break;
+    }
+    case DT_INT16: {
+      int16 *v = reinterpret_cast<int16 *>(data);
+      for (int i = 0; i < n; ++i) v[i] = rand() % 201 - 100;
+      break;
+    }
+    case DT_INT8: {
+      int8 *v = reinterpret_cast<int8 *>(data);
+      for (int i = 0; i < n; ++i) v[i] = rand() % 15 - 7;
+      break;
+    }
+    default:
+      memset(data, 0, n * TypeTraits::of(arg.type).size());
+  }
+}
+
+// Compile benchmark flow with a single kernel and measure its performance.
+// Returns false if the kernel does not support the benchmark case.
+static bool Run(const Benchmark &benchmark,
+                const Library &library,
+                const string &kernel,
+                double *ns) {
+  // Build flow with single operation.
+  Flow flow;
+  Builder tf(&flow, "benchmark");
+  std::vector<Flow::Variable *> args;
+  for (int i = 0; i < benchmark.args.size(); ++i) {
+    const Argument &arg = benchmark.args[i];
+    if (arg.constant) {
+      args.push_back(tf.Constant(arg.value));
+    } else if (arg.weights) {
+      int size = arg.shape.elements() * TypeTraits::of(arg.type).size();
+      std::vector<char> data(size);
+      Randomize(arg, data.data(), arg.shape.elements());
+      args.push_back(tf.Constant(data.data(), arg.type, arg.shape));
+    } else {
+      args.push_back(tf.Var("x" + std::to_string(i), arg.type, arg.shape));
+    }
+  }
+  Flow::Variable *y = tf.Op(benchmark.op, args);
+  y->type = benchmark.type;
+  y->shape = benchmark.shape;
+  if (!benchmark.expr.empty()) y->producer->SetAttr("expr", benchmark.expr);
+  if (benchmark.op == "ConcatV2") {
+    y->producer->SetAttr("N", static_cast<int>(args.size() - 1));
+  }
+
+  // Compile flow using a library with only the kernel being benchmarked.
+  Library singleton;
+  if (!library.Singleton(benchmark.op, kernel, &singleton)) return false;
+  flow.Analyze(singleton);
+
+  // Mark inputs as outputs to prevent the kernel from computing in place,
+  // since repeated evaluation would then operate on its own results.
+  for (Flow::Variable *arg : args) {
+    if (arg->data == nullptr) arg->out = true;
+  }
+
+  // Unsupported cases are expected, so compile errors are not logged.
+  Network network;
+  int loglevel = LogMessage::log_level();
+  LogMessage::set_log_level(FATAL);
+  bool compiled = network.Compile(flow, singleton);
+  LogMessage::set_log_level(loglevel);
+  if (!compiled) return false;
+  Cell *cell = network.GetCell("benchmark");
+  CHECK_EQ(cell->steps().size(), 1);
+
+  // Initialize inputs.
+  Instance data(cell);
+  for (int i = 0; i < args.size(); ++i) {
+    const Argument &arg = benchmark.args[i];
+    if (arg.constant || arg.weights) continue;
+    Tensor *tensor = network.GetParameter(args[i]->name);
+    if (tensor->ref()) continue;
+    int elements = tensor->size() / tensor->element_size();
+    Randomize(arg, data.GetAddress(tensor), elements);
+  }
+
+  // Measure kernel.
+  *ns = Measure([&](int64 n) {
+    for (int64 i = 0; i < n; ++i) data.Compute();
+  });
+  return true;
+}
+
+// Add benchmark cases for all the kernels.
+static void AddBenchmarks(std::vector<Benchmark> *benchmarks) {
+  // Vector-matrix multiplication.
+  static const int vecmat[][2] = {
+    {64, 64}, {128, 256}, {256, 256}, {512, 512}, {1024, 1024},
+  };
+  for (const char *op : {"MatMul", "MatMulAdd", "MatMulRelu",
+                         "MatMulAddRelu"}) {
+    bool bias = strstr(op, "Add") != nullptr;
+    for (auto &d : vecmat) {
+      int k = d[0], n = d[1];
+      Benchmark b;
+      b.op = op;
+      b.label = StringPrintf("f32 1x%d*%dx%d", k, k, n);
+      b.args.push_back({DT_FLOAT, {1, k}});
+      b.args.push_back({DT_FLOAT, {k, n}});
+      b.args.back().weights = true;
+      if (bias) {
+        b.args.push_back({DT_FLOAT, {n}});
+        b.args.back().weights = true;
+      }
+      b.type = DT_FLOAT;
+      b.shape = {1, n};
+      b.flops = 2 * k * n;
+      if (bias) b.flops += n;
+      if (strstr(op, "Relu") != nullptr) b.flops += n;
+      benchmarks->push_back(b);
+
+      // Quantized version.
+      b.label = StringPrintf("i8 1x%d*%dx%d", k, k, n);
+      b.args[0].type = DT_INT8;
+      b.args[1].type = DT_INT8;
+      if (bias) b.args[2].type = DT_INT16;
+      b.type = DT_INT16;
+      benchmarks->push_back(b);
+    }
+  }
+
+  // Matrix-matrix multiplication.
+  static const int matmat[][3] = {
+    {32, 64, 64}, {64, 128, 128}, {128, 256, 256}, {256, 256, 256},
+  };
+  for (auto &d : matmat) {
+    int m = d[0], k = d[1], n = d[2];
+    Benchmark b;
+    b.op = "MatMul";
+    b.label = StringPrintf("f32 %dx%d*%dx%d", m, k, k, n);
+    b.args.push_back({DT_FLOAT, {m, k}});
+    b.args.push_back({DT_FLOAT, {k, n}});
+    b.args.back().weights = true;
+    b.type = DT_FLOAT;
+    b.shape = {m, n};
+    b.flops = 2LL * m * k * n;
+    benchmarks->push_back(b);
+  }
+
+  // Embedding lookups.
+  static const int rows = 10000;
+  for (int dim : {32, 64, 256}) {
+    for (int n : {1, 8, 32}) {
+      Benchmark b;
+      b.op = "Gather";
+      b.label = StringPrintf("f32 %dx%d[%d]", rows, dim, n);
+      b.args.push_back({DT_FLOAT, {rows, dim}});
+      b.args.back().weights = true;
+      b.args.push_back({DT_INT32, {n}, rows});
+      b.type = DT_FLOAT;
+      b.shape = {n, dim};
+      b.sparse = 0;
+      benchmarks->push_back(b);
+    }
+  }
+
+  // Element-wise expressions. Each function counts as one operation per
+  // element regardless of how it is approximated.
+  static const char *unary[] = {"Exp", "Log", "Tanh", "Sigmoid", "Relu"};
+  static const char *binary[] = {"Add", "Mul", "Maximum"};
+  for (int size : {256, 4096, 65536}) {
+    for (const char *op : unary) {
+      Benchmark b;
+      b.op = op;
+      b.label = StringPrintf("f32 %d", size);
+      b.args.push_back({DT_FLOAT, {size}});
+      b.type = DT_FLOAT;
+      b.shape = {size};
+      b.flops = size;
+      benchmarks->push_back(b);
+    }
+    for (const char *op : binary) {
+      Benchmark b;
+      b.op = op;
+      b.label = StringPrintf("f32 %d", size);
+      b.args.push_back({DT_FLOAT, {size}});
+      b.args.push_back({DT_FLOAT, {size}});
+      b.type = DT_FLOAT;
+      b.shape = {size};
+      b.flops = size;
+      benchmarks->push_back(b);
+
+      b.label = StringPrintf("i32 %d", size);
+      b.args[0].type = b.args[1].type = b.type = DT_INT32;
+      benchmarks->push_back(b);
+    }
+
+    Benchmark b;
+    b.op = "Calculate";
+    b.expr = "@0=Tanh(Add(Mul(%0,%1),%2))";
+    b.label = StringPrintf("f32 %d tanh-fma", size);
+    for (int i = 0; i < 3; ++i) b.args.push_back({DT_FLOAT, {size}});
+    b.type = DT_FLOAT;
+    b.shape = {size};
+    b.flops = 3 * size;
+    benchmarks->push_back(b);
+  }
+
+  // Concatenation.
+  for (int size : {64, 1024, 16384}) {
+    Benchmark b;
+    b.op = "ConcatV2";
+    b.label = StringPrintf("f32 2x1x%d", size);
+    b.args.push_back({DT_FLOAT, {1, size}});
+    b.args.push_back({DT_FLOAT, {1, size}});
+    Argument axis(DT_INT32, {});
+    axis.constant = true;
+    axis.value = 1;
+    b.args.push_back(axis);
+    b.type = DT_FLOAT;
+    b.shape = {1, 2 * size};
+    benchmarks->push_back(b);
+  }
+
+  // Arg max.
+  for (int size : {64, 1024, 16384}) {
+    Benchmark b;
+    b.op = "ArgMax";
+    b.label = StringPrintf("f32 %d", size);
+    b.args.push_back({DT_FLOAT, {size}});
+    b.type = DT_INT32;
+    b.shape = {};
+    b.flops = size;
+    benchmarks->push_back(b);
+  }
+}
+
+// Check if name is selected by comma-separated filter.
+static bool Selected(const string &filter, const string &name) {
+  if (filter.empty()) return true;
+  size_t pos = 0;
+  for (;;) {
+    size_t end = filter.find(',', pos);
+    if (end == string::npos) return filter.compare(pos, end, name) == 0;
+    if (filter.compare(pos, end - pos, name) == 0) return true;
+    pos = end + 1;
+  }
+}
+
+// Quote CSV field if it contains commas, quotes, or line breaks.
+static string CSVField(const string &field) {
+  if (field.find_first_of(",\"\n") == string::npos) return field;
+  string quoted = "\"";
+  for (char c : field) {
+    if (c == '"') quoted.push_back('"');
+    quoted.push_back(c);
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+  CPU::Probe();
+
+  // Register kernels.
+  Library library;
+  RegisterTensorflowLibrary(&library);
+
+  // Measure machine peak performance.
+  Peak peak;
+  peak.gflops = MeasurePeakFlops();
+  peak.gops = std::max(MeasurePeakIntOps(), peak.gflops);
+  MeasureMemoryLevels(&peak.levels);
+  if (FLAGS_csv) {
+    std::cout << StringPrintf("# peak gflops=%.1f gops=%.1f",
+                              peak.gflops, peak.gops);
+    for (const MemoryLevel &level : peak.levels) {
+      std::cout << StringPrintf(" %s=%.1f/%.1f", level.name.c_str(),
+                                level.read, level.write);
+    }
+    std::cout << "\nop,kernel,case,ns,gflops,gbs,intensity,level,roofline\n";
+  } else {
+    std::cout << StringPrintf("Peak: %.1f GFLOPS, %.1f int8 GOPS",
+                              peak.gflops, peak.gops);
+    for (const MemoryLevel &level : peak.levels) {
+      std::cout << StringPrintf(", %s %.1f/%.1f GB/s", level.name.c_str(),
+                                level.read, level.write);
+    }
+    std::cout << " (read/write)";
+    std::cout << "\n\n";
+    std::cout << StringPrintf("%-14s %-26s %-36s %12s %9s %9s %7s %5s %6s\n",
+                              "op", "kernel", "case", "ns/op", "GFLOPS",
+                              "GB/s", "flop/B", "mem", "roof%");
+  }
+
+  // Run benchmarks for all selected kernels.
+  std::vector<Benchmark> benchmarks;
+  AddBenchmarks(&benchmarks);
+  for (const Benchmark &benchmark : benchmarks) {
+    if (!Selected(FLAGS_ops, benchmark.op)) continue;
+    for (Kernel *kernel : library.Lookup(benchmark.op)) {
+      string name = kernel->Name();
+      if (!Selected(FLAGS_kernels, name)) continue;
+      double ns;
+      if (!Run(benchmark, library, name, &ns)) {
+        VLOG(1) << name << " does not support " << benchmark.op << " "
+                << benchmark.label;
+        continue;
+      }
+
+      // Compare with the roofline bound using the bandwidth of the memory
+      // level holding the working set. The time for the operation is bounded
+      // by the time for the computation, the reads, and the writes, since
+      // these can overlap.
+      int64 reads = benchmark.reads();
+      int64 writes = benchmark.writes();
+      int64 bytes = reads + writes;
+      const MemoryLevel &level = peak.level(bytes);
+      double gflops = benchmark.flops / ns;
+      double gbs = bytes / ns;
+      double intensity = bytes == 0 ? 0 : benchmark.flops / double(bytes);
+      bool int8 = benchmark.args[0].type == DT_INT8;
+      double compute = int8 ? peak.gops : peak.gflops;
+      double bound = std::max(benchmark.flops / compute,
+                              std::max(reads / level.read,
+                                       writes / level.write));
+      double roofline = bound / ns;
+
+      if (FLAGS_csv) {
+        std::cout << StringPrintf("%s,%s,%s,%.2f,%.3f,%.3f,%.3f,%s,%.3f\n",
+                                  CSVField(benchmark.op).c_str(),
+                                  CSVField(name).c_str(),
+                                  CSVField(benchmark.label).c_str(),
+                                  ns, gflops,
+                                  gbs, intensity, level.name.c_str(),
+                                  roofline);
+      } else {
+        std::cout << StringPrintf(
+            "%-14s %-26s %-36s %12.1f %9.2f %9.2f %7.2f %5s %5.1f%%\n",
+            benchmark.op.c_str(), name.c_str(), benchmark.label.c_str(),
+            ns, gflops, gbs, intensity, level.name.c_str(),
+            roofline * 100);
+      }
+    }
+  }
+
+  return 0;
+}
@@ -22,6 +22,7 @@
 
 #include "sling/base/logging.h"
 #include "sling/base/types.h"
+#include "sling/myelin/compile-stats.h"
 #include "sling/myelin/compute.h"
 #include "sling/myelin/express.h"
 #include "sling/myelin/macro-assembler.h"
@@ -124,6 +125,20 @@ static void InitExpression(Flow::Operation *op, Express *expr, bool expand) {
 
 // Initialize expression for step.
 void InitExpression(const Step *step, Express *expr, bool expand) {
+  // Select precision for expanding intrinsics. The precision attribute on the
+  // step takes precedence over the network option.
+  Express::Precision precision = Express::PRECISE;
+  if (step->cell() != nullptr) {
+    precision = step->cell()->network()->options().math_precision;
+  }
+  if (step->HasAttr("precision")) {
+    const string &name = step->GetAttr("precision");
+    if (!Express::LookupPrecision(name, &precision)) {
+      LOG(WARNING) << "Unknown precision " << name << " for " << step->name();
+    }
+  }
+  expr->set_precision(precision);
+
   if (step->type() == "Calculate") {
     // Build expression from expression recipe attribute on op.
     const string &recipe = step->GetAttr("expr");
@@ -151,7 +166,8 @@ void InitExpression(const Step *step, Express *expr, bool expand) {
 // Expression code generator for element-wise operations.
 struct Expression {
   // Initialize expression.
-  Expression(const Step *step, MacroAssembler *masm, int spare_regs = 0)
+  Expression(const Step *step, MacroAssembler *masm, int spare_regs = 0,
+             int unroll = 1)
       : index(step, masm) {
     // Determine output type and shape from the first output.
     output = step->output(0);
@@ -174,7 +190,7 @@ struct Expression {
     CHECK(generator != nullptr);
 
     // Initialize expression and index generators.
-    generator->Initalize(expr, type, spare_regs, &index);
+    generator->Initalize(expr, type, spare_regs, unroll, &index);
   }
 
   ~Expression() { delete generator; }
@@ -192,6 +208,42 @@ struct Expression {
     index.EndLoop();
   }
 
+  // Report register usage and estimated throughput for the generated loop.
+  // The size of the loop body is also recorded in the step, so the profiler
+  // can report the achieved throughput for the loop.
+  void Report(Step *step, int spare_regs) {
+    const Express &instrs = generator->instructions();
+    int unroll = generator->unroll();
+    int body = 0;
+    for (int i = instrs.body(); i < instrs.ops().size(); ++i) {
+      if (!instrs.ops()[i]->nop()) body += unroll;
+    }
+    int regs = generator->RegisterCount();
+    int element_size = TypeTraits::of(output->type()).size();
+    int elements = unroll * generator->VectorSize() / element_size;
+    VLOG(5) << step->name() << ": " << generator->Name()
+            << " computes " << elements << " elements with "
+            << body << " instructions per iteration"
+            << ", unroll " << unroll
+            << ", " << regs << " registers"
+            << ", " << instrs.body() << " loop-invariant"
+            << ", " << spare_regs << " spare"
+            << (generator->scheduled() ? ", rescheduled" : "");
+
+    step->SetAttr("loop_elements", elements);
+    step->SetAttr("loop_instructions", body);
+
+    CompileStats *stats = step->cell()->compile_stats();
+    if (stats != nullptr) {
+      stats->Increment("expression kernels");
+      stats->Increment("expression loop instructions", body);
+      stats->Increment("expression loop elements", elements);
+      stats->Increment("expression registers", regs);
+      if (unroll > 1) stats->Increment("expressions unrolled");
+      if (generator->scheduled()) stats->Increment("expressions rescheduled");
+    }
+  }
+
   // Compute complexity.
   int64 Complexity() {
     return output->shape().elements() * expr.Complexity();
@@ -308,6 +360,11 @@ class ExpressionTransformer : public Transformer {
       if (output->shape != shape) return false;
     }
 
+    // Only combine ops with the same precision for intrinsics.
+    if (first->GetAttr("precision") != second->GetAttr("precision")) {
+      return false;
+    }
+
     // Check for indirect dependencies between ops.
     for (auto *v : second->inputs) {
       if (v->producer != first && v->DependsOn(first)) return false;
@@ -409,6 +466,9 @@ class ExpressionTransformer : public Transformer {
 // Kernel for computing arithmetic expressions.
 class Calculate : public Kernel {
  public:
+  // Maximum number of copies of the loop body in unrolled loops.
+  static const int kMaxUnroll = 4;
+
   Calculate(const string &name, const string &operation, int arity = -1)
       : name_(name), operation_(operation), arity_(arity) {}
 
@@ -471,11 +531,12 @@ class Calculate : public Kernel {
   }
 
   void Generate(Step *step, MacroAssembler *masm) override {
-    // Check how many spare register we have for hoisting constant out of the
-    // loop body. This is only done for floating-point operations to avoid
-    // register pressure on the regular x64 integer registers which are also
-    // used for the loop indexing.
+    // Check how many spare register we have for unrolling the loop and for
+    // hoisting constant out of the loop body. This is only done for
+    // floating-point operations to avoid register pressure on the regular x64
+    // integer registers which are also used for the loop indexing.
     int spare_regs = 0;
+    int unroll = 1;
     Type type = step->output(0)->type();
     if (type == DT_FLOAT || type == DT_DOUBLE) {
       // Perform dry-run to estimate the number of SIMD registers needed.
@@ -487,12 +548,33 @@ class Calculate : public Kernel {
       if (!dryrun_expr.index.single()) {
         while (dryrun_masm.mm().try_alloc() != -1) spare_regs++;
       }
+
+      // Use spare registers for unrolling the loop body to hide instruction
+      // latency. Each extra copy of the body needs its own registers for the
+      // temps. The remaining spare registers are used for hoisting constants.
+      int body_regs = dryrun_expr.generator->BodyRegisters();
+      unroll = kMaxUnroll;
+      while (unroll > 1 && (unroll - 1) * body_regs > spare_regs) unroll /= 2;
+      if (unroll > 1) {
+        // Fall back to the loop without unrolling if the unrolled body runs
+        // out of registers.
+        MacroAssembler unrolled_masm(nullptr, 0, masm->options());
+        Expression unrolled_expr(step, &unrolled_masm, 0, unroll);
+        if (unrolled_expr.AllocateRegisters()) {
+          unroll = unrolled_expr.generator->unroll();
+          spare_regs = 0;
+          while (unrolled_masm.mm().try_alloc() != -1) spare_regs++;
+        } else {
+          unroll = 1;
+        }
+      }
     }
 
     // Generate code for element-wise expression evaluation.
-    Expression expression(step, masm, spare_regs);
+    Expression expression(step, masm, spare_regs, unroll);
     CHECK(expression.AllocateRegisters()) << "Register overflow";
     expression.Generate(masm);
+    expression.Report(step, spare_regs);
   }
 
   int64 Complexity(const Step *step) override {
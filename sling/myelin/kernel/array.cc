@@ -12,6 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <vector>
+
 #include "sling/myelin/compute.h"
 #include "sling/myelin/macro-assembler.h"
 
@@ -423,45 +426,49 @@ class GeneralConcat : public Kernel {
     int prefix = step->output(0)->shape().outer(axis);
     __ bind(&l);
 
-    // Copy input tensors to output.
+    // Copy input tensors to output. Each input is copied to its offset in the
+    // output chunk. Only the elements are copied, not the padding of the
+    // input chunks.
     Tensor *output = step->output(0);
+    int offset = 0;
     for (int i = 0; i < n; ++i) {
       Tensor *input = step->input(i);
-      int size = axis > 0 ? input->stride(axis - 1) : input->size();
+      int size = input->shape().inner(axis) * input->element_size();
       if (size > 0 && size < 16) {
         int disp = 0;
         int left = size;
         while (left >= 8) {
           __ movq(acc, Operand(in[i], disp));
-          __ movq(Operand(out, disp), acc);
+          __ movq(Operand(out, offset + disp), acc);
           disp += 8;
           left -= 8;
         }
         while (left >= 4) {
           __ movl(acc, Operand(in[i], disp));
-          __ movl(Operand(out, disp), acc);
+          __ movl(Operand(out, offset + disp), acc);
           disp += 4;
           left -= 4;
         }
         while (left >= 2) {
           __ movw(acc, Operand(in[i], disp));
-          __ movw(Operand(out, disp), acc);
+          __ movw(Operand(out, offset + disp), acc);
           disp += 2;
           left -= 2;
         }
         while (left >= 1) {
           __ movb(acc, Operand(in[i], disp));
-          __ movb(Operand(out, disp), acc);
+          __ movb(Operand(out, offset + disp), acc);
           disp += 1;
           left -= 1;
         }
       } else {
         __ movq(src, in[i]);
-        __ movq(dst, out);
+        __ leaq(dst, Operand(out, offset));
         __ movq(cnt, Immediate(size));
         __ repmovsb();
       }
-      __ addq(in[i], Immediate(size));
+      __ addq(in[i], Immediate(axis > 0 ? input->stride(axis - 1) : size));
+      offset += size;
     }
 
     // Next chunk.
@@ -632,6 +639,296 @@ class MultiGather : public Kernel {
   }
 };
 
+// Look up multiple features in embedding and pool the embedding vectors into
+// a single vector. GatherSum adds the embedding vectors and GatherAvg computes
+// their mean. Negative feature indices are skipped, so multi-valued features
+// like affix lists can be padded with -1. If prefetching is enabled, the
+// embedding vectors for upcoming features are prefetched while the current
+// vector is being added. The prefetching kernels are only used for operations
+// with the prefetch attribute set.
+class PoolingGather : public Kernel {
+ public:
+  // Pooling operations.
+  enum Pooling {SUM, AVG};
+
+  // Number of features to prefetch ahead of the current feature.
+  static const int kPrefetchDistance = 8;
+
+  // Maximum number of YMM registers used for accumulating the sums.
+  static const int kMaxAccumulators = 14;
+
+  PoolingGather(Pooling pooling, bool prefetch = false)
+      : pooling_(pooling), prefetch_(prefetch) {}
+
+  string Name() override {
+    string name = pooling_ == SUM ? "PoolingGatherSum" : "PoolingGatherAvg";
+    if (prefetch_) name.append("Prefetch");
+    return name;
+  }
+  string Operation() override {
+    return pooling_ == SUM ? "GatherSum" : "GatherAvg";
+  }
+
+  bool Supports(Step *step) override {
+    // Check inputs and outputs.
+    if (step->indegree() != 2 || step->outdegree() != 1) return false;
+
+    // Check types.
+    Tensor *M = step->input(0);
+    Tensor *f = step->input(1);
+    Tensor *v = step->output(0);
+    if (f->type() != DT_INT32) return false;
+    if (M->type() != DT_FLOAT || M->rank() != 2) return false;
+    if (v->type() != DT_FLOAT || v->elements() != M->dim(1)) return false;
+
+    // Prefetching must be requested for the gather.
+    if (prefetch_ && !step->GetAttr("prefetch", false)) return false;
+
+    return true;
+  }
+
+  void Adjust(Step *step) override {
+    // Embedding matrix must be row-major.
+    Tensor *M = step->input(0);
+    Tensor *v = step->output(0);
+    M->SetRequiredOrder(ROW_MAJOR);
+
+    // Align embeddings and output for vectorized pooling.
+    if (Vectorized(step)) {
+      int align = 8 * sizeof(float);
+      M->MinAlign({1, 8});
+      M->SetMiniumAlignment(align);
+      v->SetMiniumAlignment(align);
+    }
+  }
+
+  void Generate(Step *step, MacroAssembler *masm) override {
+    // Get inputs and outputs.
+    Tensor *M = step->input(0);
+    Tensor *f = step->input(1);
+    Tensor *v = step->output(0);
+    int num_features = f->elements();
+    int dims = M->dim(1);
+
+    // Allocate registers.
+    Register input = masm->rr().alloc();
+    Register embeddings = masm->rr().alloc();
+    Register output = masm->rr().alloc();
+    Register col = masm->rr().alloc();
+    Register acc = masm->rr().alloc();
+    Register next = prefetch_ ? masm->rr().alloc() : no_reg;
+    Register count = masm->rr().alloc();
+
+    // Load tensor locations.
+    __ LoadTensorAddress(input, f);
+    __ LoadTensorAddress(embeddings, M);
+    __ LoadTensorAddress(output, v);
+
+    // Prefetch embedding vectors for the first features.
+    if (prefetch_) {
+      int n = std::min(num_features, kPrefetchDistance);
+      for (int i = 0; i < n; ++i) {
+        Operand feature(input, i * sizeof(int32));
+        PrefetchEmbedding(masm, next, feature, embeddings, M);
+      }
+    }
+
+    // Count the number of features for computing the mean.
+    if (pooling_ == AVG && num_features > 0) {
+      Label l1, l2;
+      __ xorq(count, count);
+      __ xorq(col, col);
+      __ LoopStart(&l1);
+      __ cmpl(Operand(input, col, times_4), Immediate(0));
+      __ j(less, &l2);
+      __ incq(count);
+      __ bind(&l2);
+      __ incq(col);
+      __ cmpq(col, Immediate(num_features));
+      __ j(not_equal, &l1);
+
+      // Avoid division by zero if there are no features.
+      Label l3;
+      __ testq(count, count);
+      __ j(not_zero, &l3);
+      __ incq(count);
+      __ bind(&l3);
+    }
+
+    if (Vectorized(step)) {
+      GenerateVectorized(masm, M, num_features, dims, input, embeddings,
+                         output, col, acc, next, count);
+    } else {
+      GenerateScalar(masm, M, num_features, dims, input, embeddings,
+                     output, col, acc, next, count);
+    }
+  }
+
+  int64 Complexity(const Step *step) override {
+    return step->input(1)->elements() * step->output(0)->elements();
+  }
+
+ private:
+  // Check if pooling can be done with AVX vectors.
+  static bool Vectorized(Step *step) {
+    return CPU::Enabled(AVX) && step->input(0)->dim(1) % 8 == 0;
+  }
+
+  // Prefetch embedding vector for feature unless feature index is negative.
+  static void PrefetchEmbedding(MacroAssembler *masm, Register addr,
+                                const Operand &feature, Register embeddings,
+                                Tensor *M) {
+    Label skip;
+    __ movsxlq(addr, feature);
+    __ testq(addr, addr);
+    __ j(negative, &skip);
+    __ Multiply(addr, M->stride(0));
+    __ addq(addr, embeddings);
+    __ Prefetch(addr, M->stride(0));
+    __ bind(&skip);
+  }
+
+  // Prefetch embedding vector for the feature that is kPrefetchDistance
+  // features ahead of the current feature.
+  static void PrefetchNextEmbedding(MacroAssembler *masm, Register addr,
+                                    Register input, Register col,
+                                    Register embeddings, Tensor *M,
+                                    int num_features) {
+    if (num_features <= kPrefetchDistance) return;
+    Label skip;
+    __ cmpq(col, Immediate(num_features - kPrefetchDistance));
+    __ j(greater_equal, &skip);
+    Operand feature(input, col, times_4, kPrefetchDistance * sizeof(int32));
+    PrefetchEmbedding(masm, addr, feature, embeddings, M);
+    __ bind(&skip);
+  }
+
+  // Generate pooling with the sums accumulated in AVX registers. Embedding
+  // vectors that do not fit into the registers are pooled in chunks.
+  void GenerateVectorized(MacroAssembler *masm, Tensor *M,
+                          int num_features, int dims,
+                          Register input, Register embeddings,
+                          Register output, Register col, Register acc,
+                          Register next, Register count) {
+    // Allocate registers.
+    int blocks = dims / 8;
+    int chunk_size = std::min(blocks, kMaxAccumulators);
+    std::vector<YMMRegister> sum;
+    for (int i = 0; i < chunk_size; ++i) sum.push_back(masm->mm().allocy());
+
+    // Broadcast the number of features for computing the mean.
+    YMMRegister divisor;
+    if (pooling_ == AVG) {
+      divisor = masm->mm().allocy();
+      __ vcvtqsi2ss(divisor.xmm(), divisor.xmm(), count);
+      __ vpermilps(divisor.xmm(), divisor.xmm(), 0);
+      __ vinsertf128(divisor, divisor, divisor.xmm(), 1);
+    }
+
+    for (int start = 0; start < blocks; start += chunk_size) {
+      int size = std::min(chunk_size, blocks - start);
+
+      // Clear sums.
+      for (int i = 0; i < size; ++i) {
+        __ vxorps(sum[i], sum[i], sum[i]);
+      }
+
+      // Add embedding vectors for all features.
+      if (num_features > 0) {
+        Label l1, l2;
+        __ xorq(col, col);
+        __ LoopStart(&l1);
+        if (prefetch_ && start == 0) {
+          PrefetchNextEmbedding(masm, next, input, col, embeddings, M,
+                                num_features);
+        }
+        __ movsxlq(acc, Operand(input, col, times_4));
+        __ testq(acc, acc);
+        __ j(negative, &l2);
+        __ Multiply(acc, M->stride(0));
+        __ addq(acc, embeddings);
+        for (int i = 0; i < size; ++i) {
+          int disp = (start + i) * 8 * sizeof(float);
+          __ vaddps(sum[i], sum[i], Operand(acc, disp));
+        }
+        __ bind(&l2);
+        __ incq(col);
+        __ cmpq(col, Immediate(num_features));
+        __ j(not_equal, &l1);
+      }
+
+      // Compute mean and store result.
+      for (int i = 0; i < size; ++i) {
+        if (pooling_ == AVG) __ vdivps(sum[i], sum[i], divisor);
+        __ vmovaps(Operand(output, (start + i) * 8 * sizeof(float)), sum[i]);
+      }
+    }
+  }
+
+  // Generate pooling with the sums accumulated in the output.
+  void GenerateScalar(MacroAssembler *masm, Tensor *M,
+                      int num_features, int dims,
+                      Register input, Register embeddings,
+                      Register output, Register col, Register acc,
+                      Register next, Register count) {
+    Register row = masm->rr().alloc();
+    XMMRegister elem = masm->mm().allocx();
+    Label l1, l2, l3, l4, l5;
+
+    // Clear output.
+    __ xorps(elem, elem);
+    __ xorq(row, row);
+    __ LoopStart(&l1);
+    __ movss(Operand(output, row, times_4), elem);
+    __ incq(row);
+    __ cmpq(row, Immediate(dims));
+    __ j(not_equal, &l1);
+    if (num_features == 0) return;
+
+    // Add embedding vectors for all features to output.
+    __ xorq(col, col);
+    __ LoopStart(&l2);
+    if (prefetch_) {
+      PrefetchNextEmbedding(masm, next, input, col, embeddings, M,
+                            num_features);
+    }
+    __ movsxlq(acc, Operand(input, col, times_4));
+    __ testq(acc, acc);
+    __ j(negative, &l4);
+    __ Multiply(acc, M->stride(0));
+    __ addq(acc, embeddings);
+    __ xorq(row, row);
+    __ LoopStart(&l3);
+    __ movss(elem, Operand(output, row, times_4));
+    __ addss(elem, Operand(acc, row, times_4));
+    __ movss(Operand(output, row, times_4), elem);
+    __ incq(row);
+    __ cmpq(row, Immediate(dims));
+    __ j(not_equal, &l3);
+    __ bind(&l4);
+    __ incq(col);
+    __ cmpq(col, Immediate(num_features));
+    __ j(not_equal, &l2);
+
+    // Divide output by the number of features to compute the mean.
+    if (pooling_ == AVG) {
+      XMMRegister divisor = masm->mm().allocx();
+      __ cvtqsi2ss(divisor, count);
+      __ xorq(row, row);
+      __ LoopStart(&l5);
+      __ movss(elem, Operand(output, row, times_4));
+      __ divss(elem, divisor);
+      __ movss(Operand(output, row, times_4), elem);
+      __ incq(row);
+      __ cmpq(row, Immediate(dims));
+      __ j(not_equal, &l5);
+    }
+  }
+
+  Pooling pooling_;  // pooling operation
+  bool prefetch_;    // prefetch embedding vectors for upcoming features
+};
+
 // Register array kernels.
 void RegisterArrayKernels(Library *library) {
   library->Register(new Reshape());
@@ -645,6 +942,12 @@ void RegisterArrayKernels(Library *library) {
   library->Register(new BasicConcat());
   library->Register(new MultiGather());
   library->Register(new SingleGather());
+  library->Register(new PoolingGather(PoolingGather::SUM));
+  library->Register(new PoolingGather(PoolingGather::AVG));
+  // The prefetching gathers take precedence for operations with the prefetch
+  // attribute set.
+  library->Register(new PoolingGather(PoolingGather::SUM, true));
+  library->Register(new PoolingGather(PoolingGather::AVG, true));
 }
 
 }  // namespace myelin
@@ -876,6 +876,221 @@ class AVXFltMatMatMul : public Kernel {
   }
 };
 
+// Vertical AVX float matrix-matrix multiplication, C = A * B. The result is
+// computed in blocks of rows of A and columns of B, where the block of C is kept
+// in registers. Each element of A is broadcast and multiplied with the rows
+// of the B block, so each load of B is reused for all the rows in the block.
+class AVXFltMatMatMulV : public Kernel {
+ public:
+  // Maximum number of rows in a block with and without FMA.
+  static const int kMaxFMARows = 6;
+  static const int kMaxRows = 4;
+
+  // Maximum number of ymm registers for the columns in a block.
+  static const int kMaxColumns = 2;
+
+  string Name() override { return "AVXFltMatMatMulV"; }
+  string Operation() override { return "MatMul"; }
+
+  bool Supports(Step *step) override {
+    // Requires CPU with AVX support.
+    if (!CPU::Enabled(AVX)) return false;
+
+    // Two float 2D tensor inputs and one 2D tensor output.
+    if (step->indegree() != 2) return false;
+    if (step->outdegree() != 1) return false;
+    Tensor *A = step->input(0);
+    Tensor *B = step->input(1);
+    Tensor *C = step->output(0);
+    if (A->rank() != 2 || A->type() != DT_FLOAT) return false;
+    if (B->rank() != 2 || B->type() != DT_FLOAT) return false;
+    if (C->rank() != 2 || C->type() != DT_FLOAT) return false;
+
+    // Transpose not supported.
+    if (step->GetAttr("transpose_a", false)) return false;
+    if (step->GetAttr("transpose_b", false)) return false;
+
+    // Check shape. The number of columns must be a multiple of the ymm size.
+    if (A->dim(0) != C->dim(0)) return false;
+    if (A->dim(1) != B->dim(0)) return false;
+    if (B->dim(1) != C->dim(1)) return false;
+    if (C->dim(1) % 8 != 0) return false;
+
+    // Check order.
+    if (!A->SupportsOrder(ROW_MAJOR)) return false;
+    if (!B->SupportsOrder(ROW_MAJOR)) return false;
+    if (!C->SupportsOrder(ROW_MAJOR)) return false;
+
+    return true;
+  }
+
+  void Adjust(Step *step) override {
+    Tensor *A = step->input(0);
+    Tensor *B = step->input(1);
+    Tensor *C = step->output(0);
+
+    // Align to one ymm register (256 bits, 32 bytes).
+    int byte_alignment = 256 / 8;
+    A->SetMiniumAlignment(byte_alignment);
+    B->SetMiniumAlignment(byte_alignment);
+    C->SetMiniumAlignment(byte_alignment);
+
+    // Rows of B and C must be aligned to ymm boundaries.
+    B->MinAlign({1, 8});
+    C->MinAlign({1, 8});
+
+    // Set order requirements.
+    A->SetRequiredOrder(ROW_MAJOR);
+    B->SetRequiredOrder(ROW_MAJOR);
+    C->SetRequiredOrder(ROW_MAJOR);
+  }
+
+  void Generate(Step *step, MacroAssembler *masm) override {
+    Registers &rr = masm->rr();
+    SIMDRegisters &mm = masm->mm();
+    Label l1;
+
+    // Get input and output tensors.
+    Tensor *A = step->input(0);
+    Tensor *B = step->input(1);
+    Tensor *C = step->output(0);
+
+    // FMA is not strict math compatible.
+    bool fma = masm->Enabled(FMA3);
+    if (step->GetAttr("strict", false)) {
+      fma = false;
+      step->set_variant("strict");
+    }
+
+    // Get matrix dimensions.
+    int rows = A->dim(0);
+    int cols = C->dim(1) / 8;
+
+    // Compute block size.
+    int block_rows = std::min(rows, fma ? kMaxFMARows : kMaxRows);
+    int block_cols = cols % kMaxColumns == 0 ? kMaxColumns : 1;
+    if (step->variant().empty()) {
+      step->set_variant(std::to_string(block_rows) + "x" +
+                        std::to_string(block_cols * 8));
+    }
+
+    // Allocate general registers.
+    Register a = rr.alloc();
+    Register b = rr.alloc();
+    Register c = rr.alloc();
+    Register colofs = rr.alloc();
+    Register kofs = rr.alloc();
+    Register row = rr.alloc();
+
+    // Allocate SIMD registers.
+    std::vector<YMMRegister> sum;
+    for (int i = 0; i < block_rows * block_cols; ++i) {
+      sum.push_back(mm.allocy());
+    }
+    std::vector<YMMRegister> elem;
+    for (int i = 0; i < block_cols; ++i) {
+      elem.push_back(mm.allocy());
+    }
+    YMMRegister x = mm.allocy();
+    YMMRegister acc = fma ? no_ymm_reg : mm.allocy();
+
+    // Load tensor locations.
+    __ LoadTensorAddress(a, A);
+    __ LoadTensorAddress(c, C);
+
+    // Loop over full row blocks and then the remaining rows.
+    int full_blocks = rows / block_rows;
+    int remaining_rows = rows % block_rows;
+    if (full_blocks > 1) {
+      __ xorq(row, row);
+      __ LoopStart(&l1);
+    }
+    if (full_blocks > 0) {
+      GenerateBlock(masm, A, B, C, block_rows, block_cols, fma,
+                    a, b, c, colofs, kofs, sum, elem, x, acc);
+    }
+    if (full_blocks > 1 || remaining_rows > 0) {
+      __ addq(a, Immediate(block_rows * A->stride(0)));
+      __ addq(c, Immediate(block_rows * C->stride(0)));
+    }
+    if (full_blocks > 1) {
+      __ incq(row);
+      __ cmpq(row, Immediate(full_blocks));
+      __ j(less, &l1);
+    }
+    if (remaining_rows > 0) {
+      GenerateBlock(masm, A, B, C, remaining_rows, block_cols, fma,
+                    a, b, c, colofs, kofs, sum, elem, x, acc);
+    }
+  }
+
+  int64 Complexity(const Step *step) override {
+    return step->input(0)->dim(0) * step->input(1)->elements() * 2;
+  }
+
+ private:
+  // Generate code for computing a block of rows of C. The columns of the rows
+  // are computed in blocks that are accumulated in registers.
+  void GenerateBlock(MacroAssembler *masm, Tensor *A, Tensor *B, Tensor *C,
+                     int block_rows, int block_cols, bool fma,
+                     Register a, Register b, Register c, Register colofs,
+                     Register kofs, const std::vector<YMMRegister> &sum,
+                     const std::vector<YMMRegister> &elem,
+                     YMMRegister x, YMMRegister acc) {
+    Label l1, l2;
+    int depth = A->dim(1);
+    int cols = C->dim(1) / 8;
+
+    // Loop over column blocks.
+    __ xorq(colofs, colofs);
+    __ LoopStart(&l1);
+    for (int i = 0; i < block_rows * block_cols; ++i) {
+      __ vxorps(sum[i], sum[i], sum[i]);
+    }
+    __ LoadTensorAddress(b, B);
+    __ addq(b, colofs);
+    __ xorq(kofs, kofs);
+
+    // Loop over depth, i.e. columns of A and rows of B.
+    __ LoopStart(&l2);
+    for (int j = 0; j < block_cols; ++j) {
+      __ vmovaps(elem[j], Operand(b, j * 32));
+    }
+    for (int r = 0; r < block_rows; ++r) {
+      // Multiply A[row,k] with B[k,col:col+n] and add to sum.
+      __ vbroadcastss(x, Operand(a, kofs, times_1, r * A->stride(0)));
+      for (int j = 0; j < block_cols; ++j) {
+        YMMRegister s = sum[r * block_cols + j];
+        if (fma) {
+          __ vfmadd231ps(s, x, elem[j]);
+        } else {
+          __ vmulps(acc, x, elem[j]);
+          __ vaddps(s, s, acc);
+        }
+      }
+    }
+    __ addq(b, Immediate(B->stride(0)));
+    __ addq(kofs, Immediate(sizeof(float)));
+    __ cmpq(kofs, Immediate(depth * sizeof(float)));
+    __ j(less, &l2);
+
+    // Save block to C[row:row+m,col:col+n].
+    for (int r = 0; r < block_rows; ++r) {
+      for (int j = 0; j < block_cols; ++j) {
+        Operand dst(c, colofs, times_1, r * C->stride(0) + j * 32);
+        __ vmovaps(dst, sum[r * block_cols + j]);
+      }
+    }
+
+    // Next column block.
+    if (cols > block_cols) {
+      __ addq(colofs, Immediate(block_cols * 32));
+      __ cmpq(colofs, Immediate(cols * 32));
+      __ j(less, &l1);
+    }
+  }
+};
+
 // Horizontal integer vector-matrix multiplication for CPUs with AVX2.
 class AVXIntVecMatMulHBase : public AVXVecMatMulBase {
  public:
@@ -1089,6 +1304,14 @@ void RegisterAVXMatMul(Library *library) {
   // Supports  : FMA3
   library->Register(new AVXFltMatMatMul());
 
+  // Computes  : C = A * B
+  // Input     : A: float32[k,n] row-major
+  //             B: float32[n,m] row-major
+  // Output    : C: float32[k,m] row-major
+  // Requires  : AVX
+  // Supports  : FMA3
+  library->Register(new AVXFltMatMatMulV());
+
   // Computes  : y = x * W
   // Input     : x: float32[1,n]
   //             W: float32[n,m] column-major
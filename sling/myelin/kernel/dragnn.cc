@@ -14,6 +14,11 @@
 
 #include "sling/myelin/kernel/dragnn.h"
 
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "sling/myelin/compute.h"
 #include "sling/myelin/macro-assembler.h"
 
@@ -24,6 +29,52 @@ namespace myelin {
 
 using namespace jit;
 
+// Number of features ahead of the current feature for which the embedding
+// vectors are prefetched in lookups. The prefetching lookups are only used for
+// lookup operations with the prefetch attribute set.
+static const int kPrefetchDistance = 8;
+
+// Prefetch embedding vector for feature. Negative features are mapped to the
+// OOV vector.
+static void PrefetchEmbedding(MacroAssembler *masm, Register addr,
+                              const Operand &feature, Register embeddings,
+                              Register oov, Tensor *M) {
+  __ movsxlq(addr, feature);
+  __ testq(addr, addr);
+  __ cmovq(negative, addr, oov);
+  __ Multiply(addr, M->stride(0));
+  __ addq(addr, embeddings);
+  __ Prefetch(addr, M->stride(0));
+}
+
+// Generate prefetching of the embedding vectors for the first features before
+// the lookup loop.
+static void PrefetchFirstEmbeddings(MacroAssembler *masm, Register addr,
+                                    Register input, Register embeddings,
+                                    Register oov, Tensor *M,
+                                    int num_features) {
+  int n = std::min(num_features, kPrefetchDistance);
+  for (int i = 0; i < n; ++i) {
+    Operand feature(input, i * sizeof(int32));
+    PrefetchEmbedding(masm, addr, feature, embeddings, oov, M);
+  }
+}
+
+// Generate prefetching of the embedding vector for the feature that is
+// kPrefetchDistance features ahead of the current feature in the lookup loop.
+static void PrefetchNextEmbedding(MacroAssembler *masm, Register addr,
+                                  Register input, Register col,
+                                  Register embeddings, Register oov, Tensor *M,
+                                  int num_features) {
+  if (num_features <= kPrefetchDistance) return;
+  Label skip;
+  __ cmpq(col, Immediate(num_features - kPrefetchDistance));
+  __ j(greater_equal, &skip);
+  Operand feature(input, col, times_4, kPrefetchDistance * sizeof(int32));
+  PrefetchEmbedding(masm, addr, feature, embeddings, oov, M);
+  __ bind(&skip);
+}
+
 // Stub for Dragnn initializer.
 class DragnnInitializer : public Kernel {
  public:
@@ -148,10 +199,17 @@ class DragnnCollect : public Kernel {
 };
 
 // Dragnn feature lookup operation for fixed features mapped through an
-// embedding matrix.
+// embedding matrix. If prefetching is enabled, the embedding vectors for the
+// upcoming features are prefetched while the current one is being added. The
+// features can have more than one row, in which case the embeddings for each
+// row of features are summed into the corresponding row of the output.
 class DragnnLookup : public Kernel {
  public:
-  string Name() override { return "DragnnLookup"; }
+  explicit DragnnLookup(bool prefetch = false) : prefetch_(prefetch) {}
+
+  string Name() override {
+    return prefetch_ ? "DragnnLookupPrefetch" : "DragnnLookup";
+  }
   string Operation() override { return "Lookup"; }
 
   bool Supports(Step *step) override {
@@ -162,10 +220,13 @@ class DragnnLookup : public Kernel {
     Tensor *f = step->input(0);
     Tensor *M = step->input(1);
     Tensor *v = step->output(0);
-    if (f->type() != DT_INT32) return false;
+    if (f->type() != DT_INT32 || f->rank() != 2) return false;
     if (M->type() != DT_FLOAT || M->rank() != 2) return false;
     if (v->type() != DT_FLOAT || v->rank() != 2) return false;
-    if (v->dim(0) != 1 || v->dim(1) != M->dim(1)) return false;
+    if (v->dim(0) != f->dim(0) || v->dim(1) != M->dim(1)) return false;
+
+    // Prefetching must be requested for the lookup.
+    if (prefetch_ && !step->GetAttr("prefetch", false)) return false;
 
     return true;
   }
@@ -178,7 +239,7 @@ class DragnnLookup : public Kernel {
   void Generate(Step *step, MacroAssembler *masm) override {
     Registers &rr = masm->rr();
     SIMDRegisters &mm = masm->mm();
-    Label l1, l2, l3, l4;
+    Label l0, l1, l2, l3, l4;
 
     // Get inputs and outputs.
     Tensor *f = step->input(0);
@@ -189,7 +250,8 @@ class DragnnLookup : public Kernel {
     int embedding_size = M->dim(0) - 1;
     int embedding_dims = v->dim(1);
 
-    // Get number input features.
+    // Get number of feature rows and input features per row.
+    int num_rows = f->dim(0);
     int num_features = f->dim(1);
 
     // Allocate registers.
@@ -200,17 +262,33 @@ class DragnnLookup : public Kernel {
     Register col = rr.alloc();
     Register row = rr.alloc();
     Register oov = rr.alloc();
+    Register next = prefetch_ ? rr.alloc() : no_reg;
+    Register batch = num_rows > 1 ? rr.alloc() : no_reg;
     XMMRegister elem = mm.allocx();
 
     // Load tensor locations.
     __ LoadTensorAddress(input, f);
     __ LoadTensorAddress(embeddings, M);
     __ LoadTensorAddress(output, v);
+    __ movq(oov, Immediate(embedding_size));
+
+    // Loop over feature rows.
+    if (num_rows > 1) {
+      __ xorq(batch, batch);
+      __ LoopStart(&l0);
+    }
 
     // Loop over input features.
-    __ movq(oov, Immediate(embedding_size));
+    if (prefetch_) {
+      PrefetchFirstEmbeddings(masm, next, input, embeddings, oov, M,
+                              num_features);
+    }
     __ xorq(col, col);
     __ LoopStart(&l1);
+    if (prefetch_) {
+      PrefetchNextEmbedding(masm, next, input, col, embeddings, oov, M,
+                            num_features);
+    }
 
     // Get next feature index.
     __ movsxlq(acc, Operand(input, col, times_4));
@@ -242,11 +320,23 @@ class DragnnLookup : public Kernel {
     __ incq(col);
     __ cmpq(col, Immediate(num_features));
     __ j(not_equal, &l1);
+
+    // Next row.
+    if (num_rows > 1) {
+      __ addq(input, Immediate(f->stride(0)));
+      __ addq(output, Immediate(v->stride(0)));
+      __ incq(batch);
+      __ cmpq(batch, Immediate(num_rows));
+      __ j(not_equal, &l0);
+    }
   }
 
   int64 Complexity(const Step *step) override {
-    return step->input(0)->elements() * step->output(0)->elements();
+    return step->input(0)->elements() * step->output(0)->dim(1);
   }
+
+ private:
+  bool prefetch_;  // prefetch embedding vectors for upcoming features
 };
 
 // Dragnn feature lookup operation for single fixed features mapped through an
@@ -329,10 +419,16 @@ class DragnnLookupSingle : public Kernel {
 
 // Dragnn feature lookup operation for fixed features mapped through an
 // embedding matrix. This can be used when the size of the embedding is small
-// enough to fit into registers.
+// enough to fit into registers. If prefetching is enabled, the embedding
+// vectors for the upcoming features are prefetched. Like the plain lookup, it
+// supports more than one row of features.
 class DragnnLookupUnrolled : public Kernel {
  public:
-  string Name() override { return "DragnnLookupUnrolled"; }
+  explicit DragnnLookupUnrolled(bool prefetch = false) : prefetch_(prefetch) {}
+
+  string Name() override {
+    return prefetch_ ? "DragnnLookupUnrolledPrefetch" : "DragnnLookupUnrolled";
+  }
   string Operation() override { return "Lookup"; }
 
   static const int kBlockSize = 8;
@@ -349,16 +445,19 @@ class DragnnLookupUnrolled : public Kernel {
     Tensor *f = step->input(0);
     Tensor *M = step->input(1);
     Tensor *v = step->output(0);
-    if (f->type() != DT_INT32) return false;
+    if (f->type() != DT_INT32 || f->rank() != 2) return false;
     if (M->type() != DT_FLOAT || M->rank() != 2) return false;
     if (v->type() != DT_FLOAT || v->rank() != 2) return false;
-    if (v->dim(0) != 1 || v->dim(1) != M->dim(1)) return false;
+    if (v->dim(0) != f->dim(0) || v->dim(1) != M->dim(1)) return false;
 
     // Check if embedding dimension allows us to unroll.
     int embedding_dims = M->dim(1);
     if (embedding_dims > kMaxEmbeddingDim) return false;
     if (embedding_dims % kBlockSize != 0) return false;
 
+    // Prefetching must be requested for the lookup.
+    if (prefetch_ && !step->GetAttr("prefetch", false)) return false;
+
     return true;
   }
 
@@ -377,7 +476,7 @@ class DragnnLookupUnrolled : public Kernel {
   void Generate(Step *step, MacroAssembler *masm) override {
     Registers &rr = masm->rr();
     SIMDRegisters &mm = masm->mm();
-    Label l1, l2, l3;
+    Label l0, l1, l2, l3;
 
     // Get inputs and outputs.
     Tensor *f = step->input(0);
@@ -388,7 +487,8 @@ class DragnnLookupUnrolled : public Kernel {
     int embedding_size = M->dim(0) - 1;
     int embedding_dims = v->dim(1);
 
-    // Get number of input features.
+    // Get number of feature rows and input features per row.
+    int num_rows = f->dim(0);
     int num_features = f->dim(1);
 
     // Allocate registers.
@@ -398,6 +498,8 @@ class DragnnLookupUnrolled : public Kernel {
     Register output = rr.alloc();
     Register col = rr.alloc();
     Register oov = rr.alloc();
+    Register next = prefetch_ ? rr.alloc() : no_reg;
+    Register batch = num_rows > 1 ? rr.alloc() : no_reg;
 
     // Allocate registers for summing embedding vectors.
     std::vector<YMMRegister> sum;
@@ -408,6 +510,13 @@ class DragnnLookupUnrolled : public Kernel {
     __ LoadTensorAddress(input, f);
     __ LoadTensorAddress(embeddings, M);
     __ LoadTensorAddress(output, v);
+    __ movq(oov, Immediate(embedding_size));
+
+    // Loop over feature rows.
+    if (num_rows > 1) {
+      __ xorq(batch, batch);
+      __ LoopStart(&l0);
+    }
 
     // Clear output vector.
     for (int i = 0; i < blocks; ++i) {
@@ -415,9 +524,16 @@ class DragnnLookupUnrolled : public Kernel {
     }
 
     // Loop over input features.
-    __ movq(oov, Immediate(embedding_size));
+    if (prefetch_) {
+      PrefetchFirstEmbeddings(masm, next, input, embeddings, oov, M,
+                              num_features);
+    }
     __ xorq(col, col);
     __ LoopStart(&l1);
+    if (prefetch_) {
+      PrefetchNextEmbedding(masm, next, input, col, embeddings, oov, M,
+                            num_features);
+    }
 
     // Get next feature index.
     __ movsxlq(acc, Operand(input, col, times_4));
@@ -449,11 +565,23 @@ class DragnnLookupUnrolled : public Kernel {
     for (int i = 0; i < blocks; ++i) {
       __ vmovaps(Operand(output, i * kBlockSize * sizeof(float)), sum[i]);
     }
+
+    // Next row.
+    if (num_rows > 1) {
+      __ addq(input, Immediate(f->stride(0)));
+      __ addq(output, Immediate(v->stride(0)));
+      __ incq(batch);
+      __ cmpq(batch, Immediate(num_rows));
+      __ j(not_equal, &l0);
+    }
   }
 
   int64 Complexity(const Step *step) override {
-    return step->input(0)->elements() * step->output(0)->elements();
+    return step->input(0)->elements() * step->output(0)->dim(1);
   }
+
+ private:
+  bool prefetch_;  // prefetch embedding vectors for upcoming features
 };
 
 // Type inference for Dragnn ops.
@@ -467,7 +595,7 @@ class DragnnTyper : public Typer {
         Flow::Variable *embeddings = op->inputs[1];
         Flow::Variable *result = op->outputs[0];
         if (features->rank() == 2 && embeddings->rank() == 2) {
-          result->shape.assign(1, embeddings->dim(1));
+          result->shape.assign(features->dim(0), embeddings->dim(1));
           return true;
         }
       }
@@ -564,14 +692,233 @@ class PrecomputedEmbeddings : public Transformer {
   }
 };
 
+// Maximum size in bytes of precomputed projection tables for feature
+// embeddings. Larger tables are not precomputed since lookups in these would
+// mostly miss the cache.
+static const int64 kMaxProjectionTableSize = 4 << 20;
+
+// Precompute first-layer projections for fixed features that are looked up in
+// embeddings and concatenated into the input of a matrix multiplication. The
+// matrix multiplication is split over the concatenated inputs, i.e.
+// concat(x_1,...,x_n) * W = x_1 * W_1 + ... + x_n * W_n, where W_i are the
+// rows of W for x_i. For each feature embedding E_i, the table E_i * W_i is
+// precomputed, so the projection of the feature becomes a lookup in the
+// table. A projection is only precomputed if the table is small and the
+// lookup needs fewer operations than the embedding lookup and multiplication.
+class PrecomputedProjections : public Transformer {
+ public:
+  bool Transform(Flow *flow) override {
+    // Find matrix multiplications. Splitting these adds and removes ops, so
+    // the candidates are collected first.
+    std::vector<Flow::Operation *> candidates;
+    for (Flow::Operation *op : flow->ops()) {
+      if (op->type == "MatMul" || op->type == "MatMulAdd" ||
+          op->type == "MatMulRelu" || op->type == "MatMulAddRelu") {
+        candidates.push_back(op);
+      }
+    }
+
+    int num_precompute = 0;
+    for (Flow::Operation *op : candidates) {
+      if (TrySplit(flow, op)) num_precompute++;
+    }
+    return num_precompute > 0;
+  }
+
+ private:
+  // Try to split matrix multiplication over concatenated feature embeddings.
+  bool TrySplit(Flow *flow, Flow::Operation *matmul) {
+    // Check for vector-matrix multiplication over concatenation.
+    if (matmul->indegree() < 2 || matmul->outdegree() != 1) return false;
+    Flow::Variable *x = matmul->inputs[0];
+    Flow::Variable *W = matmul->inputs[1];
+    Flow::Variable *y = matmul->outputs[0];
+    Flow::Operation *concat = x->producer;
+    if (concat == nullptr || concat->type != "ConcatV2") return false;
+    if (x->out || x->consumers.size() != 1) return false;
+    if (!W->constant() || W->type != DT_FLOAT || W->rank() != 2) return false;
+    if (x->rank() != 2 || x->dim(0) != 1 || x->dim(1) != W->dim(0)) return false;
+    int n = concat->GetAttr("N", 0);
+    int axis;
+    if (n < 1 || concat->indegree() != n + 1) return false;
+    if (!concat->inputs[n]->GetData(&axis) || axis != 1) return false;
+
+    // Find the concatenated feature embeddings where the projection can be
+    // precomputed.
+    int hidden = W->dim(1);
+    std::vector<int> offsets;
+    std::vector<Flow::Variable *> precomputed;
+    int offset = 0;
+    for (int i = 0; i < n; ++i) {
+      Flow::Variable *input = concat->inputs[i];
+      if (input->rank() != 2 || input->dim(0) != 1) return false;
+      offsets.push_back(offset);
+      offset += input->dim(1);
+      if (Precomputable(input, hidden)) precomputed.push_back(input);
+    }
+    if (offset != W->dim(0) || precomputed.empty()) return false;
+
+    // Collect the rows of the weight matrix for the remaining inputs.
+    const char *weights = W->data;
+    size_t row_size = hidden * sizeof(float);
+    std::vector<Flow::Variable *> remaining;
+    std::vector<int> remaining_offsets;
+    int remaining_dims = 0;
+    for (int i = 0; i < n; ++i) {
+      Flow::Variable *input = concat->inputs[i];
+      if (std::find(precomputed.begin(), precomputed.end(), input) ==
+          precomputed.end()) {
+        remaining.push_back(input);
+        remaining_offsets.push_back(offsets[i]);
+        remaining_dims += input->dim(1);
+      }
+    }
+
+    // Precompute the projection tables and change the embedding lookups to
+    // lookups in these.
+    string name = matmul->name;
+    std::vector<Flow::Variable *> inputs(concat->inputs.begin(),
+                                         concat->inputs.begin() + n);
+    std::vector<Flow::Variable *> terms;
+    for (int i = 0; i < n; ++i) {
+      Flow::Variable *input = inputs[i];
+      if (std::find(precomputed.begin(), precomputed.end(), input) ==
+          precomputed.end()) {
+        continue;
+      }
+      Flow::Operation *lookup = input->producer;
+      Flow::Variable *embedding = lookup->inputs[1];
+      int dims = input->dim(1);
+
+      // Slice of the weight matrix for the feature.
+      string prefix = name + "/" + std::to_string(i);
+      Flow::Variable *slice =
+          flow->AddVariable(prefix + "/weights", DT_FLOAT, {dims, hidden});
+      slice->data = const_cast<char *>(weights) + offsets[i] * row_size;
+      slice->size = dims * row_size;
+      slice->in = true;
+
+      // Multiply the embeddings with the weight matrix slice.
+      Flow::Variable *projection =
+          flow->AddVariable(embedding->name + "/" + prefix, DT_FLOAT,
+                            {embedding->dim(0), hidden});
+      flow->AddOperation(lookup->func, prefix + "/Precompute", "MatMul",
+                         {embedding, slice}, {projection});
+
+      // Look up feature in projection table.
+      lookup->ReplaceInput(embedding, projection);
+      input->shape.assign(1, hidden);
+      concat->RemoveInput(input);
+      terms.push_back(input);
+    }
+
+    // Determine the result of the matrix multiplication before activation.
+    bool relu = matmul->type == "MatMulRelu" || matmul->type == "MatMulAddRelu";
+    bool bias = matmul->type == "MatMulAdd" || matmul->type == "MatMulAddRelu";
+    Flow::Function *func = matmul->func;
+    if (remaining.empty()) {
+      // All inputs have been precomputed. The bias, if any, is added to the
+      // sum of the projections.
+      if (bias) terms.insert(terms.begin(), matmul->inputs[2]);
+      Flow::Variable *axis = concat->inputs.back();
+      flow->RemoveOperation(concat);
+      flow->RemoveOperation(matmul);
+      flow->DeleteVariable(x);
+      if (axis->consumers.empty() && !axis->out) flow->DeleteVariable(axis);
+    } else {
+      // Multiply the remaining inputs with the remaining weights.
+      char *data = flow->AllocateMemory(remaining_dims * row_size);
+      char *p = data;
+      for (int i = 0; i < remaining.size(); ++i) {
+        size_t size = remaining[i]->dim(1) * row_size;
+        memcpy(p, weights + remaining_offsets[i] * row_size, size);
+        p += size;
+      }
+      Flow::Variable *rest =
+          flow->AddVariable(name + "/weights", DT_FLOAT,
+                            {remaining_dims, hidden});
+      rest->data = data;
+      rest->size = remaining_dims * row_size;
+      rest->in = true;
+      concat->SetAttr("N", static_cast<int>(remaining.size()));
+      x->shape.assign(1, remaining_dims);
+      matmul->ReplaceInput(W, rest);
+      matmul->type = bias ? "MatMulAdd" : "MatMul";
+
+      Flow::Variable *partial =
+          flow->AddVariable(name + "/partial", DT_FLOAT, {1, hidden});
+      matmul->RemoveOutput(y);
+      matmul->AddOutput(partial);
+      terms.insert(terms.begin(), partial);
+    }
+    if (W->consumers.empty() && !W->out) flow->DeleteVariable(W);
+
+    // Sum the terms. A single projection is output directly by its lookup.
+    if (terms.size() == 1 && !relu) {
+      Flow::Operation *lookup = terms[0]->producer;
+      lookup->RemoveOutput(terms[0]);
+      lookup->AddOutput(y);
+      flow->DeleteVariable(terms[0]);
+      terms[0] = y;
+    }
+    Flow::Variable *sum = terms[0];
+    for (int i = 1; i < terms.size(); ++i) {
+      bool last = i == terms.size() - 1 && !relu;
+      Flow::Variable *result = last ? y :
+          flow->AddVariable(name + "/sum" + std::to_string(i), DT_FLOAT,
+                            {1, hidden});
+      flow->AddOperation(func, name + "/Add" + std::to_string(i), "Add",
+                         {sum, terms[i]}, {result});
+      sum = result;
+    }
+    if (relu) {
+      flow->AddOperation(func, name + "/Relu", "Relu", {sum}, {y});
+    }
+
+    VLOG(3) << "Precomputed " << precomputed.size() << " of " << n
+            << " feature projections for " << name;
+    return true;
+  }
+
+  // Check if projection of concatenated input can be precomputed. The input
+  // must be a lookup of features in an embedding matrix.
+  static bool Precomputable(Flow::Variable *input, int64 hidden) {
+    Flow::Operation *lookup = input->producer;
+    if (lookup == nullptr || lookup->type != "Lookup") return false;
+    if (lookup->indegree() != 2 || lookup->outdegree() != 1) return false;
+    if (input->out || input->consumers.size() != 1) return false;
+    Flow::Variable *feature = lookup->inputs[0];
+    Flow::Variable *embedding = lookup->inputs[1];
+    if (!embedding->constant() || embedding->type != DT_FLOAT) return false;
+    if (embedding->rank() != 2 || feature->rank() != 2) return false;
+    if (embedding->dim(1) != input->dim(1)) return false;
+
+    // Check size of precomputed table.
+    int64 rows = embedding->dim(0);
+    int64 dims = embedding->dim(1);
+    if (rows * hidden * sizeof(float) > kMaxProjectionTableSize) return false;
+
+    // The lookup in the projection table must need fewer operations than the
+    // embedding lookup and the multiplication with the weight slice.
+    int64 features = feature->dim(1);
+    if (features < 1) return false;
+    return features * hidden < features * dims + dims * hidden;
+  }
+};
+
 // Register Dragnn library.
 void RegisterDragnnLibrary(Library *library) {
   library->RegisterTyper(new DragnnTyper());
   library->RegisterTransformer(new PrecomputedEmbeddings());
+  library->RegisterTransformer(new PrecomputedProjections());
   library->RegisterTransformer(new DragnnTransformer());
   library->Register(new DragnnInitializer());
+  // Each prefetching lookup is registered after the plain one, so it takes
+  // precedence for lookups with the prefetch attribute set.
   library->Register(new DragnnLookup());
+  library->Register(new DragnnLookup(true));
   library->Register(new DragnnLookupUnrolled());
+  library->Register(new DragnnLookupUnrolled(true));
   library->Register(new DragnnLookupSingle());
   library->Register(new DragnnCollect());
 }
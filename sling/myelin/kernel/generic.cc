@@ -372,6 +372,21 @@ class StandardTyper : public Typer {
       }
     }
 
+    // Infer shape for gather with pooling. The embedding vectors for all the
+    // indices are pooled into a single vector.
+    if (op->type == "GatherSum" || op->type == "GatherAvg") {
+      if (op->indegree() == 2 && op->outdegree() == 1) {
+        Flow::Variable *params = op->inputs[0];
+        Flow::Variable *result = op->outputs[0];
+        result->type = params->type;
+        result->shape.assign(1);
+        for (int i = 1; i < params->shape.rank(); ++i) {
+          result->shape.add(params->shape.dim(i));
+        }
+        return true;
+      }
+    }
+
     // Infer shape for argmax operation.
     if (op->type == "ArgMax") {
       if (op->indegree() == 1 && op->outdegree() == 1) {
@@ -0,0 +1,266 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark for embedding lookup kernels. Every kernel implementing the
+// Lookup, GatherSum, and GatherAvg operations is run on a large embedding
+// table with feature ids drawn from a Zipf distribution, which resembles the
+// word frequencies in natural language text, or from a uniform distribution,
+// where almost every lookup is a cache miss. Feature lists are padded to
+// simulate multi-valued features like prefix and suffix lists. The time for
+// each prefetching kernel is also shown relative to the same kernel without
+// prefetching.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/myelin/compute.h"
+#include "sling/myelin/flow.h"
+#include "sling/myelin/kernel/dragnn.h"
+#include "sling/myelin/kernel/tensorflow.h"
+#include "sling/string/printf.h"
+
+DEFINE_int32(rows, 1000000, "Number of rows in embedding table");
+DEFINE_int32(dims, 64, "Embedding dimension");
+DEFINE_int32(features, 16, "Number of feature ids per lookup");
+DEFINE_string(dist, "zipf", "Feature id distribution (zipf or uniform)");
+DEFINE_double(zipf_exponent, 1.0, "Exponent for Zipf distribution");
+DEFINE_bool(shuffle, true, "Randomly permute ids so frequent ids are spread "
+            "over the embedding table");
+DEFINE_bool(padded, true, "Pad feature lists to a random length");
+DEFINE_int32(samples, 8192, "Number of distinct feature lists");
+DEFINE_string(kernels, "", "Comma-separated list of kernels to benchmark");
+DEFINE_double(min_time, 200, "Minimum measurement time (ms) per kernel");
+
+using namespace sling;
+using namespace sling::myelin;
+
+// Generator for feature ids.
+class FeatureGenerator {
+ public:
+  FeatureGenerator(int rows) : rows_(rows), rng_(1234) {
+    // Compute cumulative distribution for Zipf distribution.
+    if (FLAGS_dist == "zipf") {
+      cdf_.resize(rows);
+      double sum = 0.0;
+      for (int i = 0; i < rows; ++i) {
+        sum += 1.0 / pow(i + 1, FLAGS_zipf_exponent);
+        cdf_[i] = sum;
+      }
+      for (int i = 0; i < rows; ++i) cdf_[i] /= sum;
+    } else {
+      CHECK_EQ(FLAGS_dist, "uniform") << "Unknown distribution";
+    }
+
+    // Map frequency ranks to ids.
+    ids_.resize(rows);
+    for (int i = 0; i < rows; ++i) ids_[i] = i;
+    if (FLAGS_shuffle) std::shuffle(ids_.begin(), ids_.end(), rng_);
+  }
+
+  // Return next random feature id.
+  int Next() {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    int rank;
+    if (cdf_.empty()) {
+      rank = std::min(static_cast<int>(uniform(rng_) * rows_), rows_ - 1);
+    } else {
+      auto it = std::lower_bound(cdf_.begin(), cdf_.end(), uniform(rng_));
+      rank = std::min(static_cast<int>(it - cdf_.begin()), rows_ - 1);
+    }
+    return ids_[rank];
+  }
+
+  // Return random length for padded feature lists.
+  int Length(int max) {
+    std::uniform_int_distribution<int> length(1, max);
+    return length(rng_);
+  }
+
+ private:
+  int rows_;                   // number of rows in embedding
+  std::mt19937 rng_;           // random number generator
+  std::vector<double> cdf_;    // cumulative distribution for ranks
+  std::vector<int> ids_;       // feature id for each rank
+};
+
+// Benchmark result for kernel.
+struct Result {
+  string op;                   // operation
+  string kernel;               // kernel name
+  double ns;                   // time per lookup
+  double rows;                 // average number of rows per lookup
+};
+
+// Check if kernel has been selected for benchmarking.
+static bool Selected(const string &kernel) {
+  if (FLAGS_kernels.empty()) return true;
+  string list = "," + FLAGS_kernels + ",";
+  return list.find("," + kernel + ",") != string::npos;
+}
+
+// Run benchmark for kernel. Returns false if the kernel does not support the
+// lookup.
+static bool Run(const string &op, const string &kernel,
+                const Library &library,
+                const std::vector<float> &embeddings,
+                const std::vector<int> &features,
+                Result *result) {
+  // Build flow with lookup operation. The Dragnn lookup takes the features as
+  // the first argument and uses the last row of the embedding table for OOV.
+  Flow flow;
+  Flow::Function *func = flow.AddFunction("benchmark");
+  int rows = embeddings.size() / FLAGS_dims;
+  Flow::Variable *M =
+      flow.AddVariable("embeddings", DT_FLOAT, {rows, FLAGS_dims});
+  M->size = embeddings.size() * sizeof(float);
+  char *weights = flow.AllocateMemory(M->size);
+  memcpy(weights, embeddings.data(), M->size);
+  M->data = weights;
+  Flow::Variable *f =
+      flow.AddVariable("features", DT_INT32, {1, FLAGS_features});
+  Flow::Variable *v = flow.AddVariable("output", DT_FLOAT, {1, FLAGS_dims});
+  Flow::Operation *lookup;
+  if (op == "Lookup") {
+    lookup = flow.AddOperation(func, "lookup", op, {f, M}, {v});
+  } else {
+    lookup = flow.AddOperation(func, "lookup", op, {M, f}, {v});
+  }
+
+  // Allow prefetching, so the prefetching kernels can be benchmarked too.
+  lookup->SetAttr("prefetch", true);
+
+  // Compile flow using only the kernel being benchmarked.
+  Library singleton;
+  if (!library.Singleton(op, kernel, &singleton)) return false;
+  flow.Analyze(singleton);
+  Network network;
+  int loglevel = LogMessage::log_level();
+  LogMessage::set_log_level(FATAL);
+  bool compiled = network.Compile(flow, singleton);
+  LogMessage::set_log_level(loglevel);
+  if (!compiled) return false;
+  Cell *cell = network.GetCell("benchmark");
+  Tensor *input = network.GetParameter("features");
+
+  // Run lookups until the minimum measurement time has been reached. The
+  // Dragnn lookup skips ids below -1, while the gather kernels skip all
+  // negative ids.
+  std::vector<int> samples(features);
+  if (op == "Lookup") {
+    for (int &id : samples) if (id == -1) id = -2;
+  }
+  int num_samples = samples.size() / FLAGS_features;
+  Instance data(cell);
+  int32 *fv = reinterpret_cast<int32 *>(data.GetAddress(input));
+  int64 n = 0;
+  Clock clock;
+  clock.start();
+  do {
+    for (int i = 0; i < num_samples; ++i) {
+      memcpy(fv, samples.data() + i * FLAGS_features,
+             FLAGS_features * sizeof(int32));
+      data.Compute();
+    }
+    n += num_samples;
+    clock.stop();
+  } while (clock.ms() < FLAGS_min_time);
+
+  int valid = 0;
+  for (int id : samples) if (id >= 0) valid++;
+  result->op = op;
+  result->kernel = kernel;
+  result->ns = clock.ns() / n;
+  result->rows = static_cast<double>(valid) / num_samples;
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+
+  // Set up kernel library.
+  Library library;
+  RegisterTensorflowLibrary(&library);
+  RegisterDragnnLibrary(&library);
+
+  // Initialize embedding table with random values.
+  LOG(INFO) << "Initializing " << FLAGS_rows << "x" << FLAGS_dims
+            << " embedding table";
+  std::vector<float> embeddings(static_cast<int64>(FLAGS_rows) * FLAGS_dims);
+  std::mt19937 rng(5678);
+  std::uniform_real_distribution<float> weight(-1.0, 1.0);
+  for (float &w : embeddings) w = weight(rng);
+
+  // Generate feature lists. The last row is reserved for OOV in the Dragnn
+  // lookup and is never used as a feature id.
+  FeatureGenerator generator(FLAGS_rows - 1);
+  std::vector<int> features;
+  for (int i = 0; i < FLAGS_samples; ++i) {
+    int length = FLAGS_padded ? generator.Length(FLAGS_features)
+                              : FLAGS_features;
+    for (int j = 0; j < FLAGS_features; ++j) {
+      features.push_back(j < length ? generator.Next() : -1);
+    }
+  }
+
+  // Benchmark all kernels for the lookup operations.
+  std::vector<Result> results;
+  for (const char *op : {"Lookup", "GatherSum", "GatherAvg"}) {
+    for (Kernel *kernel : library.Lookup(op)) {
+      if (!Selected(kernel->Name())) continue;
+      Result result;
+      if (Run(op, kernel->Name(), library, embeddings, features, &result)) {
+        results.push_back(result);
+      }
+    }
+  }
+
+  // Output results.
+  double row_bytes = FLAGS_dims * sizeof(float);
+  std::cout << StringPrintf("%s ids, %d rows, %d dims, %d features%s\n",
+                            FLAGS_dist.c_str(), FLAGS_rows, FLAGS_dims,
+                            FLAGS_features, FLAGS_padded ? " (padded)" : "");
+  std::cout << StringPrintf("%-10s %-30s %12s %12s %10s %10s\n", "op",
+                            "kernel", "ns/lookup", "ns/row", "GB/s",
+                            "relative");
+  for (const Result &r : results) {
+    const Result *base = &r;
+    const string suffix = "Prefetch";
+    if (r.kernel.size() > suffix.size() &&
+        r.kernel.compare(r.kernel.size() - suffix.size(), suffix.size(),
+                         suffix) == 0) {
+      string plain = r.kernel.substr(0, r.kernel.size() - suffix.size());
+      for (const Result &other : results) {
+        if (other.op == r.op && other.kernel == plain) base = &other;
+      }
+    }
+    double row_ns = r.ns / r.rows;
+    std::cout << StringPrintf("%-10s %-30s %12.1f %12.2f %10.2f %10.3f\n",
+                              r.op.c_str(), r.kernel.c_str(), r.ns, row_ns,
+                              row_bytes / row_ns, r.ns / base->ns);
+  }
+
+  return 0;
+}
+
@@ -277,6 +277,16 @@ void MacroAssembler::LoopStart(jit::Label *label) {
   bind(label);
 }
 
+void MacroAssembler::Prefetch(jit::Register addr, int size) {
+  const int kCacheLineSize = 64;
+  const int kMaxPrefetchLines = 16;
+  int lines = (size + kCacheLineSize - 1) / kCacheLineSize;
+  if (lines > kMaxPrefetchLines) lines = kMaxPrefetchLines;
+  for (int i = 0; i < lines; ++i) {
+    prefetcht0(Operand(addr, i * kCacheLineSize));
+  }
+}
+
 void MacroAssembler::LoadTensorAddress(Register dst, Tensor *tensor) {
   if (tensor->IsConstant()) {
     load_extern(dst, tensor->data(), tensor->name());
@@ -273,6 +273,10 @@ class MacroAssembler : public jit::Assembler {
   // Start of loop. Align code and bind label.
   void LoopStart(jit::Label *label);
 
+  // Prefetch memory block into cache. Only the first cache lines of large
+  // blocks are prefetched explicitly.
+  void Prefetch(jit::Register addr, int size);
+
   // Call function with instance as argument.
   void CallInstanceFunction(void (*func)(void *), const string &symbol);
 
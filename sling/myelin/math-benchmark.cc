@@ -0,0 +1,157 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Accuracy and throughput benchmark for the approximations of intrinsic
+// functions at each precision tier. For each function and tier a flow with a
+// single element-wise op is compiled and evaluated over a sweep of inputs. The
+// result is compared to the double-precision libm result and the max ulp error
+// and throughput are reported.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/myelin/builder.h"
+#include "sling/myelin/compute.h"
+#include "sling/myelin/express.h"
+#include "sling/myelin/flow.h"
+#include "sling/myelin/kernel/tensorflow.h"
+#include "sling/string/printf.h"
+
+DEFINE_int32(size, 4096, "Number of elements per evaluation");
+DEFINE_int32(repeat, 10000, "Number of evaluations for timing");
+DEFINE_string(func, "", "Only benchmark this function");
+
+using namespace sling;
+using namespace sling::myelin;
+
+// Function to benchmark with input range and reference implementation.
+struct Function {
+  const char *op;     // flow operation
+  double lo;          // low end of input range
+  double hi;          // high end of input range
+  bool log_scale;     // sweep inputs on a logarithmic scale
+  double (*ref)(double x);
+};
+
+static double Sigmoid(double x) { return 1.0 / (1.0 + exp(-x)); }
+
+static const Function functions[] = {
+  {"Exp", -87.0, 88.0, false, exp},
+  {"Log", 1e-30, 1e30, true, log},
+  {"Tanh", -10.0, 10.0, false, tanh},
+  {"Sigmoid", -20.0, 20.0, false, Sigmoid},
+};
+
+// Return distance in ulps between two floats.
+static int64 UlpDistance(float a, float b) {
+  if (a == b) return 0;
+  if (isnan(a) || isnan(b)) return INT32_MAX;
+  int32 ia, ib;
+  memcpy(&ia, &a, sizeof(float));
+  memcpy(&ib, &b, sizeof(float));
+  if (ia < 0) ia = INT32_MIN - ia;
+  if (ib < 0) ib = INT32_MIN - ib;
+  return ia > ib ? static_cast<int64>(ia) - ib : static_cast<int64>(ib) - ia;
+}
+
+static void Benchmark(const Function &func, Express::Precision precision) {
+  // Build flow with single element-wise operation.
+  int n = FLAGS_size;
+  Flow flow;
+  Builder tf(&flow, "f");
+  Flow::Variable *x = tf.Var("x", DT_FLOAT, {n});
+  Flow::Variable *y = tf.Op(func.op, {x});
+  y->type = DT_FLOAT;
+  y->shape = x->shape;
+
+  // Compile flow.
+  Library library;
+  RegisterTensorflowLibrary(&library);
+  flow.Analyze(library);
+  Network network;
+  network.set_math_precision(precision);
+  CHECK(network.Compile(flow, library));
+  Cell *cell = network.GetCell("f");
+  Tensor *input = network.GetParameter(x->name);
+  Tensor *output = network.GetParameter(y->name);
+  Instance data(cell);
+
+  // Sweep input range. The output can share storage with the input, so keep
+  // a copy of the inputs.
+  std::vector<float> in(n);
+  for (int i = 0; i < n; ++i) {
+    double t = static_cast<double>(i) / (n - 1);
+    if (func.log_scale) {
+      in[i] = exp(log(func.lo) + t * (log(func.hi) - log(func.lo)));
+    } else {
+      in[i] = func.lo + t * (func.hi - func.lo);
+    }
+  }
+  memcpy(data.Get<float>(input), in.data(), n * sizeof(float));
+
+  // Compute accuracy.
+  data.Compute();
+  float *out = data.Get<float>(output);
+  int64 max_ulp = 0;
+  double max_abs = 0.0;
+  float worst = 0.0;
+  for (int i = 0; i < n; ++i) {
+    double expected = func.ref(in[i]);
+    int64 ulp = UlpDistance(out[i], static_cast<float>(expected));
+    double abs = fabs(out[i] - expected);
+    if (ulp > max_ulp) {
+      max_ulp = ulp;
+      worst = in[i];
+    }
+    if (abs > max_abs) max_abs = abs;
+  }
+
+  // Measure throughput.
+  Clock clock;
+  clock.start();
+  for (int r = 0; r < FLAGS_repeat; ++r) data.Compute();
+  clock.stop();
+  double ns = clock.ns() / (static_cast<double>(FLAGS_repeat) * n);
+
+  std::cout << StringPrintf("%-8s %-8s %10lld %12.3g %12.6g %10.3f %10.1f\n",
+                            func.op, Express::PrecisionName(precision),
+                            max_ulp, max_abs, worst, ns,
+                            1e3 / ns);
+}
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+
+  std::cout << StringPrintf("%-8s %-8s %10s %12s %12s %10s %10s\n",
+                            "func", "tier", "max ulp", "max abs",
+                            "worst x", "ns/elem", "Melem/s");
+  for (const Function &func : functions) {
+    if (!FLAGS_func.empty() && FLAGS_func != func.op) continue;
+    for (int p = Express::PRECISE; p <= Express::FASTEST; ++p) {
+      Benchmark(func, static_cast<Express::Precision>(p));
+    }
+  }
+
+  return 0;
+}
+
@@ -0,0 +1,291 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/myelin/memory-pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "sling/base/logging.h"
+
+namespace sling {
+namespace myelin {
+
+namespace {
+
+// Header stored in front of each block.
+struct BlockHeader {
+  size_t capacity;     // usable size of block
+  uint32 alignment;    // alignment of block
+  uint32 offset;       // offset of block from start of memory allocation
+};
+
+// Minimum block alignment. This leaves room for the block header.
+static const int kMinAlignment = 16;
+
+// Maximum number of free blocks of each size kept in the thread caches and in
+// the global pool.
+static const int kMaxThreadBlocks = 16;
+static const int kMaxGlobalBlocks = 256;
+
+// Free lists keyed by block capacity and alignment.
+typedef std::unordered_map<uint64, std::vector<char *>> FreeLists;
+
+// Global pool of free blocks shared between all threads.
+struct GlobalPool {
+  std::mutex mu;
+  FreeLists free;
+};
+
+// Cache of free blocks for a thread.
+struct ThreadCache {
+  FreeLists free;
+};
+
+// Allocation counters.
+std::atomic<int64> num_allocations(0);
+std::atomic<int64> num_reused(0);
+std::atomic<int64> num_grown(0);
+std::atomic<int64> num_released(0);
+
+// Reuse of freed blocks is enabled by default.
+std::atomic<bool> pooling_enabled(true);
+
+// Free block cache for current thread. This is a plain pointer so it can
+// still be checked after the thread-local destructors have run.
+thread_local ThreadCache *thread_cache = nullptr;
+thread_local bool thread_cache_released = false;
+
+// The global pool is never deleted so blocks can be freed safely during
+// static destruction.
+GlobalPool *global_pool() {
+  static GlobalPool *pool = new GlobalPool();
+  return pool;
+}
+
+bool IsPowerOfTwo(size_t value) {
+  return value && !(value & (value - 1));
+}
+
+size_t Align(size_t n, size_t align) {
+  return (n + align - 1) & ~(align - 1);
+}
+
+size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t power = 1;
+  while (power < n) power <<= 1;
+  return power;
+}
+
+BlockHeader *Header(const char *data) {
+  return reinterpret_cast<BlockHeader *>(
+      const_cast<char *>(data) - sizeof(BlockHeader));
+}
+
+uint64 BlockKey(size_t capacity, int alignment) {
+  return (static_cast<uint64>(capacity) << 8) | __builtin_ctz(alignment);
+}
+
+// Return block to the system allocator.
+void Release(char *data) {
+  free(data - Header(data)->offset);
+  num_released++;
+}
+
+// Move all blocks in free lists to the global pool. Blocks that do not fit in
+// the global pool are released.
+void ReturnToGlobalPool(FreeLists *lists) {
+  GlobalPool *pool = global_pool();
+  std::lock_guard<std::mutex> lock(pool->mu);
+  for (auto &it : *lists) {
+    std::vector<char *> &global = pool->free[it.first];
+    for (char *data : it.second) {
+      if (global.size() < kMaxGlobalBlocks) {
+        global.push_back(data);
+      } else {
+        Release(data);
+      }
+    }
+  }
+  lists->clear();
+}
+
+// Hands the blocks in the thread cache over to the global pool when the
+// thread terminates.
+struct ThreadCacheOwner {
+  ~ThreadCacheOwner() {
+    if (thread_cache != nullptr) {
+      ReturnToGlobalPool(&thread_cache->free);
+      delete thread_cache;
+      thread_cache = nullptr;
+    }
+    thread_cache_released = true;
+  }
+};
+
+// Return free block cache for current thread. Returns null after the cache
+// has been released at thread termination.
+ThreadCache *GetThreadCache() {
+  if (thread_cache == nullptr && !thread_cache_released) {
+    static thread_local ThreadCacheOwner owner;
+    thread_cache = new ThreadCache();
+  }
+  return thread_cache;
+}
+
+// Pop block from free list. Returns null if the free list is empty.
+char *PopBlock(FreeLists *lists, uint64 key) {
+  auto f = lists->find(key);
+  if (f == lists->end() || f->second.empty()) return nullptr;
+  char *data = f->second.back();
+  f->second.pop_back();
+  return data;
+}
+
+}  // namespace
+
+char *MemoryPool::Allocate(size_t size, int alignment, bool round) {
+  DCHECK(IsPowerOfTwo(alignment)) << alignment;
+  if (alignment < kMinAlignment) alignment = kMinAlignment;
+  size_t capacity = round ? RoundUpToPowerOfTwo(size) : size;
+  capacity = Align(capacity > 0 ? capacity : 1, alignment);
+  uint64 key = BlockKey(capacity, alignment);
+
+  if (pooling_enabled) {
+    // Try to get free block from the thread cache.
+    ThreadCache *cache = GetThreadCache();
+    if (cache != nullptr) {
+      char *data = PopBlock(&cache->free, key);
+      if (data != nullptr) {
+        num_reused++;
+        return data;
+      }
+    }
+
+    // Try to get free block from the global pool.
+    GlobalPool *pool = global_pool();
+    std::lock_guard<std::mutex> lock(pool->mu);
+    char *data = PopBlock(&pool->free, key);
+    if (data != nullptr) {
+      num_reused++;
+      return data;
+    }
+  }
+
+  // Allocate new block with room for the header in front of the block.
+  size_t offset = Align(sizeof(BlockHeader), alignment);
+  void *memory;
+  int rc = posix_memalign(&memory, alignment, offset + capacity);
+  CHECK_EQ(rc, 0) << "Cannot allocate memory, size: " << capacity
+                  << " alignment: " << alignment;
+  char *data = reinterpret_cast<char *>(memory) + offset;
+  BlockHeader *header = Header(data);
+  header->capacity = capacity;
+  header->alignment = alignment;
+  header->offset = offset;
+  num_allocations++;
+  return data;
+}
+
+char *MemoryPool::Reallocate(char *data, size_t old_size, size_t new_size,
+                             int alignment) {
+  // Keep block if it is large enough.
+  if (data != nullptr) {
+    BlockHeader *header = Header(data);
+    if (header->capacity >= new_size && header->alignment >= alignment) {
+      num_grown++;
+      return data;
+    }
+  }
+
+  // Move data to new block.
+  char *buffer = Allocate(new_size, alignment, true);
+  if (data != nullptr) {
+    memcpy(buffer, data, old_size);
+    Free(data);
+  }
+  return buffer;
+}
+
+void MemoryPool::Free(char *data) {
+  if (data == nullptr) return;
+  if (!pooling_enabled) {
+    Release(data);
+    return;
+  }
+
+  // Return block to thread cache if there is room for it.
+  BlockHeader *header = Header(data);
+  uint64 key = BlockKey(header->capacity, header->alignment);
+  ThreadCache *cache = GetThreadCache();
+  if (cache != nullptr) {
+    std::vector<char *> &blocks = cache->free[key];
+    if (blocks.size() < kMaxThreadBlocks) {
+      blocks.push_back(data);
+      return;
+    }
+  }
+
+  // Return block to the global pool or release it if the pool is full.
+  GlobalPool *pool = global_pool();
+  std::lock_guard<std::mutex> lock(pool->mu);
+  std::vector<char *> &blocks = pool->free[key];
+  if (blocks.size() < kMaxGlobalBlocks) {
+    blocks.push_back(data);
+  } else {
+    Release(data);
+  }
+}
+
+size_t MemoryPool::Capacity(const char *data) {
+  return Header(data)->capacity;
+}
+
+void MemoryPool::Trim() {
+  // Move blocks in thread cache to global pool.
+  if (thread_cache != nullptr) ReturnToGlobalPool(&thread_cache->free);
+
+  // Release all blocks in global pool.
+  GlobalPool *pool = global_pool();
+  std::lock_guard<std::mutex> lock(pool->mu);
+  for (auto &it : pool->free) {
+    for (char *data : it.second) Release(data);
+  }
+  pool->free.clear();
+}
+
+MemoryPool::Stats MemoryPool::GetStats() {
+  Stats stats;
+  stats.allocations = num_allocations;
+  stats.reused = num_reused;
+  stats.grown = num_grown;
+  stats.released = num_released;
+  return stats;
+}
+
+void MemoryPool::set_enabled(bool enabled) {
+  pooling_enabled = enabled;
+}
+
+bool MemoryPool::enabled() {
+  return pooling_enabled;
+}
+
+}  // namespace myelin
+}  // namespace sling
+
@@ -0,0 +1,74 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_MYELIN_MEMORY_POOL_H_
+#define SLING_MYELIN_MEMORY_POOL_H_
+
+#include <stddef.h>
+
+#include "sling/base/types.h"
+
+namespace sling {
+namespace myelin {
+
+// Memory pool for instance and channel data blocks. Freed blocks are kept on
+// free lists keyed by block capacity and alignment, so instances of the same
+// cell and channels of the same size class can reuse the memory of earlier
+// instances and channels without going through the system allocator. Each
+// thread has its own cache of free blocks and falls back on a global pool
+// shared between all threads when its cache is empty or full.
+class MemoryPool {
+ public:
+  // Allocation statistics.
+  struct Stats {
+    int64 allocations;   // blocks allocated from the system allocator
+    int64 reused;        // allocations served from free lists
+    int64 grown;         // reallocations that fit in the existing block
+    int64 released;      // blocks returned to the system allocator
+  };
+
+  // Allocate block with room for at least size bytes. The capacity of the
+  // block is rounded up to the next power of two if round is true.
+  static char *Allocate(size_t size, int alignment, bool round = false);
+
+  // Reallocate block so it has room for at least new_size bytes. The first
+  // old_size bytes of the block are preserved. The block is only moved if its
+  // capacity is too small. Capacities are rounded up to powers of two.
+  static char *Reallocate(char *data, size_t old_size, size_t new_size,
+                          int alignment);
+
+  // Return block to the memory pool.
+  static void Free(char *data);
+
+  // Return capacity of block.
+  static size_t Capacity(const char *data);
+
+  // Return all free blocks in the global pool and the cache for the current
+  // thread to the system allocator.
+  static void Trim();
+
+  // Get allocation statistics.
+  static Stats GetStats();
+
+  // Enable or disable reuse of freed blocks. When disabled, freed blocks are
+  // returned directly to the system allocator.
+  static void set_enabled(bool enabled);
+  static bool enabled();
+};
+
+}  // namespace myelin
+}  // namespace sling
+
+#endif  // SLING_MYELIN_MEMORY_POOL_H_
+
@@ -14,9 +14,9 @@
 
 #include "sling/myelin/multi-process.h"
 
-#include <stdlib.h>
-
 #include "sling/base/logging.h"
+#include "sling/myelin/memory-pool.h"
+#include "sling/myelin/numa.h"
 
 namespace sling {
 namespace myelin {
@@ -24,8 +24,9 @@ namespace myelin {
 // Worker thread for multi-processor runtime.
 class Worker {
  public:
-  // Start worker.
-  Worker() : thread_(&Worker::Run, this) {}
+  // Start worker. The worker thread is bound to the NUMA node unless node
+  // is -1.
+  explicit Worker(int node) : node_(node), thread_(&Worker::Run, this) {}
 
   // Stop worker.
   ~Worker() {
@@ -67,9 +68,15 @@ class Worker {
     while (worker->state_ != READY);
   }
 
+  // NUMA node for worker or -1 if the worker is not bound to a node.
+  int node() const { return node_; }
+
  private:
   // Worker thread.
   void Run() {
+    if (node_ != -1 && !Numa::BindThread(node_)) {
+      LOG(WARNING) << "Cannot bind worker to NUMA node " << node_;
+    }
     std::unique_lock<std::mutex> lock(mu_);
     for (;;) {
       switch (state_) {
@@ -110,33 +117,41 @@ class Worker {
   // Current task for worker.
   Task *task_ = nullptr;
 
+  // NUMA node for worker.
+  int node_;
+
   // Worker thread.
   std::thread thread_;
 };
 
+MultiProcessorRuntime::MultiProcessorRuntime()
+    : workers_(Numa::NumNodes()) {}
+
 MultiProcessorRuntime::~MultiProcessorRuntime() {
   // Stop all workers.
-  for (auto *w : workers_) delete w;
+  for (auto &pool : workers_) {
+    for (auto *w : pool) delete w;
+  }
 }
 
 void MultiProcessorRuntime::AllocateInstance(Instance *instance) {
   // Allocate memory for instance.
-  void *data;
-  int rc = posix_memalign(&data, instance->alignment(), instance->size());
-  CHECK_EQ(rc, 0);
-  instance->set_data(reinterpret_cast<char *>(data));
+  instance->set_data(MemoryPool::Allocate(instance->size(),
+                                          instance->alignment()));
 
   // Allocate workers for instance.
   int n = instance->num_tasks();
   if (n > 0) {
+    int node = numa_aware_ ? Numa::CurrentNode() : -1;
+    std::vector<Worker *> &pool = workers_[node == -1 ? 0 : node];
     std::lock_guard<std::mutex> lock(mu_);
     for (int i = 0; i < n; ++i) {
       Worker *worker;
-      if (workers_.empty()) {
-        worker = new Worker();
+      if (pool.empty()) {
+        worker = new Worker(node);
       } else {
-        worker = workers_.back();
-        workers_.pop_back();
+        worker = pool.back();
+        pool.pop_back();
       }
       worker->Attach(instance->task(i));
     }
@@ -151,12 +166,12 @@ void MultiProcessorRuntime::FreeInstance(Instance *instance) {
     for (int i = n - 1; i >= 0; --i) {
       Worker *worker = reinterpret_cast<Worker *>(instance->task(i)->state);
       worker->Detach();
-      workers_.push_back(worker);
+      workers_[worker->node() == -1 ? 0 : worker->node()].push_back(worker);
     }
   }
 
-  // Deallocate instance memory.
-  free(instance->data());
+  // Return instance memory to pool.
+  MemoryPool::Free(instance->data());
 }
 
 void MultiProcessorRuntime::ClearInstance(Instance *instance) {
@@ -168,13 +183,7 @@ void MultiProcessorRuntime::ClearInstance(Instance *instance) {
 char *MultiProcessorRuntime::AllocateChannel(char *data, size_t old_size,
                                              size_t new_size, size_t alignment,
                                              Placement placement) {
-  void *buffer;
-  CHECK_EQ(posix_memalign(&buffer, alignment, new_size), 0);
-  if (data != nullptr) {
-    memcpy(buffer, data, old_size);
-    free(data);
-  }
-  return reinterpret_cast<char *>(buffer);
+  return MemoryPool::Reallocate(data, old_size, new_size, alignment);
 }
 
 void MultiProcessorRuntime::ClearChannel(char *data, size_t pos, size_t size,
@@ -183,7 +192,7 @@ void MultiProcessorRuntime::ClearChannel(char *data, size_t pos, size_t size,
 }
 
 void MultiProcessorRuntime::FreeChannel(char *data, Placement placement) {
-  free(data);
+  MemoryPool::Free(data);
 }
 
 Runtime::TaskFunc MultiProcessorRuntime::StartTaskFunc() {
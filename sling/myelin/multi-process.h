@@ -29,9 +29,16 @@ class Worker;
 // Myelin runtime for multi-processor execution.
 class MultiProcessorRuntime : public Runtime {
  public:
+  MultiProcessorRuntime();
   ~MultiProcessorRuntime();
   string Description() override { return "Multi-processor"; }
 
+  // Keep a separate worker pool for each NUMA node. Instances get workers
+  // bound to the node of the thread allocating the instance, so the tasks run
+  // on the same node as the main computation and its instance memory. This
+  // should be set before any instances are allocated.
+  void set_numa_aware(bool numa_aware) { numa_aware_ = numa_aware; }
+
   // Instance data allocation.
   void AllocateInstance(Instance *instance) override;
   void FreeInstance(Instance *instance) override;
@@ -57,8 +64,12 @@ class MultiProcessorRuntime : public Runtime {
   // Mutex for synchronizing access to worker pool.
   std::mutex mu_;
 
-  // Worker pool.
-  std::vector<Worker *> workers_;
+  // Worker pools for each NUMA node. There is only one pool unless the
+  // runtime is NUMA-aware.
+  std::vector<std::vector<Worker *>> workers_;
+
+  // Bind workers to the NUMA node of the thread allocating the instance.
+  bool numa_aware_ = false;
 };
 
 }  // namespace myelin
@@ -0,0 +1,82 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/myelin/numa-network.h"
+
+#include <thread>
+
+#include "sling/base/logging.h"
+
+namespace sling {
+namespace myelin {
+
+NumaNetwork::~NumaNetwork() {
+  for (auto *n : replicas_) delete n;
+}
+
+bool NumaNetwork::Compile(const Flow &flow, const Library &library) {
+  CHECK(replicas_.empty()) << "Network already compiled";
+  int nodes = Numa::NumNodes();
+  for (int node = 0; node < nodes; ++node) {
+    // Set up network replica for node.
+    Network *network = new Network();
+    replicas_.push_back(network);
+    if (runtime_ != nullptr) network->set_runtime(runtime_);
+    if (linker_ != nullptr) network->set_linker(linker_);
+    network->options() = options_;
+    if (nodes > 1 && !options_.numa_interleave) {
+      network->set_numa_node(node);
+    }
+
+    // Compile the replica in a thread bound to the node, so the generated
+    // code and the small constants are allocated in memory local to the node.
+    // The replicas are compiled one at a time.
+    bool success = false;
+    std::thread compiler([&]() {
+      if (nodes > 1 && !Numa::BindThread(node)) {
+        LOG(WARNING) << "Cannot bind compiler thread to NUMA node " << node;
+      }
+      success = network->Compile(flow, library);
+    });
+    compiler.join();
+    if (!success) return false;
+    VLOG(3) << "Compiled network replica for NUMA node " << node;
+  }
+  return true;
+}
+
+bool NumaNetwork::Compile(const string &flowfile, const Library &library) {
+  // Load flow file.
+  Flow flow;
+  if (!flow.Load(flowfile).ok()) {
+    LOG(ERROR) << "Error loading flow file " << flowfile;
+    return false;
+  }
+
+  // Analyze flow graph.
+  flow.Analyze(library);
+
+  // Generate code for flow.
+  return Compile(flow, library);
+}
+
+bool NumaNetwork::ReloadWeights(const Flow &flow) {
+  for (auto *network : replicas_) {
+    if (!network->ReloadWeights(flow)) return false;
+  }
+  return true;
+}
+
+}  // namespace myelin
+}  // namespace sling
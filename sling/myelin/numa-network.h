@@ -0,0 +1,85 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_MYELIN_NUMA_NETWORK_H_
+#define SLING_MYELIN_NUMA_NETWORK_H_
+
+#include <string>
+#include <vector>
+
+#include "sling/base/types.h"
+#include "sling/myelin/compute.h"
+#include "sling/myelin/flow.h"
+#include "sling/myelin/numa.h"
+
+namespace sling {
+namespace myelin {
+
+// Network replicated on all NUMA nodes. Each replica is compiled from a thread
+// bound to its node and has its large constants placed on the node, so
+// computations using the replica for the node of the calling thread do not
+// read weights from remote memory. On systems with a single node, there is
+// only one replica with the default memory placement.
+class NumaNetwork {
+ public:
+  ~NumaNetwork();
+
+  // Compile network replicas for all NUMA nodes.
+  bool Compile(const Flow &flow, const Library &library);
+
+  // Load flow from file and compile network replicas for all NUMA nodes.
+  bool Compile(const string &flowfile, const Library &library);
+
+  // Reload the weights for all replicas. See Network::ReloadWeights().
+  bool ReloadWeights(const Flow &flow);
+
+  // Number of replicas.
+  int num_nodes() const { return replicas_.size(); }
+
+  // Network replica for node.
+  Network *network(int node) const { return replicas_[node]; }
+
+  // Network replica for the node of the CPU the calling thread is running on.
+  // Threads using the returned network should be bound to the node.
+  Network *local() const { return replicas_[Numa::CurrentNode()]; }
+
+  // Get compiled cell in the local replica.
+  Cell *GetCell(const string &name) const { return local()->GetCell(name); }
+
+  // Compiler options used for all replicas. The NUMA node for constants is
+  // set for each replica unless constants are interleaved.
+  Options &options() { return options_; }
+
+  // Runtime used for all replicas.
+  void set_runtime(Runtime *runtime) { runtime_ = runtime; }
+
+  // Linker used for all replicas.
+  void set_linker(Linker *linker) { linker_ = linker; }
+
+ private:
+  // Network replicas for each node.
+  std::vector<Network *> replicas_;
+
+  // Compiler options for replicas.
+  Options options_;
+
+  // Runtime and linker for replicas. The defaults are used if these are null.
+  Runtime *runtime_ = nullptr;
+  Linker *linker_ = nullptr;
+};
+
+}  // namespace myelin
+}  // namespace sling
+
+#endif  // SLING_MYELIN_NUMA_NETWORK_H_
@@ -0,0 +1,197 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/myelin/numa.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string>
+
+#include "sling/base/logging.h"
+
+namespace sling {
+namespace myelin {
+
+namespace {
+
+// Memory policies and flags for mbind system call.
+static const int kPreferredPolicy = 1;   // MPOL_PREFERRED
+static const int kInterleavePolicy = 3;  // MPOL_INTERLEAVE
+static const int kMoveFlag = 1 << 1;     // MPOL_MF_MOVE
+
+// Number of bits in node mask word.
+static const int kMaskBits = 8 * sizeof(unsigned long);
+
+// NUMA topology read from sysfs.
+struct Topology {
+  Topology();
+
+  std::vector<std::vector<int>> cpus;  // CPUs for each node
+  std::vector<int> nodes;              // node for each CPU
+};
+
+// Read first line of file. Returns false if the file cannot be read.
+bool ReadLine(const string &filename, string *line) {
+  FILE *f = fopen(filename.c_str(), "r");
+  if (f == nullptr) return false;
+  char buffer[4096];
+  bool ok = fgets(buffer, sizeof(buffer), f) != nullptr;
+  fclose(f);
+  if (!ok) return false;
+  line->assign(buffer);
+  while (!line->empty() && isspace(line->back())) line->pop_back();
+  return true;
+}
+
+// Parse list of ranges, e.g. "0-3,8-11", into list of numbers.
+std::vector<int> ParseList(const string &list) {
+  std::vector<int> result;
+  const char *p = list.c_str();
+  while (*p != 0) {
+    char *end;
+    int first = strtol(p, &end, 10);
+    if (end == p) break;
+    int last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for (int i = first; i <= last; ++i) result.push_back(i);
+    if (*p == ',') p++;
+  }
+  return result;
+}
+
+Topology::Topology() {
+  // Get online nodes and their CPUs.
+  string line;
+  if (ReadLine("/sys/devices/system/node/online", &line)) {
+    for (int node : ParseList(line)) {
+      string cpulist;
+      string fn = "/sys/devices/system/node/node" + std::to_string(node) +
+                  "/cpulist";
+      if (!ReadLine(fn, &cpulist)) continue;
+      if (node >= cpus.size()) cpus.resize(node + 1);
+      cpus[node] = ParseList(cpulist);
+    }
+  }
+
+  // Fall back to a single node with all CPUs if NUMA is not supported.
+  if (cpus.empty()) {
+    cpus.resize(1);
+    int n = sysconf(_SC_NPROCESSORS_CONF);
+    for (int i = 0; i < n; ++i) cpus[0].push_back(i);
+  }
+
+  // Map CPUs to nodes.
+  for (int node = 0; node < cpus.size(); ++node) {
+    for (int cpu : cpus[node]) {
+      if (cpu >= nodes.size()) nodes.resize(cpu + 1, 0);
+      nodes[cpu] = node;
+    }
+  }
+
+  VLOG(3) << "NUMA nodes: " << cpus.size();
+}
+
+const Topology &topology() {
+  static Topology *topology = new Topology();
+  return *topology;
+}
+
+// Set memory policy for the whole pages in memory range.
+bool SetPolicy(void *data, size_t size, int policy,
+               const std::vector<unsigned long> &mask) {
+  size_t page = Numa::PageSize();
+  uintptr_t start = reinterpret_cast<uintptr_t>(data);
+  uintptr_t end = start + size;
+  start = (start + page - 1) & ~(page - 1);
+  end = end & ~(page - 1);
+  if (end <= start) return true;
+  long rc = syscall(SYS_mbind, start, end - start, policy, mask.data(),
+                    mask.size() * kMaskBits + 1, kMoveFlag);
+  if (rc != 0) {
+    VLOG(3) << "mbind failed: " << errno;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int Numa::NumNodes() {
+  return topology().cpus.size();
+}
+
+int Numa::CurrentNode() {
+  if (NumNodes() == 1) return 0;
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+  if (node >= NumNodes()) return 0;
+  return node;
+}
+
+const std::vector<int> &Numa::NodeCPUs(int node) {
+  DCHECK_GE(node, 0);
+  DCHECK_LT(node, NumNodes());
+  return topology().cpus[node];
+}
+
+int Numa::CPUNode(int cpu) {
+  const std::vector<int> &nodes = topology().nodes;
+  if (cpu < 0 || cpu >= nodes.size()) return 0;
+  return nodes[cpu];
+}
+
+bool Numa::BindThread(int node) {
+  if (NumNodes() == 1) return true;
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int cpu : NodeCPUs(node)) CPU_SET(cpu, &cpus);
+  return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+bool Numa::BindMemory(void *data, size_t size, int node) {
+  if (NumNodes() == 1) return true;
+  DCHECK_GE(node, 0);
+  DCHECK_LT(node, NumNodes());
+  std::vector<unsigned long> mask(node / kMaskBits + 1);
+  mask[node / kMaskBits] |= 1UL << (node % kMaskBits);
+  return SetPolicy(data, size, kPreferredPolicy, mask);
+}
+
+bool Numa::InterleaveMemory(void *data, size_t size) {
+  int n = NumNodes();
+  if (n == 1) return true;
+  std::vector<unsigned long> mask((n - 1) / kMaskBits + 1);
+  for (int node = 0; node < n; ++node) {
+    if (topology().cpus[node].empty()) continue;
+    mask[node / kMaskBits] |= 1UL << (node % kMaskBits);
+  }
+  return SetPolicy(data, size, kInterleavePolicy, mask);
+}
+
+size_t Numa::PageSize() {
+  static size_t page_size = sysconf(_SC_PAGESIZE);
+  return page_size;
+}
+
+}  // namespace myelin
+}  // namespace sling
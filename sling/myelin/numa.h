@@ -0,0 +1,63 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_MYELIN_NUMA_H_
+#define SLING_MYELIN_NUMA_H_
+
+#include <stddef.h>
+#include <vector>
+
+#include "sling/base/types.h"
+
+namespace sling {
+namespace myelin {
+
+// Support for non-uniform memory access (NUMA) systems. The topology is read
+// from sysfs and memory policies and thread affinities are set using system
+// calls, so no NUMA library is needed. On systems without NUMA support, there
+// is a single node and all placement requests are ignored.
+class Numa {
+ public:
+  // Return the number of NUMA nodes. This is one if NUMA is not supported.
+  static int NumNodes();
+
+  // Return the node for the CPU that the calling thread is running on.
+  static int CurrentNode();
+
+  // Return the CPUs for node.
+  static const std::vector<int> &NodeCPUs(int node);
+
+  // Return the node for CPU.
+  static int CPUNode(int cpu);
+
+  // Restrict calling thread to run on the CPUs of node. Returns false if the
+  // affinity could not be set.
+  static bool BindThread(int node);
+
+  // Place memory pages on node. The memory must not have been touched yet for
+  // the policy to take effect without migration. Only whole pages inside the
+  // memory range are placed. Returns false if the policy could not be set.
+  static bool BindMemory(void *data, size_t size, int node);
+
+  // Interleave memory pages over all nodes.
+  static bool InterleaveMemory(void *data, size_t size);
+
+  // Return system page size.
+  static size_t PageSize();
+};
+
+}  // namespace myelin
+}  // namespace sling
+
+#endif  // SLING_MYELIN_NUMA_H_
@@ -168,6 +168,16 @@ string Profile::ASCIIReport() const {
     if (step(i)->type() == "Calculate") {
       StringAppendF(&report, " [%s]", step(i)->GetAttr("expr").c_str());
     }
+    double iterations = loop_iterations(i);
+    if (iterations > 0 && invocations_ > 0) {
+      // Achieved throughput for the generated loop.
+      double cycles = timing(i) / static_cast<double>(invocations_);
+      double per_iteration = cycles / iterations;
+      int instructions = step(i)->GetAttr("loop_instructions", 0);
+      StringAppendF(&report,
+                    " [%.1f cycles/iteration, %.2f instructions/cycle]",
+                    per_iteration, instructions / per_iteration);
+    }
     report.push_back('\n');
   }
 
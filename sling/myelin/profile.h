@@ -95,6 +95,15 @@ class Profile {
     return ops == 0 || t == 0 ? 0 : ops / t / 1e3;
   }
 
+  // Number of loop iterations per invocation of step for steps with generated
+  // expression loops. Returns zero if the loop size is not known.
+  int64 loop_iterations(int idx) const {
+    int elements = step(idx)->GetAttr("loop_elements", 0);
+    if (elements <= 0 || step(idx)->outdegree() == 0) return 0;
+    int64 total = step(idx)->output(0)->elements();
+    return total <= elements ? 1 : (total + elements - 1) / elements;
+  }
+
   // Estimated number of operations per second for computation.
   double gigaflops() const {
     return complexity() == 0 || time() == 0 ? 0 : complexity() / time() / 1e3;
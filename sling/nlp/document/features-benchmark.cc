@@ -0,0 +1,192 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark for lexical feature extraction. The text in --input, or synthetic
+// text if no input file is given, is tokenized into a document, and a lexicon
+// and affix tables are built from the most frequent words. The lexical
+// features for the document are then extracted repeatedly until the minimum
+// measurement time has been reached.
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/file/file.h"
+#include "sling/frame/store.h"
+#include "sling/nlp/document/affix.h"
+#include "sling/nlp/document/document.h"
+#include "sling/nlp/document/document-tokenizer.h"
+#include "sling/nlp/document/features.h"
+#include "sling/nlp/document/lexicon.h"
+#include "sling/stream/memory.h"
+#include "sling/string/printf.h"
+
+DEFINE_string(input, "", "Text file for benchmark");
+DEFINE_int32(tokens, 100000, "Number of tokens in synthetic text");
+DEFINE_int32(words, 10000, "Number of words in lexicon");
+DEFINE_int32(affix_length, 3, "Maximum length of prefixes and suffixes");
+DEFINE_bool(normalize_digits, true, "Normalize digits in lexicon");
+DEFINE_int32(cache, 0, "Number of words in feature cache (0 = no cache)");
+DEFINE_double(min_time, 1000, "Minimum measurement time (ms)");
+
+using namespace sling;
+using namespace sling::nlp;
+
+// Generate synthetic text with words, numbers, and punctuation.
+static string SyntheticText(int tokens) {
+  static const char *words[] = {
+    "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as",
+    "was", "with", "be", "by", "on", "not", "he", "this", "are", "or",
+    "his", "from", "at", "which", "but", "have", "an", "had", "they",
+    "you", "were", "their", "one", "all", "we", "can", "her", "has",
+    "there", "been", "if", "more", "when", "will", "would", "who", "so",
+    "President", "Monday", "London", "United", "States", "Company",
+    "government", "announced", "percent", "million", "according", "market",
+    "well-known", "co-operation", "don't", "U.S.", "NASA", "e-mail",
+  };
+  static const char *punctuation[] = {",", ".", "\"", "'", "(", ")", ":"};
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> rank(0, sizeof(words) / sizeof(words[0]));
+  string text;
+  for (int i = 0; i < tokens; ++i) {
+    int r = rng() % 100;
+    if (r < 8) {
+      text.append(punctuation[rng() % 7]);
+    } else if (r < 12) {
+      text.append(std::to_string(rng() % 100000));
+    } else {
+      // Zipf-like word distribution.
+      int w = std::min(rank(rng), rank(rng));
+      text.append(words[w % (sizeof(words) / sizeof(words[0]))]);
+    }
+    text.push_back(i % 20 == 19 ? '\n' : ' ');
+  }
+  return text;
+}
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+
+  // Read or generate text.
+  string text;
+  if (!FLAGS_input.empty()) {
+    CHECK(File::ReadContents(FLAGS_input, &text));
+  } else {
+    text = SyntheticText(FLAGS_tokens);
+  }
+
+  // Tokenize text.
+  Store commons;
+  DocumentTokenizer tokenizer;
+  { Document names(&commons); }
+  commons.Freeze();
+  Store store(&commons);
+  Document document(&store);
+  tokenizer.Tokenize(&document, text);
+  int num_tokens = document.num_tokens();
+  CHECK_GT(num_tokens, 0);
+
+  // Build lexicon from the most frequent words.
+  std::unordered_map<string, int> counts;
+  for (int i = 0; i < num_tokens; ++i) {
+    string word = document.token(i).text();
+    if (FLAGS_normalize_digits) {
+      for (char &c : word) if (c >= '0' && c <= '9') c = '9';
+    }
+    counts[word]++;
+  }
+  std::vector<std::pair<int, string>> vocabulary;
+  for (auto &it : counts) vocabulary.emplace_back(-it.second, it.first);
+  std::sort(vocabulary.begin(), vocabulary.end());
+  if (vocabulary.size() > FLAGS_words) vocabulary.resize(FLAGS_words);
+
+  string words;
+  AffixTable prefixes(AffixTable::PREFIX, FLAGS_affix_length);
+  AffixTable suffixes(AffixTable::SUFFIX, FLAGS_affix_length);
+  for (auto &v : vocabulary) {
+    words.append(v.second);
+    words.push_back('\n');
+    prefixes.AddAffixesForWord(v.second);
+    suffixes.AddAffixesForWord(v.second);
+  }
+  words.append("<UNKNOWN>\n");
+  string prefix_data;
+  string suffix_data;
+  {
+    StringOutputStream prefix_stream(&prefix_data);
+    prefixes.Write(&prefix_stream);
+    StringOutputStream suffix_stream(&suffix_data);
+    suffixes.Write(&suffix_stream);
+  }
+
+  Lexicon lexicon;
+  lexicon.InitWords(words.data(), words.size());
+  lexicon.set_normalize_digits(FLAGS_normalize_digits);
+  lexicon.set_oov(vocabulary.size());
+  if (FLAGS_affix_length > 0) {
+    lexicon.InitPrefixes(prefix_data.data(), prefix_data.size());
+    lexicon.InitSuffixes(suffix_data.data(), suffix_data.size());
+  }
+
+  // Extract features until the minimum measurement time has been reached.
+  FeatureCache *cache = nullptr;
+  if (FLAGS_cache > 0) cache = new FeatureCache(FLAGS_cache);
+  DocumentFeatures features(&lexicon, cache);
+  int64 n = 0;
+  Clock clock;
+  clock.start();
+  do {
+    features.Extract(document);
+    n += num_tokens;
+    clock.stop();
+  } while (clock.ms() < FLAGS_min_time);
+
+  // Count out-of-vocabulary and non-ASCII tokens.
+  int oov = 0;
+  int unicode = 0;
+  for (int i = 0; i < num_tokens; ++i) {
+    if (features.word(i) == lexicon.oov()) oov++;
+    for (char c : document.token(i).text()) {
+      if (c & 0x80) {
+        unicode++;
+        break;
+      }
+    }
+  }
+
+  // Output results. Each token has eight lexical features.
+  double secs = clock.secs();
+  std::cout << StringPrintf("%d tokens, %d words in lexicon, "
+                            "%.1f%% oov, %.1f%% non-ascii\n",
+                            num_tokens, static_cast<int>(lexicon.size()),
+                            oov * 100.0 / num_tokens,
+                            unicode * 100.0 / num_tokens);
+  std::cout << StringPrintf("%.1f ns/token, %.0f tokens/s, %.0f features/s\n",
+                            clock.ns() / n, n / secs, n * 8 / secs);
+  if (cache != nullptr) {
+    std::cout << cache->Report() << "\n";
+    delete cache;
+  }
+
+  return 0;
+}
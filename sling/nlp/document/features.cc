@@ -14,137 +14,296 @@
 
 #include "sling/nlp/document/features.h"
 
+#include "sling/base/logging.h"
 #include "sling/base/types.h"
 #include "sling/nlp/document/document.h"
+#include "sling/string/printf.h"
+#include "sling/string/text.h"
+#include "sling/util/fingerprint.h"
 #include "sling/util/unicode.h"
 
 namespace sling {
 namespace nlp {
 
+namespace {
+
+// Character classes for ASCII characters.
+enum CharClass {
+  CHAR_UPPER = 0x01,
+  CHAR_LOWER = 0x02,
+  CHAR_PUNCT = 0x04,
+  CHAR_DIGIT = 0x08,
+  CHAR_HYPHEN = 0x10,
+};
+
+// Character class and quote feature for each ASCII character. The table is
+// computed from the Unicode tables, so the ASCII fast path gives the same
+// features as decoding the characters.
+struct AsciiTable {
+  AsciiTable() {
+    for (int c = 0; c < 128; ++c) {
+      int cat = Unicode::Category(c);
+      uint8 flags = 0;
+      if (Unicode::IsUpper(c)) flags |= CHAR_UPPER;
+      if (Unicode::IsLower(c)) flags |= CHAR_LOWER;
+      if (Unicode::IsPunctuation(c)) flags |= CHAR_PUNCT;
+      if (Unicode::IsDigit(c)) flags |= CHAR_DIGIT;
+      if (cat == CHARCAT_DASH_PUNCTUATION) flags |= CHAR_HYPHEN;
+      classes[c] = flags;
+      quotes[c] = DocumentFeatures::QuoteClass(c, cat);
+    }
+  }
+
+  uint8 classes[128];
+  DocumentFeatures::Quote quotes[128];
+};
+
+const AsciiTable &ascii_table() {
+  static AsciiTable table;
+  return table;
+}
+
+}  // namespace
+
+DocumentFeatures::Quote DocumentFeatures::QuoteClass(int code, int category) {
+  switch (category) {
+    case CHARCAT_INITIAL_QUOTE_PUNCTUATION:
+      return OPEN_QUOTE;
+    case CHARCAT_FINAL_QUOTE_PUNCTUATION:
+      return CLOSE_QUOTE;
+    case CHARCAT_OTHER_PUNCTUATION:
+      if (code == '\'' || code == '"') return UNKNOWN_QUOTE;
+      break;
+    case CHARCAT_MODIFIER_SYMBOL:
+      if (code == '`') return UNKNOWN_QUOTE;
+      break;
+  }
+  return NO_QUOTE;
+}
+
 void DocumentFeatures::Extract(const Document &document) {
   features_.resize(document.num_tokens());
-  bool extract_prefixes = lexicon_->prefixes().size() != 0;
-  bool extract_suffixes = lexicon_->suffixes().size() != 0;
   int oov = lexicon_->oov();
   bool in_quote = false;
   for (int i = 0; i < document.num_tokens(); ++i) {
-    string word = document.token(i).text();
+    const Token &token = document.token(i);
+    Text word = token.text();
     TokenFeatures &f = features_[i];
 
     // Look up word in lexicon.
     f.word = lexicon_->LookupWord(word);
 
-    // Look up longest prefix.
-    if (extract_prefixes) {
-      if (f.word != oov) {
-        f.prefix = lexicon_->prefix(f.word);
-      } else {
-        f.prefix = lexicon_->prefixes().GetLongestAffix(word);
+    // Compute the features for the word. The features for out-of-vocabulary
+    // words are looked up in the cache if one is provided.
+    if (f.word == oov && cache_ != nullptr) {
+      uint64 key = FeatureCache::Fingerprint(word);
+      if (!cache_->Lookup(key, &f)) {
+        ComputeWordFeatures(word, &f);
+        cache_->Insert(key, f);
       }
+    } else {
+      ComputeWordFeatures(word, &f);
     }
 
-    // Look up longest suffix.
-    if (extract_suffixes) {
-      if (f.word != oov) {
-        f.suffix = lexicon_->suffix(f.word);
-      } else {
-        f.suffix = lexicon_->suffixes().GetLongestAffix(word);
-      }
+    // Capitalized words at the start of a sentence are initial.
+    if (f.capitalization == CAPITALIZED) {
+      if (i == 0 || token.brk() >= SENTENCE_BREAK) f.capitalization = INITIAL;
     }
 
-    // Categorize token.
-    bool has_upper = false;
-    bool has_lower = false;
-    bool has_punctuation = false;
-    bool all_punctuation = true;
-    bool has_digit = false;
-    bool all_digit = true;
-    const char *p = word.data();
-    const char *end = p + word.size();
-    while (p < end) {
-      int code = UTF8::Decode(p);
-      int cat = Unicode::Category(code);
-
-      // Hyphenation.
-      if (cat == CHARCAT_DASH_PUNCTUATION) {
-        f.hyphen = HAS_HYPHEN;
-      }
-
-      // Capitalization.
-      if (Unicode::IsUpper(code)) has_upper = true;
-      if (Unicode::IsLower(code)) has_lower = true;
-
-      // Punctuation.
-      bool is_punct = Unicode::IsPunctuation(code);
-      all_punctuation &= is_punct;
-      has_punctuation |= is_punct;
-
-      // Quotes.
-      switch (cat) {
-        case CHARCAT_INITIAL_QUOTE_PUNCTUATION:
-          f.quote = OPEN_QUOTE;
-          break;
-        case CHARCAT_FINAL_QUOTE_PUNCTUATION:
-          f.quote = CLOSE_QUOTE;
-          break;
-        case CHARCAT_OTHER_PUNCTUATION:
-          if (code == '\'' || code == '"') f.quote = UNKNOWN_QUOTE;
-          break;
-        case CHARCAT_MODIFIER_SYMBOL:
-          if (code == '`') f.quote = UNKNOWN_QUOTE;
-          break;
-      }
-
-      // Digits.
-      bool is_digit = Unicode::IsDigit(code);
-      all_digit &= is_digit;
-      has_digit |= is_digit;
-
-      p = UTF8::Next(p);
+    // Ambiguous quotes alternate between open and close quotes.
+    if (f.quote == UNKNOWN_QUOTE) {
+      f.quote = in_quote ? CLOSE_QUOTE : OPEN_QUOTE;
+      in_quote = !in_quote;
     }
+  }
+}
 
-    // Compute word capitalization.
-    if (!has_upper && has_lower) {
-      f.capitalization = LOWERCASE;
-    } else if (has_upper && !has_lower) {
-      f.capitalization = UPPERCASE;
-    } else if (!has_upper && !has_lower) {
-      f.capitalization = NON_ALPHABETIC;
-    } else if (i == 0 || document.token(i).brk() >= SENTENCE_BREAK) {
-      f.capitalization = INITIAL;
+void DocumentFeatures::ComputeWordFeatures(Text word,
+                                           TokenFeatures *f) const {
+  // Look up longest prefix.
+  if (lexicon_->prefixes().size() != 0) {
+    if (f->word != lexicon_->oov()) {
+      f->prefix = lexicon_->prefix(f->word);
     } else {
-      f.capitalization = CAPITALIZED;
+      f->prefix = lexicon_->prefixes().GetLongestAffix(word);
     }
+  }
 
-    // Compute punctuation feature.
-    if (all_punctuation) {
-      f.punctuation = ALL_PUNCTUATION;
-    } else if (has_punctuation) {
-      f.punctuation = SOME_PUNCTUATION;
+  // Look up longest suffix.
+  if (lexicon_->suffixes().size() != 0) {
+    if (f->word != lexicon_->oov()) {
+      f->suffix = lexicon_->suffix(f->word);
     } else {
-      f.punctuation = NO_PUNCTUATION;
-    }
-
-    // Compute quote feature.
-    if (f.quote != NO_QUOTE) {
-      // Penn Treebank open and close quotes are multi-character.
-      if (word == "``") f.quote = OPEN_QUOTE;
-      if (word == "''") f.quote = CLOSE_QUOTE;
-      if (f.quote == UNKNOWN_QUOTE) {
-        f.quote = in_quote ? CLOSE_QUOTE : OPEN_QUOTE;
-        in_quote = !in_quote;
-      }
+      f->suffix = lexicon_->suffixes().GetLongestAffix(word);
     }
+  }
 
-    // Compute digit feature.
-    if (all_digit) {
-      f.digit = ALL_DIGIT;
-    } else if (has_digit) {
-      f.digit = SOME_DIGIT;
+  // Categorize word. ASCII characters are classified with a table lookup,
+  // and only other characters are decoded and looked up in the Unicode
+  // tables.
+  const AsciiTable &ascii = ascii_table();
+  f->hyphen = NO_HYPHEN;
+  f->quote = NO_QUOTE;
+  uint8 any = 0;
+  uint8 all = CHAR_PUNCT | CHAR_DIGIT;
+  const char *p = word.data();
+  const char *end = p + word.size();
+  while (p < end) {
+    uint8 flags;
+    Quote quote;
+    uint8 ch = *reinterpret_cast<const uint8 *>(p);
+    if (ch < 0x80) {
+      flags = ascii.classes[ch];
+      quote = ascii.quotes[ch];
+      p++;
     } else {
-      f.digit = NO_DIGIT;
+      int code = UTF8::Decode(p);
+      int cat = Unicode::Category(code);
+      flags = 0;
+      if (Unicode::IsUpper(code)) flags |= CHAR_UPPER;
+      if (Unicode::IsLower(code)) flags |= CHAR_LOWER;
+      if (Unicode::IsPunctuation(code)) flags |= CHAR_PUNCT;
+      if (Unicode::IsDigit(code)) flags |= CHAR_DIGIT;
+      if (cat == CHARCAT_DASH_PUNCTUATION) flags |= CHAR_HYPHEN;
+      quote = QuoteClass(code, cat);
+      p = UTF8::Next(p);
     }
+    any |= flags;
+    all &= flags;
+    if (quote != NO_QUOTE) f->quote = quote;
   }
+  if (any & CHAR_HYPHEN) f->hyphen = HAS_HYPHEN;
+  bool has_upper = any & CHAR_UPPER;
+  bool has_lower = any & CHAR_LOWER;
+  bool has_punctuation = any & CHAR_PUNCT;
+  bool all_punctuation = all & CHAR_PUNCT;
+  bool has_digit = any & CHAR_DIGIT;
+  bool all_digit = all & CHAR_DIGIT;
+
+  // Compute word capitalization.
+  if (!has_upper && has_lower) {
+    f->capitalization = LOWERCASE;
+  } else if (has_upper && !has_lower) {
+    f->capitalization = UPPERCASE;
+  } else if (!has_upper && !has_lower) {
+    f->capitalization = NON_ALPHABETIC;
+  } else {
+    f->capitalization = CAPITALIZED;
+  }
+
+  // Compute punctuation feature.
+  if (all_punctuation) {
+    f->punctuation = ALL_PUNCTUATION;
+  } else if (has_punctuation) {
+    f->punctuation = SOME_PUNCTUATION;
+  } else {
+    f->punctuation = NO_PUNCTUATION;
+  }
+
+  // Penn Treebank open and close quotes are multi-character.
+  if (f->quote != NO_QUOTE) {
+    if (word == "``") f->quote = OPEN_QUOTE;
+    if (word == "''") f->quote = CLOSE_QUOTE;
+  }
+
+  // Compute digit feature.
+  if (all_digit) {
+    f->digit = ALL_DIGIT;
+  } else if (has_digit) {
+    f->digit = SOME_DIGIT;
+  } else {
+    f->digit = NO_DIGIT;
+  }
+}
+
+FeatureCache::FeatureCache(int capacity) : capacity_(capacity) {
+  CHECK_GT(capacity, 0);
+  shard_capacity_ = (capacity + kShards - 1) / kShards;
+  shards_ = new Shard[kShards];
+}
+
+FeatureCache::~FeatureCache() {
+  delete [] shards_;
+}
+
+uint64 FeatureCache::Fingerprint(Text word) {
+  return sling::Fingerprint(word.data(), word.size());
+}
+
+bool FeatureCache::Lookup(uint64 key,
+                          DocumentFeatures::TokenFeatures *features) {
+  Shard *s = shard(key);
+  std::unique_lock<std::mutex> lock(s->mu);
+  auto f = s->index.find(key);
+  if (f == s->index.end()) {
+    s->stats.misses++;
+    return false;
+  }
+
+  // Move entry to the front of the LRU list.
+  s->entries.splice(s->entries.begin(), s->entries, f->second);
+  *features = f->second->features;
+  s->stats.hits++;
+  return true;
+}
+
+void FeatureCache::Insert(uint64 key,
+                          const DocumentFeatures::TokenFeatures &features) {
+  Shard *s = shard(key);
+  std::unique_lock<std::mutex> lock(s->mu);
+
+  // The word might have been added by another thread after the lookup.
+  auto f = s->index.find(key);
+  if (f != s->index.end()) {
+    s->entries.splice(s->entries.begin(), s->entries, f->second);
+    return;
+  }
+
+  // Evict least recently used word if shard is full.
+  if (s->entries.size() >= shard_capacity_) {
+    s->index.erase(s->entries.back().key);
+    s->entries.pop_back();
+    s->stats.evictions++;
+  }
+
+  // Add word to the front of the LRU list.
+  s->entries.push_front({key, features});
+  s->index[key] = s->entries.begin();
+  s->stats.insertions++;
+}
+
+void FeatureCache::Clear() {
+  for (int i = 0; i < kShards; ++i) {
+    Shard *s = &shards_[i];
+    std::unique_lock<std::mutex> lock(s->mu);
+    s->entries.clear();
+    s->index.clear();
+  }
+}
+
+FeatureCache::Stats FeatureCache::stats() const {
+  Stats stats;
+  for (int i = 0; i < kShards; ++i) {
+    const Shard *s = &shards_[i];
+    std::unique_lock<std::mutex> lock(s->mu);
+    stats.hits += s->stats.hits;
+    stats.misses += s->stats.misses;
+    stats.insertions += s->stats.insertions;
+    stats.evictions += s->stats.evictions;
+    stats.size += s->entries.size();
+  }
+  return stats;
+}
+
+string FeatureCache::Report() const {
+  Stats s = stats();
+  return StringPrintf("feature cache: %lld hits, %lld misses, "
+                      "%.1f%% hit rate, %lld words, %lld evictions",
+                      static_cast<long long>(s.hits),
+                      static_cast<long long>(s.misses),
+                      s.hit_rate() * 100.0,
+                      static_cast<long long>(s.size),
+                      static_cast<long long>(s.evictions));
 }
 
 }  // namespace nlp
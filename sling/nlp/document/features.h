@@ -15,15 +15,22 @@
 #ifndef SLING_NLP_DOCUMENT_FEATURES_H_
 #define SLING_NLP_DOCUMENT_FEATURES_H_
 
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "sling/base/types.h"
 #include "sling/nlp/document/document.h"
 #include "sling/nlp/document/lexicon.h"
+#include "sling/string/text.h"
 
 namespace sling {
 namespace nlp {
 
+class FeatureCache;
+
 // Extract lexical features from the tokens in a document.
 class DocumentFeatures {
  public:
@@ -69,12 +76,30 @@ class DocumentFeatures {
     DIGIT__CARDINALITY = 3,
   };
 
-  // Initialize lexical feature extractor.
-  DocumentFeatures(const Lexicon *lexicon) : lexicon_(lexicon) {}
+  // Lexical features for token.
+  struct TokenFeatures {
+    int word;                                   // word id
+    Affix *prefix = nullptr;                    // longest prefix
+    Affix *suffix = nullptr;                    // longest suffix
+    Hyphen hyphen = NO_HYPHEN;                  // hyphenation
+    Capitalization capitalization = LOWERCASE;  // capitalization
+    Punctuation punctuation = NO_PUNCTUATION;   // punctuation
+    Quote quote = NO_QUOTE;                     // quotes
+    Digit digit = NO_DIGIT;                     // digits
+  };
+
+  // Initialize lexical feature extractor. If a feature cache is provided, the
+  // features for out-of-vocabulary words are looked up in the cache. The
+  // cache must only be used with the same lexicon.
+  DocumentFeatures(const Lexicon *lexicon, FeatureCache *cache = nullptr)
+      : lexicon_(lexicon), cache_(cache) {}
 
   // Extract features from document.
   void Extract(const Document &document);
 
+  // Return quote feature for character with Unicode category.
+  static Quote QuoteClass(int code, int category);
+
   // Get features for token.
   int word(int index) const {
     return features_[index].word;
@@ -102,25 +127,107 @@ class DocumentFeatures {
   }
 
  private:
-  // Lexical features for token.
-  struct TokenFeatures {
-    int word;                                   // word id
-    Affix *prefix = nullptr;                    // longest prefix
-    Affix *suffix = nullptr;                    // longest suffix
-    Hyphen hyphen = NO_HYPHEN;                  // hyphenation
-    Capitalization capitalization = LOWERCASE;  // capitalization
-    Punctuation punctuation = NO_PUNCTUATION;   // punctuation
-    Quote quote = NO_QUOTE;                     // quotes
-    Digit digit = NO_DIGIT;                     // digits
-  };
+  // Compute the features for a word that do not depend on the context of the
+  // token. Mixed-case words are marked as capitalized and ambiguous quotes
+  // are marked as unknown.
+  void ComputeWordFeatures(Text word, TokenFeatures *f) const;
 
   // Lexicon for looking up feature values.
   const Lexicon *lexicon_;
 
+  // Cache with features for out-of-vocabulary words or null if not cached.
+  FeatureCache *cache_;
+
   // Features for tokens.
   std::vector<TokenFeatures> features_;
 };
 
+// Bounded LRU cache with the lexical features for out-of-vocabulary words.
+// Looking up the longest prefix and suffix for words that are not in the
+// lexicon is expensive, and the same unknown words tend to be repeated, so
+// the cache can be shared by all threads and documents using the same
+// lexicon. The cache is keyed by a fingerprint of the exact word text and it
+// is split into shards, each with its own lock, to reduce lock contention.
+// The cache is thread-safe.
+class FeatureCache {
+ public:
+  // Cache statistics.
+  struct Stats {
+    int64 hits = 0;            // number of lookups found in cache
+    int64 misses = 0;          // number of lookups not found in cache
+    int64 insertions = 0;      // number of words added to cache
+    int64 evictions = 0;       // number of words evicted from cache
+    int64 size = 0;            // number of words in cache
+
+    // Fraction of lookups found in cache.
+    double hit_rate() const {
+      int64 lookups = hits + misses;
+      return lookups > 0 ? static_cast<double>(hits) / lookups : 0.0;
+    }
+  };
+
+  // Initialize cache with a maximum number of words.
+  explicit FeatureCache(int capacity);
+  ~FeatureCache();
+
+  // Compute cache key for word.
+  static uint64 Fingerprint(Text word);
+
+  // Look up features for word. Returns false if the word is not in the cache.
+  bool Lookup(uint64 key, DocumentFeatures::TokenFeatures *features);
+
+  // Add features for word to the cache, evicting the least recently used
+  // word in the shard if it is full.
+  void Insert(uint64 key, const DocumentFeatures::TokenFeatures &features);
+
+  // Remove all words from the cache. The statistics are kept.
+  void Clear();
+
+  // Return cache statistics.
+  Stats stats() const;
+
+  // Return report with cache statistics.
+  string Report() const;
+
+  // Maximum number of words in cache.
+  int capacity() const { return capacity_; }
+
+ private:
+  // Cached word.
+  struct Entry {
+    uint64 key;                                // word fingerprint
+    DocumentFeatures::TokenFeatures features;  // features for word
+  };
+
+  // Cache shard with the words for a subset of the keys.
+  struct Shard {
+    // Cached words in most recently used order.
+    std::list<Entry> entries;
+
+    // Mapping from word fingerprint to entry.
+    std::unordered_map<uint64, std::list<Entry>::iterator> index;
+
+    // Shard statistics.
+    Stats stats;
+
+    // Mutex for protecting shard.
+    mutable std::mutex mu;
+  };
+
+  // Number of cache shards.
+  static const int kShards = 64;
+
+  // Return shard for key.
+  Shard *shard(uint64 key) const { return &shards_[key % kShards]; }
+
+  // Maximum number of words in cache and in each shard.
+  int capacity_;
+  int shard_capacity_;
+
+  // Cache shards.
+  Shard *shards_;
+};
+
 }  // namespace nlp
 }  // namespace sling
 
@@ -14,6 +14,8 @@
 
 #include "sling/nlp/document/lexicon.h"
 
+#include <string.h>
+
 #include "sling/base/types.h"
 #include "sling/nlp/document/affix.h"
 #include "sling/stream/memory.h"
@@ -68,24 +70,34 @@ void Lexicon::InitSuffixes(const char *data, size_t size) {
   }
 }
 
-int Lexicon::LookupWord(const string &word) const {
+int Lexicon::LookupWord(Text word) const {
   // Lookup word in vocabulary.
-  int id = vocabulary_.Lookup(word);
+  int id = vocabulary_.Lookup(word.data(), word.size());
 
   if (id == -1 && normalize_digits_) {
-    // Check if word has digits.
-    bool has_digits = false;
-    for (char c : word) {
-      if (c >= '0' && c <= '9') has_digits = true;
-    }
-
-    if (has_digits) {
-      // Normalize digits and lookup the normalized word.
-      string normalized = word;
-      for (char &c : normalized) {
-        if (c >= '0' && c <= '9') c = '9';
+    // Find first digit in word.
+    const char *begin = word.data();
+    const char *end = begin + word.size();
+    const char *p = begin;
+    while (p < end && (*p < '0' || *p > '9')) p++;
+
+    if (p < end) {
+      // Normalize digits and lookup the normalized word. Words that fit in
+      // the stack buffer are normalized in place without allocating memory.
+      const static int kMaxStackWord = 128;
+      char buffer[kMaxStackWord];
+      string heap;
+      char *normalized = buffer;
+      if (word.size() > kMaxStackWord) {
+        heap.resize(word.size());
+        normalized = &heap[0];
+      }
+      memcpy(normalized, begin, p - begin);
+      for (char *q = normalized + (p - begin); p < end; ++p, ++q) {
+        char c = *p;
+        *q = c >= '0' && c <= '9' ? '9' : c;
       }
-      id = vocabulary_.Lookup(normalized);
+      id = vocabulary_.Lookup(normalized, word.size());
     }
   }
 
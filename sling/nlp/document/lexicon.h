@@ -20,6 +20,7 @@
 
 #include "sling/base/types.h"
 #include "sling/nlp/document/affix.h"
+#include "sling/string/text.h"
 #include "sling/util/vocabulary.h"
 
 namespace sling {
@@ -35,8 +36,10 @@ class Lexicon {
   void InitPrefixes(const char *data, size_t size);
   void InitSuffixes(const char *data, size_t size);
 
-  // Look up word in vocabulary. Return OOV if word is not found.
-  int LookupWord(const string &word) const;
+  // Look up word in vocabulary. Return OOV if word is not found. Digits are
+  // normalized in a stack buffer, so short words are looked up without
+  // allocating memory.
+  int LookupWord(Text word) const;
 
   // Return number of words in vocabulary.
   size_t size() const { return words_.size(); }
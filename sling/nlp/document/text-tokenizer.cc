@@ -18,6 +18,10 @@
 #include <vector>
 #include <unordered_map>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "sling/base/logging.h"
 #include "sling/base/types.h"
 #include "sling/string/ctype.h"
@@ -29,6 +33,26 @@ namespace nlp {
 
 static const int kMaxAscii = 128;
 
+// Returns the length of the run of ASCII characters at the start of the text
+// that can be converted without UTF-8 decoding, i.e. all characters except
+// ampersands which can start HTML entities.
+static int AsciiRun(const char *s, const char *end) {
+  const char *p = s;
+#ifdef __SSE2__
+  // Check 16 bytes at a time. Non-ASCII bytes have the high bit set.
+  const __m128i amp = _mm_set1_epi8('&');
+  while (end - p >= 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    int mask = _mm_movemask_epi8(bytes) |
+               _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, amp));
+    if (mask != 0) return p - s + __builtin_ctz(mask);
+    p += 16;
+  }
+#endif
+  while (p < end && (*p & 0x80) == 0 && *p != '&') p++;
+  return p - s;
+}
+
 // Trie for searching for special token/suffix types.
 class TrieNode {
  public:
@@ -144,6 +168,26 @@ TokenizerText::TokenizerText(Text text, const CharacterFlags &char_flags) {
   int i = 0;
   int escapes = 0;
   while (cur < end) {
+    // Convert runs of ASCII characters directly without decoding.
+    int run = AsciiRun(cur, end);
+    if (run > 0) {
+      if (i + run >= elements_.size()) elements_.resize(i + run + 1);
+      for (int j = 0; j < run; ++j) {
+        uint8 c = *reinterpret_cast<const uint8 *>(cur);
+        Element &e = elements_[i++];
+        e.ch = c;
+        e.position = cur - start;
+        e.flags = char_flags.ascii(c);
+        e.node = nullptr;
+        e.escapes = escapes;
+        cur++;
+      }
+      if (cur == end) break;
+    }
+
+    // Stray UTF-8 continuation bytes are not counted in the text length, but
+    // each of them takes up an element, so the array might need to grow.
+    if (i + 1 >= elements_.size()) elements_.resize(i + 2);
     Element &e = elements_[i];
     e.position = cur - start;
     e.node = nullptr;
@@ -194,7 +238,7 @@ void TokenizerText::GetText(int start, int end, string *result) const {
   if (elements_[start].escapes == elements_[end].escapes) {
     int from = elements_[start].position;
     int to = elements_[end].position;
-    result->append(source_.data(), from, to - from);
+    result->append(source_.data() + from, to - from);
   } else {
     for (int i = start; i < end; ++i) {
       UTF8::Encode(elements_[i].ch, result);
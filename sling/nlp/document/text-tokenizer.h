@@ -89,6 +89,9 @@ class CharacterFlags {
   // Returns the flags for a character value.
   TokenFlags get(char32 ch) const;
 
+  // Returns the flags for an ASCII character (0-127).
+  TokenFlags ascii(uint8 ch) const { return low_flags_[ch]; }
+
  private:
   std::vector<TokenFlags> low_flags_;
   std::unordered_map<char32, TokenFlags> high_flags_;
@@ -155,12 +158,12 @@ class TokenizerText {
     // Token and character flags.
     TokenFlags flags;
 
-    // Token node reference.
-    const TrieNode *node;
-
     // Count of escaped entities so far in the text. This is used for quickly
     // determining if a range in the text contains any escaped entities.
     int escapes;
+
+    // Token node reference.
+    const TrieNode *node;
   };
 
   // Source text.
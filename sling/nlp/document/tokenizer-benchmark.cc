@@ -0,0 +1,125 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmark for the text tokenizer. The text in --input, or synthetic text if
+// no input file is given, is tokenized repeatedly until the minimum
+// measurement time has been reached.
+
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+#include "sling/file/file.h"
+#include "sling/nlp/document/text-tokenizer.h"
+#include "sling/string/printf.h"
+
+DEFINE_string(input, "", "Text file for benchmark");
+DEFINE_int32(tokens, 100000, "Number of tokens in synthetic text");
+DEFINE_double(unicode, 0.0, "Fraction of non-ASCII words in synthetic text");
+DEFINE_bool(ptb, false, "Use PTB tokenization instead of LDC tokenization");
+DEFINE_double(min_time, 1000, "Minimum measurement time (ms)");
+
+using namespace sling;
+using namespace sling::nlp;
+
+// Generate synthetic text with words, numbers, punctuation, and HTML entities.
+static string SyntheticText(int tokens, double unicode) {
+  static const char *words[] = {
+    "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as",
+    "was", "with", "be", "by", "on", "not", "he", "this", "are", "or",
+    "his", "from", "at", "which", "but", "have", "an", "had", "they",
+    "President", "Monday", "London", "United", "States", "Company",
+    "government", "announced", "percent", "million", "according", "market",
+    "well-known", "co-operation", "don't", "U.S.", "NASA", "e-mail",
+    "can't", "Mr.", "&amp;", "(", ")", "\"", ",", ",", ".", ":", "$",
+  };
+  static const char *unicode_words[] = {
+    "caf\xc3\xa9", "Z\xc3\xbcrich", "na\xc3\xafve", "\xe2\x80\x9c",
+    "\xe2\x80\x9d", "\xe2\x80\x94", "\xd0\x9c\xd0\xbe\xd1\x81\xd0\xba\xd0\xb2"
+    "\xd0\xb0", "\xe6\x9d\xb1\xe4\xba\xac", "\xe2\x82\xac" "5",
+  };
+  int num_words = sizeof(words) / sizeof(words[0]);
+  int num_unicode = sizeof(unicode_words) / sizeof(unicode_words[0]);
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  string text;
+  for (int i = 0; i < tokens; ++i) {
+    if (uniform(rng) < unicode) {
+      text.append(unicode_words[rng() % num_unicode]);
+    } else if (rng() % 100 < 4) {
+      text.append(std::to_string(rng() % 100000));
+    } else {
+      text.append(words[rng() % num_words]);
+    }
+    if (i % 20 == 19) {
+      text.append(". ");
+    } else {
+      text.push_back(' ');
+    }
+  }
+  return text;
+}
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+
+  // Read or generate text.
+  string text;
+  if (!FLAGS_input.empty()) {
+    CHECK(File::ReadContents(FLAGS_input, &text));
+  } else {
+    text = SyntheticText(FLAGS_tokens, FLAGS_unicode);
+  }
+
+  // Initialize tokenizer.
+  Tokenizer tokenizer;
+  if (FLAGS_ptb) {
+    tokenizer.InitPTB();
+  } else {
+    tokenizer.InitLDC();
+  }
+
+  // Tokenize text until the minimum measurement time has been reached.
+  int64 tokens = 0;
+  int64 sentences = 0;
+  int64 passes = 0;
+  Clock clock;
+  clock.start();
+  do {
+    tokenizer.Tokenize(text, [&](const Tokenizer::Token &token) {
+      tokens++;
+      if (token.brk >= SENTENCE_BREAK) sentences++;
+    });
+    passes++;
+    clock.stop();
+  } while (clock.ms() < FLAGS_min_time);
+  CHECK_GT(tokens, 0);
+
+  // Output results.
+  double secs = clock.secs();
+  std::cout << StringPrintf("%lld bytes, %lld tokens, %lld sentences\n",
+                            static_cast<long long>(text.size()),
+                            static_cast<long long>(tokens / passes),
+                            static_cast<long long>(sentences / passes));
+  std::cout << StringPrintf("%.1f ns/token, %.0f tokens/s, %.1f MB/s\n",
+                            clock.ns() / tokens, tokens / secs,
+                            text.size() * passes / secs / 1e6);
+
+  return 0;
+}
@@ -0,0 +1,235 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/nlp/parser/action-mask.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace sling {
+namespace nlp {
+
+namespace {
+
+// Set bit in mask.
+inline void SetBit(uint64 *mask, int bit) {
+  mask[bit >> 6] |= 1ULL << (bit & 63);
+}
+
+// Clear bit in mask.
+inline void ClearBit(uint64 *mask, int bit) {
+  mask[bit >> 6] &= ~(1ULL << (bit & 63));
+}
+
+#ifdef __SSE2__
+// Lane masks for all combinations of four bits.
+struct LaneMasks {
+  LaneMasks() {
+    for (int bits = 0; bits < 16; ++bits) {
+      int32 lanes[4];
+      for (int i = 0; i < 4; ++i) lanes[i] = (bits >> i) & 1 ? -1 : 0;
+      masks[bits] = _mm_castsi128_ps(_mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(lanes)));
+    }
+  }
+  __m128 masks[16];
+};
+
+static const LaneMasks lane_masks;
+#endif
+
+}  // namespace
+
+void ActionMask::Init(const ActionTable &actions) {
+  actions_ = &actions;
+  num_actions_ = actions.NumActions();
+  words_ = (num_actions_ + 63) / 64;
+
+  // Find the maximum span length and attention index used by actions within
+  // the bounds of the table.
+  max_length_ = 0;
+  max_index_ = 0;
+  for (int i = 0; i < num_actions_; ++i) {
+    if (actions.Beyond(i)) continue;
+    const ParserAction &action = actions.Action(i);
+    switch (action.type) {
+      case ParserAction::EVOKE:
+        max_length_ = std::max<int>(max_length_, action.length);
+        break;
+      case ParserAction::REFER:
+        max_length_ = std::max<int>(max_length_, action.length);
+        max_index_ = std::max<int>(max_index_, action.target);
+        break;
+      case ParserAction::CONNECT:
+        max_index_ = std::max<int>(max_index_, action.source);
+        max_index_ = std::max<int>(max_index_, action.target);
+        break;
+      case ParserAction::ASSIGN:
+      case ParserAction::ELABORATE:
+        max_index_ = std::max<int>(max_index_, action.source);
+        break;
+      case ParserAction::EMBED:
+        max_index_ = std::max<int>(max_index_, action.target);
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Build group masks. Length groups are indexed by the maximum length and
+  // attention groups by the number of frames in the attention buffer.
+  int lengths = max_length_ + 1;
+  int sizes = max_index_ + 2;
+  shift_.assign(words_, 0);
+  stop_.assign(words_, 0);
+  evoke_.assign(lengths * words_, 0);
+  refer_length_.assign(lengths * words_, 0);
+  refer_target_.assign(sizes * words_, 0);
+  frame_.assign(sizes * words_, 0);
+  for (int i = 0; i < num_actions_; ++i) {
+    if (actions.Beyond(i)) continue;
+    const ParserAction &action = actions.Action(i);
+    switch (action.type) {
+      case ParserAction::SHIFT:
+        SetBit(shift_.data(), i);
+        break;
+      case ParserAction::STOP:
+        SetBit(stop_.data(), i);
+        break;
+      case ParserAction::EVOKE:
+        AddCumulative(&evoke_, action.length, max_length_, i);
+        break;
+      case ParserAction::REFER:
+        AddCumulative(&refer_length_, action.length, max_length_, i);
+        AddCumulative(&refer_target_, action.target + 1, max_index_ + 1, i);
+        break;
+      case ParserAction::CONNECT:
+        AddCumulative(&frame_, std::max(action.source, action.target) + 1,
+                      max_index_ + 1, i);
+        break;
+      case ParserAction::ASSIGN:
+      case ParserAction::ELABORATE:
+        AddCumulative(&frame_, action.source + 1, max_index_ + 1, i);
+        break;
+      case ParserAction::EMBED:
+        AddCumulative(&frame_, action.target + 1, max_index_ + 1, i);
+        break;
+    }
+  }
+}
+
+void ActionMask::AddCumulative(std::vector<uint64> *masks, int value, int max,
+                               int action) {
+  for (int n = value; n <= max; ++n) {
+    SetBit(masks->data() + n * words_, action);
+  }
+}
+
+void ActionMask::Compute(const ParserState &state, uint64 *mask) const {
+  // SHIFT is allowed before the end of the input and STOP at the end.
+  if (state.current() < state.end()) {
+    memcpy(mask, shift_.data(), words_ * sizeof(uint64));
+  } else {
+    memcpy(mask, stop_.data(), words_ * sizeof(uint64));
+  }
+
+  // EVOKE and REFER are allowed for spans that fit in the input and do not
+  // cross existing spans.
+  int length = std::min(state.MaxEvokeLength(max_length_), max_length_);
+  int size = std::min(state.AttentionSize(), max_index_ + 1);
+  if (length > 0) {
+    const uint64 *evoke = group(evoke_, length);
+    const uint64 *refer = group(refer_length_, length);
+    const uint64 *target = group(refer_target_, size);
+    for (int w = 0; w < words_; ++w) {
+      mask[w] |= evoke[w] | (refer[w] & target[w]);
+    }
+  }
+
+  // Frame actions are allowed for frames in the attention buffer until the
+  // parser is done.
+  if (!state.done() && size > 0) {
+    const uint64 *frame = group(frame_, size);
+    for (int w = 0; w < words_; ++w) mask[w] |= frame[w];
+  }
+}
+
+int ActionMask::Argmax(const ParserState &state, const float *scores,
+                       uint64 *mask) const {
+  Compute(state, mask);
+  for (;;) {
+    // Find best candidate passing the structural checks.
+    int best = MaskedArgmax(scores, mask);
+    if (best == -1) return -1;
+
+    // Return candidate if it passes the remaining checks. Otherwise, remove it
+    // and try the next best candidate.
+    if (state.CanApply(actions_->Action(best))) return best;
+    ClearBit(mask, best);
+  }
+}
+
+int ActionMask::MaskedArgmax(const float *scores, const uint64 *mask) const {
+  // Find highest masked score.
+  float max_score = -INFINITY;
+  for (int w = 0; w < words_; ++w) {
+    uint64 bits = mask[w];
+    if (bits == 0) continue;
+    int base = w * 64;
+    int n = std::min(64, num_actions_ - base);
+    const float *s = scores + base;
+    int i = 0;
+#ifdef __SSE2__
+    __m128 best = _mm_set1_ps(-INFINITY);
+    for (; i + 4 <= n; i += 4) {
+      int lanes = (bits >> i) & 15;
+      if (lanes == 0) continue;
+      __m128 x = _mm_loadu_ps(s + i);
+      __m128 valid = _mm_and_ps(lane_masks.masks[lanes], _mm_cmpord_ps(x, x));
+      x = _mm_or_ps(_mm_and_ps(valid, x),
+                    _mm_andnot_ps(valid, _mm_set1_ps(-INFINITY)));
+      best = _mm_max_ps(best, x);
+    }
+    best = _mm_max_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(1, 0, 3, 2)));
+    best = _mm_max_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(2, 3, 0, 1)));
+    float block_max = _mm_cvtss_f32(best);
+    if (block_max > max_score) max_score = block_max;
+#endif
+    for (; i < n; ++i) {
+      if (((bits >> i) & 1) && s[i] > max_score) max_score = s[i];
+    }
+  }
+  if (!(max_score > -INFINITY)) return -1;
+
+  // Find the first masked action with the highest score.
+  for (int w = 0; w < words_; ++w) {
+    uint64 bits = mask[w];
+    while (bits != 0) {
+      int bit = __builtin_ctzll(bits);
+      int a = w * 64 + bit;
+      if (scores[a] == max_score) return a;
+      bits &= bits - 1;
+    }
+  }
+  return -1;
+}
+
+}  // namespace nlp
+}  // namespace sling
+
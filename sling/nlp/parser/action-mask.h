@@ -0,0 +1,99 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_NLP_PARSER_ACTION_MASK_H_
+#define SLING_NLP_PARSER_ACTION_MASK_H_
+
+#include <vector>
+
+#include "sling/base/types.h"
+#include "sling/nlp/parser/action-table.h"
+#include "sling/nlp/parser/parser-state.h"
+
+namespace sling {
+namespace nlp {
+
+// Bit mask over the actions in an action table for selecting the highest
+// scoring action allowed in a parser state. The actions are grouped by type
+// and by their length, source, and target arguments, and the mask for each
+// group is precomputed, so the actions that pass the structural checks for a
+// state, i.e. span length, attention buffer size, and end of input, can be
+// found by combining a few group masks. The remaining checks in
+// ParserState::CanApply() are only done for the best candidate. The selected
+// action is the same as scanning all the actions in index order and picking
+// the first action with the highest score that can be applied and is within
+// the bounds of the action table.
+class ActionMask {
+ public:
+  // Initialize action groups from action table.
+  void Init(const ActionTable &actions);
+
+  // Number of 64-bit words in mask.
+  int words() const { return words_; }
+
+  // Compute mask of actions that pass the structural checks for state.
+  void Compute(const ParserState &state, uint64 *mask) const;
+
+  // Return the index of the highest scoring action that can be applied to the
+  // state, or -1 if no action with a finite score can be applied. The mask is
+  // used as scratch space and must have room for words() words.
+  int Argmax(const ParserState &state, const float *scores,
+             uint64 *mask) const;
+
+ private:
+  // Return mask for group.
+  const uint64 *group(const std::vector<uint64> &masks, int index) const {
+    return masks.data() + index * words_;
+  }
+
+  // Add action to cumulative group masks for all arguments from value to max.
+  void AddCumulative(std::vector<uint64> *masks, int value, int max,
+                     int action);
+
+  // Return the first index of the highest score in the masked scores, or -1
+  // if all the masked scores are -inf or NaN.
+  int MaskedArgmax(const float *scores, const uint64 *mask) const;
+
+  // Action table.
+  const ActionTable *actions_ = nullptr;
+
+  // Number of actions and number of 64-bit words in masks.
+  int num_actions_ = 0;
+  int words_ = 0;
+
+  // Maximum span length and attention index used by actions.
+  int max_length_ = 0;
+  int max_index_ = 0;
+
+  // SHIFT and STOP actions.
+  std::vector<uint64> shift_;
+  std::vector<uint64> stop_;
+
+  // EVOKE actions with length up to n.
+  std::vector<uint64> evoke_;
+
+  // REFER actions with length up to n and with target below n.
+  std::vector<uint64> refer_length_;
+  std::vector<uint64> refer_target_;
+
+  // CONNECT, ASSIGN, EMBED, and ELABORATE actions where all the attention
+  // indices are below n.
+  std::vector<uint64> frame_;
+};
+
+}  // namespace nlp
+}  // namespace sling
+
+#endif  // SLING_NLP_PARSER_ACTION_MASK_H_
+
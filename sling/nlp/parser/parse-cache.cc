@@ -0,0 +1,105 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/nlp/parser/parse-cache.h"
+
+#include "sling/base/logging.h"
+#include "sling/nlp/document/fingerprinter.h"
+#include "sling/string/printf.h"
+
+namespace sling {
+namespace nlp {
+
+ParseCache::ParseCache(int capacity) : capacity_(capacity) {
+  CHECK_GT(capacity, 0);
+}
+
+uint64 ParseCache::Fingerprint(const Document &document,
+                               const DocumentFeatures &features,
+                               int begin, int end) {
+  uint64 fp = Fingerprinter::Hash(end - begin);
+  for (int t = begin; t < end; ++t) {
+    fp = Fingerprinter::Hash(document.token(t).text(), fp);
+    DocumentFeatures::Quote quote = features.quote(t);
+    if (quote != DocumentFeatures::NO_QUOTE) {
+      fp = Fingerprinter::Hash(quote, fp);
+    }
+  }
+  return fp;
+}
+
+bool ParseCache::Lookup(uint64 key, std::vector<int> *actions) {
+  std::unique_lock<std::mutex> lock(mu_);
+  auto f = index_.find(key);
+  if (f == index_.end()) {
+    stats_.misses++;
+    return false;
+  }
+
+  // Move entry to the front of the LRU list.
+  entries_.splice(entries_.begin(), entries_, f->second);
+  *actions = f->second->actions;
+  stats_.hits++;
+  return true;
+}
+
+void ParseCache::Insert(uint64 key, const std::vector<int> &actions) {
+  std::unique_lock<std::mutex> lock(mu_);
+
+  // The sentence might have been added by another thread after the lookup.
+  auto f = index_.find(key);
+  if (f != index_.end()) {
+    entries_.splice(entries_.begin(), entries_, f->second);
+    return;
+  }
+
+  // Evict least recently used sentence if cache is full.
+  if (entries_.size() >= capacity_) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+    stats_.evictions++;
+  }
+
+  // Add sentence to the front of the LRU list.
+  entries_.push_front({key, actions});
+  index_[key] = entries_.begin();
+  stats_.insertions++;
+}
+
+void ParseCache::Clear() {
+  std::unique_lock<std::mutex> lock(mu_);
+  entries_.clear();
+  index_.clear();
+}
+
+ParseCache::Stats ParseCache::stats() const {
+  std::unique_lock<std::mutex> lock(mu_);
+  Stats stats = stats_;
+  stats.size = entries_.size();
+  return stats;
+}
+
+string ParseCache::Report() const {
+  Stats s = stats();
+  return StringPrintf("parse cache: %lld hits, %lld misses, %.1f%% hit rate, "
+                      "%lld sentences, %lld evictions",
+                      static_cast<long long>(s.hits),
+                      static_cast<long long>(s.misses),
+                      s.hit_rate() * 100.0,
+                      static_cast<long long>(s.size),
+                      static_cast<long long>(s.evictions));
+}
+
+}  // namespace nlp
+}  // namespace sling
@@ -0,0 +1,111 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_NLP_PARSER_PARSE_CACHE_H_
+#define SLING_NLP_PARSER_PARSE_CACHE_H_
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sling/base/types.h"
+#include "sling/nlp/document/document.h"
+#include "sling/nlp/document/features.h"
+
+namespace sling {
+namespace nlp {
+
+// Bounded LRU cache with the parser actions for sentences. The cache is keyed
+// by a fingerprint of the token texts and quotes in the sentence, so repeated
+// sentences can be parsed by replaying the cached actions without running the
+// parser network. The cache is thread-safe.
+class ParseCache {
+ public:
+  // Cache statistics.
+  struct Stats {
+    int64 hits = 0;            // number of lookups found in cache
+    int64 misses = 0;          // number of lookups not found in cache
+    int64 insertions = 0;      // number of sentences added to cache
+    int64 evictions = 0;       // number of sentences evicted from cache
+    int64 size = 0;            // number of sentences in cache
+
+    // Fraction of lookups found in cache.
+    double hit_rate() const {
+      int64 lookups = hits + misses;
+      return lookups > 0 ? static_cast<double>(hits) / lookups : 0.0;
+    }
+  };
+
+  // Initialize cache with a maximum number of sentences.
+  explicit ParseCache(int capacity);
+
+  // Compute cache key for sentence. The key is computed from the exact token
+  // texts and not the normalized token fingerprints, because the lexical
+  // features, e.g. capitalization and punctuation, depend on the exact text.
+  // Ambiguous quotes are resolved to open or close quotes depending on the
+  // quotes earlier in the document, so the resolved quote features for the
+  // sentence are also part of the key.
+  static uint64 Fingerprint(const Document &document,
+                            const DocumentFeatures &features,
+                            int begin, int end);
+
+  // Look up actions for sentence. Returns false if the sentence is not in the
+  // cache.
+  bool Lookup(uint64 key, std::vector<int> *actions);
+
+  // Add actions for sentence to the cache, evicting the least recently used
+  // sentence if the cache is full.
+  void Insert(uint64 key, const std::vector<int> &actions);
+
+  // Remove all sentences from the cache. The statistics are kept.
+  void Clear();
+
+  // Return cache statistics.
+  Stats stats() const;
+
+  // Return report with cache statistics.
+  string Report() const;
+
+  // Maximum number of sentences in cache.
+  int capacity() const { return capacity_; }
+
+ private:
+  // Cached sentence.
+  struct Entry {
+    uint64 key;                // sentence fingerprint
+    std::vector<int> actions;  // parser actions for sentence
+  };
+
+  // Maximum number of sentences in cache.
+  int capacity_;
+
+  // Cached sentences in most recently used order.
+  std::list<Entry> entries_;
+
+  // Mapping from sentence fingerprint to entry.
+  std::unordered_map<uint64, std::list<Entry>::iterator> index_;
+
+  // Cache statistics.
+  Stats stats_;
+
+  // Mutex for protecting cache.
+  mutable std::mutex mu_;
+};
+
+}  // namespace nlp
+}  // namespace sling
+
+#endif  // SLING_NLP_PARSER_PARSE_CACHE_H_
@@ -0,0 +1,331 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/nlp/parser/parse-pipeline.h"
+
+#include <thread>
+
+#include "sling/base/clock.h"
+#include "sling/base/logging.h"
+#include "sling/file/file.h"
+#include "sling/file/recordio.h"
+#include "sling/frame/serialization.h"
+#include "sling/string/printf.h"
+
+namespace sling {
+namespace nlp {
+
+ParsePipeline::ParsePipeline(const Parser *parser, Store *commons,
+                             const Options &options)
+    : parser_(parser), commons_(commons), options_(options) {
+  CHECK(commons->frozen()) << "Commons store must be frozen";
+  CHECK_GT(options.decoders, 0);
+  CHECK_GT(options.parsers, 0);
+  CHECK_GT(options.encoders, 0);
+  CHECK_GT(options.queue_size, 0);
+  CHECK_GT(options.max_in_flight, 0);
+}
+
+Status ParsePipeline::Run(const std::vector<string> &inputs,
+                          const string &output) {
+  // Reset statistics.
+  read_ = StageStats();
+  read_.name = "read";
+  read_.workers = 1;
+  decode_ = StageStats();
+  decode_.name = "decode";
+  decode_.workers = options_.decoders;
+  parse_ = StageStats();
+  parse_.name = "parse";
+  parse_.workers = options_.parsers;
+  encode_ = StageStats();
+  encode_.name = "encode";
+  encode_.workers = options_.encoders;
+  write_ = StageStats();
+  write_.name = "write";
+  write_.workers = 1;
+  status_ = Status::OK;
+  retired_ = 0;
+
+  // Open output file.
+  File *file;
+  Status st = File::Open(output, "w", &file);
+  if (!st.ok()) return st;
+  RecordWriter writer(file);
+
+  // Set up queues between stages.
+  int size = options_.queue_size;
+  Queue read_queue(size, 1);
+  Queue decode_queue(size, options_.decoders);
+  Queue parse_queue(size, options_.parsers);
+  Queue encode_queue(size, options_.encoders);
+
+  // Start workers for all stages.
+  Clock clock;
+  clock.start();
+  std::vector<std::thread> threads;
+  threads.emplace_back([&]() { Read(inputs, &read_queue); });
+
+  for (int i = 0; i < options_.decoders; ++i) {
+    threads.emplace_back([&]() {
+      Process(&decode_, &read_queue, &decode_queue, [this](Item *item) {
+        // Decode document or create a new document from text.
+        item->store = new Store(commons_);
+        if (options_.text) {
+          item->document = new Document(item->store);
+          tokenizer_.Tokenize(item->document, item->value);
+        } else {
+          Frame top = Decode(item->store, item->value).AsFrame();
+          item->document = new Document(top);
+          if (item->document->num_tokens() == 0) {
+            tokenizer_.Tokenize(item->document);
+          }
+        }
+        item->value.clear();
+      });
+    });
+  }
+
+  for (int i = 0; i < options_.parsers; ++i) {
+    threads.emplace_back([&]() {
+      // Each parser thread reuses its own parser instance for all documents.
+      ParserInstance instance(parser_);
+      Process(&parse_, &decode_queue, &parse_queue, [&](Item *item) {
+        item->document->ClearAnnotations();
+        parser_->Parse(item->document, &instance);
+      });
+    });
+  }
+
+  for (int i = 0; i < options_.encoders; ++i) {
+    threads.emplace_back([&]() {
+      Process(&encode_, &parse_queue, &encode_queue, [](Item *item) {
+        // Encode document and release the local store.
+        item->document->Update();
+        item->value = Encode(item->document->top());
+        delete item->document;
+        item->document = nullptr;
+        delete item->store;
+        item->store = nullptr;
+      });
+    });
+  }
+
+  threads.emplace_back([&]() { Write(&encode_queue, &writer); });
+
+  // Wait until all stages are done.
+  for (auto &t : threads) t.join();
+  clock.stop();
+  time_ = clock.secs();
+
+  st = writer.Close();
+  if (!st.ok()) Error(st);
+  std::unique_lock<std::mutex> lock(mu_);
+  return status_;
+}
+
+void ParsePipeline::Process(StageStats *stage, Queue *input, Queue *output,
+                            const std::function<void(Item *item)> &process) {
+  StageStats worker;
+  double hz = Clock::hz();
+  for (;;) {
+    // Get next item from input queue.
+    Clock::Timestamp start = Clock::now();
+    Item *item;
+    bool more = input->Get(&item);
+    Clock::Timestamp ready = Clock::now();
+    worker.starved += (ready - start) / hz;
+    if (!more) break;
+
+    // Process item.
+    process(item);
+    Clock::Timestamp done = Clock::now();
+    worker.busy += (done - ready) / hz;
+    worker.items++;
+
+    // Put item on output queue.
+    output->Put(item);
+    worker.blocked += (Clock::now() - done) / hz;
+  }
+  output->Close();
+  AddStats(stage, worker);
+}
+
+void ParsePipeline::Read(const std::vector<string> &inputs, Queue *output) {
+  StageStats worker;
+  double hz = Clock::hz();
+  int64 sequence = 0;
+  bool done = false;
+  for (const string &filename : inputs) {
+    File *file;
+    Status st = File::Open(filename, "r", &file);
+    if (!st.ok()) {
+      Error(st);
+      break;
+    }
+    RecordReader reader(file);
+    while (!done && !reader.Done()) {
+      // Wait until there is room for another item in the pipeline, so the
+      // writer does not have to hold back an unbounded number of items.
+      Clock::Timestamp start = Clock::now();
+      if (!WaitForSlot(sequence)) {
+        done = true;
+        break;
+      }
+      Clock::Timestamp ready = Clock::now();
+      worker.blocked += (ready - start) / hz;
+
+      // Read next record.
+      Record record;
+      st = reader.Read(&record);
+      if (!st.ok()) {
+        Error(st);
+        done = true;
+        break;
+      }
+      Item *item = new Item();
+      item->sequence = sequence++;
+      item->key = record.key.str();
+      item->value = record.value.str();
+      Clock::Timestamp read = Clock::now();
+      worker.busy += (read - ready) / hz;
+      worker.items++;
+
+      // Put item on output queue.
+      output->Put(item);
+      worker.blocked += (Clock::now() - read) / hz;
+    }
+    if (done) break;
+  }
+  output->Close();
+  AddStats(&read_, worker);
+}
+
+void ParsePipeline::Write(Queue *input, RecordWriter *writer) {
+  StageStats worker;
+  double hz = Clock::hz();
+
+  // Items arrive out of order from the encoders, so items are held back
+  // until all the items before them have been written. The reader keeps the
+  // number of items in flight bounded, so this is bounded too. After a write
+  // error, the remaining items are drained from the queue and discarded, so
+  // the other stages can finish.
+  std::map<int64, Item *> pending;
+  int64 next = 0;
+  bool failed = false;
+  for (;;) {
+    // Get next item from input queue.
+    Clock::Timestamp start = Clock::now();
+    Item *item;
+    bool more = input->Get(&item);
+    Clock::Timestamp ready = Clock::now();
+    worker.starved += (ready - start) / hz;
+    if (!more) break;
+    if (failed) {
+      delete item;
+      Retire();
+      continue;
+    }
+    pending[item->sequence] = item;
+
+    // Write all items that are next in order.
+    while (!pending.empty() && pending.begin()->first == next) {
+      Item *item = pending.begin()->second;
+      pending.erase(pending.begin());
+      Status st = writer->Write(item->key, item->value);
+      delete item;
+      Retire();
+      if (!st.ok()) {
+        Error(st);
+        failed = true;
+        break;
+      }
+      worker.items++;
+      next++;
+    }
+    worker.busy += (Clock::now() - ready) / hz;
+
+    // Discard the items held back after a write error.
+    if (failed) {
+      for (auto &it : pending) {
+        delete it.second;
+        Retire();
+      }
+      pending.clear();
+    }
+  }
+  CHECK(pending.empty());
+  AddStats(&write_, worker);
+}
+
+bool ParsePipeline::WaitForSlot(int64 sequence) {
+  std::unique_lock<std::mutex> lock(mu_);
+  retired_cv_.wait(lock, [this, sequence]() {
+    return !status_.ok() || sequence - retired_ < options_.max_in_flight;
+  });
+  return status_.ok();
+}
+
+void ParsePipeline::Retire() {
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    retired_++;
+  }
+  retired_cv_.notify_all();
+}
+
+void ParsePipeline::AddStats(StageStats *stage, const StageStats &worker) {
+  std::unique_lock<std::mutex> lock(mu_);
+  stage->items += worker.items;
+  stage->busy += worker.busy;
+  stage->starved += worker.starved;
+  stage->blocked += worker.blocked;
+}
+
+void ParsePipeline::Error(const Status &status) {
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    LOG(ERROR) << "Parse pipeline error: " << status;
+    if (status_.ok()) status_ = status;
+  }
+  retired_cv_.notify_all();
+}
+
+std::vector<ParsePipeline::StageStats> ParsePipeline::stats() const {
+  std::unique_lock<std::mutex> lock(mu_);
+  return {read_, decode_, parse_, encode_, write_};
+}
+
+string ParsePipeline::Report() const {
+  std::vector<StageStats> stages = stats();
+  double time = time_ > 0 ? time_ : 1.0;
+  string report;
+  StringAppendF(&report, "%-8s %8s %10s %10s %8s %8s %8s\n",
+                "stage", "workers", "docs", "docs/s",
+                "busy%", "starved%", "blocked%");
+  for (const StageStats &s : stages) {
+    // Utilization is relative to the total worker time for the stage.
+    double capacity = time * s.workers;
+    StringAppendF(&report, "%-8s %8d %10lld %10.1f %8.1f %8.1f %8.1f\n",
+                  s.name.c_str(), s.workers,
+                  static_cast<long long>(s.items), s.items / time,
+                  s.busy / capacity * 100.0,
+                  s.starved / capacity * 100.0,
+                  s.blocked / capacity * 100.0);
+  }
+  return report;
+}
+
+}  // namespace nlp
+}  // namespace sling
@@ -0,0 +1,169 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_NLP_PARSER_PARSE_PIPELINE_H_
+#define SLING_NLP_PARSER_PARSE_PIPELINE_H_
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sling/base/status.h"
+#include "sling/base/types.h"
+#include "sling/file/recordio.h"
+#include "sling/frame/store.h"
+#include "sling/nlp/document/document.h"
+#include "sling/nlp/document/document-tokenizer.h"
+#include "sling/nlp/parser/parser.h"
+#include "sling/util/thread.h"
+
+namespace sling {
+namespace nlp {
+
+// Streaming pipeline for parsing documents in record files. The pipeline has
+// the following stages:
+//   read:   read records from the input files.
+//   decode: decode documents in local stores and tokenize them if needed.
+//   parse:  parse documents.
+//   encode: encode parsed documents.
+//   write:  write encoded documents to the output file.
+// The decode, parse, and encode stages each have their own pool of worker
+// threads. The stages are connected by bounded queues, and the reader does not
+// get more than a maximum number of documents ahead of the writer, so the
+// memory used by documents in flight is limited. The documents are written in
+// the same order as they are read. The statistics for each stage show the
+// fraction of time its workers are busy, starved for input, or blocked on
+// output, which shows where the bottleneck is.
+class ParsePipeline {
+ public:
+  // Pipeline options.
+  struct Options {
+    int decoders = 1;          // number of decoder threads
+    int parsers = 1;           // number of parser threads
+    int encoders = 1;          // number of encoder threads
+    int queue_size = 1024;     // maximum number of documents in each queue
+    int max_in_flight = 8192;  // maximum number of documents in the pipeline
+    bool text = false;         // input records contain plain text
+  };
+
+  // Statistics for pipeline stage.
+  struct StageStats {
+    string name;               // stage name
+    int workers = 0;           // number of worker threads
+    int64 items = 0;           // number of documents processed
+    double busy = 0.0;         // time spent processing documents in seconds
+    double starved = 0.0;      // time spent waiting for input in seconds
+    double blocked = 0.0;      // time spent waiting for output in seconds
+  };
+
+  // Initialize pipeline for parser. The commons store must be frozen.
+  ParsePipeline(const Parser *parser, Store *commons, const Options &options);
+
+  // Parse documents in input record files and write them to the output record
+  // file. Returns the first error encountered.
+  Status Run(const std::vector<string> &inputs, const string &output);
+
+  // Return statistics for all stages.
+  std::vector<StageStats> stats() const;
+
+  // Return report with throughput and utilization for each stage.
+  string Report() const;
+
+ private:
+  // Document flowing through the pipeline.
+  struct Item {
+    ~Item() {
+      delete document;
+      delete store;
+    }
+
+    int64 sequence;                 // position in input
+    string key;                     // record key
+    string value;                   // encoded document or text
+    Store *store = nullptr;         // local store for document
+    Document *document = nullptr;   // decoded document
+  };
+
+  // Bounded queue of documents between two stages. The queue is closed when
+  // all the producers are done.
+  typedef BoundedQueue<Item *> Queue;
+
+  // Process items from input queue and put them on the output queue until
+  // the input queue is closed. The output queue is closed when done.
+  void Process(StageStats *stage, Queue *input, Queue *output,
+               const std::function<void(Item *item)> &process);
+
+  // Read records from input files and put them on the output queue.
+  void Read(const std::vector<string> &inputs, Queue *output);
+
+  // Write items from input queue to output file in input order. After a
+  // write error, the remaining items are discarded.
+  void Write(Queue *input, RecordWriter *writer);
+
+  // Wait until the item with a sequence number can enter the pipeline without
+  // exceeding the maximum number of items in flight. Returns false if the
+  // pipeline has failed.
+  bool WaitForSlot(int64 sequence);
+
+  // Signal that an item has left the pipeline.
+  void Retire();
+
+  // Add statistics for worker to stage.
+  void AddStats(StageStats *stage, const StageStats &worker);
+
+  // Record error. Only the first error is kept.
+  void Error(const Status &status);
+
+  // Parser model.
+  const Parser *parser_;
+
+  // Commons store for local document stores.
+  Store *commons_;
+
+  // Pipeline options.
+  Options options_;
+
+  // Tokenizer for documents without tokens.
+  DocumentTokenizer tokenizer_;
+
+  // Statistics for each stage.
+  StageStats read_;
+  StageStats decode_;
+  StageStats parse_;
+  StageStats encode_;
+  StageStats write_;
+
+  // Wall time for the last run in seconds.
+  double time_ = 0.0;
+
+  // First error encountered.
+  Status status_;
+
+  // Number of items that have left the pipeline.
+  int64 retired_ = 0;
+
+  // Mutex for protecting statistics, status, and retired items.
+  mutable std::mutex mu_;
+
+  // Signaled when an item leaves the pipeline or an error is recorded.
+  std::condition_variable retired_cv_;
+};
+
+}  // namespace nlp
+}  // namespace sling
+
+#endif  // SLING_NLP_PARSER_PARSE_PIPELINE_H_
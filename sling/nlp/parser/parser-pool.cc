@@ -0,0 +1,186 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/nlp/parser/parser-pool.h"
+
+#include "sling/base/logging.h"
+#include "sling/string/printf.h"
+#include "sling/util/thread.h"
+
+namespace sling {
+namespace nlp {
+
+ParserPool::ParserPool(const Parser *parser, int workers, int queue_size)
+    : parser_(parser), num_workers_(workers), queue_(queue_size) {
+  CHECK_GT(workers, 0);
+  stats_.resize(workers);
+}
+
+ParserPool::~ParserPool() {
+  Stop();
+}
+
+void ParserPool::Start() {
+  CHECK(workers_.empty()) << "Parser pool already started";
+  if (parser_->profile() != nullptr) {
+    for (int i = 0; i < num_workers_; ++i) {
+      profiles_.push_back(new Parser::Profile(parser_));
+    }
+  }
+  started_ = Clock::now();
+  for (int i = 0; i < num_workers_; ++i) {
+    workers_.emplace_back([this, i]() { Worker(i); });
+  }
+}
+
+void ParserPool::Parse(Document *document, Callback done) {
+  // Queuing a request after the pool has been stopped fails, since the queue
+  // has been closed.
+  queue_.Put({document, std::move(done), Clock::now()});
+}
+
+void ParserPool::ParseAndWait(Document *document) {
+  Barrier done(1);
+  Parse(document, [&done](Document *parsed) { done.Done(); });
+  done.Wait();
+}
+
+void ParserPool::Stop() {
+  if (stopped_) return;
+  stopped_ = true;
+  queue_.Close();
+  for (auto &t : workers_) t.join();
+  workers_.clear();
+  finished_ = Clock::now();
+
+  // Add worker profiles to the parser profile.
+  for (Parser::Profile *profile : profiles_) {
+    parser_->profile()->Add(*profile);
+    delete profile;
+  }
+  profiles_.clear();
+}
+
+void ParserPool::Worker(int index) {
+  // Parser instance reused for all documents parsed by this worker.
+  ParserInstance instance(parser_);
+  if (!profiles_.empty()) instance.set_profile(profiles_[index]);
+  std::vector<Parser::Degradation> degradation;
+  double hz = Clock::hz();
+
+  for (;;) {
+    // Get next request from queue.
+    Request request;
+    if (!queue_.Get(&request)) return;
+
+    // Parse document.
+    Clock::Timestamp start = Clock::now();
+    Document *document = request.document;
+    degradation.clear();
+    if (budget_ > 0) {
+      Parser::Deadline deadline =
+          Parser::Deadline::Budget(request.queued, budget_, fallback_);
+      parser_->Parse(document, &instance, deadline, &degradation);
+    } else {
+      parser_->Parse(document, &instance);
+    }
+    Clock::Timestamp end = Clock::now();
+
+    // Update statistics.
+    int sentences = 0;
+    for (SentenceIterator s(document); s.more(); s.next()) sentences++;
+    int fallback = 0;
+    int shifted = 0;
+    for (Parser::Degradation level : degradation) {
+      if (level == Parser::FALLBACK) fallback++;
+      if (level == Parser::SHIFT_ONLY) shifted++;
+    }
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      WorkerStats &stats = stats_[index];
+      double queued = (start - request.queued) / hz;
+      stats.documents++;
+      stats.sentences += sentences;
+      stats.tokens += document->num_tokens();
+      stats.busy += (end - start) / hz;
+      stats.queued += queued;
+      if (queued > stats.max_queued) stats.max_queued = queued;
+      stats.fallback += fallback;
+      stats.shifted += shifted;
+      if (fallback + shifted > 0) stats.degraded++;
+    }
+
+    // Notify caller.
+    if (request.done) request.done(document);
+  }
+}
+
+std::vector<ParserPool::WorkerStats> ParserPool::stats() const {
+  std::unique_lock<std::mutex> lock(mu_);
+  return stats_;
+}
+
+string ParserPool::Report() const {
+  std::vector<WorkerStats> workers = stats();
+  string report;
+  StringAppendF(&report, "%-6s %10s %10s %12s %12s %12s %12s %10s %10s\n",
+                "worker", "docs", "tokens", "docs/s", "tokens/s",
+                "avg queue ms", "max queue ms", "fallback", "shifted");
+  WorkerStats total;
+  for (int i = 0; i < workers.size(); ++i) {
+    const WorkerStats &w = workers[i];
+    double busy = w.busy > 0 ? w.busy : 1.0;
+    double docs = w.documents > 0 ? w.documents : 1.0;
+    StringAppendF(&report,
+                  "%-6d %10lld %10lld %12.1f %12.1f %12.3f %12.3f "
+                  "%10lld %10lld\n",
+                  i, static_cast<long long>(w.documents),
+                  static_cast<long long>(w.tokens),
+                  w.documents / busy, w.tokens / busy,
+                  w.queued / docs * 1000.0, w.max_queued * 1000.0,
+                  static_cast<long long>(w.fallback),
+                  static_cast<long long>(w.shifted));
+    total.documents += w.documents;
+    total.tokens += w.tokens;
+    total.busy += w.busy;
+    total.queued += w.queued;
+    if (w.max_queued > total.max_queued) total.max_queued = w.max_queued;
+    total.fallback += w.fallback;
+    total.shifted += w.shifted;
+    total.degraded += w.degraded;
+  }
+  Clock::Timestamp finished = finished_ != 0 ? finished_ : Clock::now();
+  double wall = started_ != 0 ? (finished - started_) / Clock::hz() : 0.0;
+  if (wall <= 0) wall = 1.0;
+  double docs = total.documents > 0 ? total.documents : 1.0;
+  StringAppendF(&report,
+                "%-6s %10lld %10lld %12.1f %12.1f %12.3f %12.3f "
+                "%10lld %10lld\n",
+                "total", static_cast<long long>(total.documents),
+                static_cast<long long>(total.tokens),
+                total.documents / wall, total.tokens / wall,
+                total.queued / docs * 1000.0, total.max_queued * 1000.0,
+                static_cast<long long>(total.fallback),
+                static_cast<long long>(total.shifted));
+  if (total.degraded > 0) {
+    StringAppendF(&report, "%lld documents degraded (%.2f%%)\n",
+                  static_cast<long long>(total.degraded),
+                  total.degraded / docs * 100.0);
+  }
+  return report;
+}
+
+}  // namespace nlp
+}  // namespace sling
+
@@ -0,0 +1,151 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_NLP_PARSER_PARSER_POOL_H_
+#define SLING_NLP_PARSER_PARSER_POOL_H_
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/types.h"
+#include "sling/nlp/document/document.h"
+#include "sling/nlp/parser/parser.h"
+#include "sling/util/thread.h"
+
+namespace sling {
+namespace nlp {
+
+// Pool of worker threads for parsing documents with a shared parser model.
+// Each worker keeps its own parser instance that is reused for all the
+// documents it parses. Requests are put in a bounded queue, so callers block
+// when the workers cannot keep up. The documents parsed concurrently must be
+// in separate local stores, and the global store for the parser must be
+// frozen.
+class ParserPool {
+ public:
+  // Callback for parsed document. This is called from the worker thread.
+  typedef std::function<void(Document *document)> Callback;
+
+  // Statistics for worker.
+  struct WorkerStats {
+    int64 documents = 0;       // number of documents parsed
+    int64 sentences = 0;       // number of sentences parsed
+    int64 tokens = 0;          // number of tokens parsed
+    double busy = 0.0;         // time spent parsing in seconds
+    double queued = 0.0;       // total queue latency for requests in seconds
+    double max_queued = 0.0;   // maximum queue latency in seconds
+    int64 fallback = 0;        // sentences degraded to fast fallback
+    int64 shifted = 0;         // sentences degraded to shift-only
+    int64 degraded = 0;        // documents with degraded sentences
+  };
+
+  // Initialize pool with a number of workers and a maximum number of queued
+  // requests.
+  ParserPool(const Parser *parser, int workers, int queue_size);
+
+  // Stop workers.
+  ~ParserPool();
+
+  // Set latency budget in milliseconds for each request, measured from the
+  // time the request is queued. The parser degrades gracefully when the
+  // budget is running out, starting when the 'fallback' fraction of the
+  // budget has been used. See Parser::Deadline. Must be called before
+  // Start().
+  void set_budget(double ms, double fallback = 0.5) {
+    budget_ = ms;
+    fallback_ = fallback;
+  }
+
+  // Start worker threads.
+  void Start();
+
+  // Queue document for parsing. This blocks if the queue is full. The
+  // callback is called when the document has been parsed.
+  void Parse(Document *document, Callback done);
+
+  // Parse document in a worker and wait until it has been parsed.
+  void ParseAndWait(Document *document);
+
+  // Wait until all queued documents have been parsed and stop the workers.
+  // The profiling data collected by the workers is added to the profile for
+  // the parser.
+  void Stop();
+
+  // Return statistics for all workers.
+  std::vector<WorkerStats> stats() const;
+
+  // Return report with throughput and queue latency for each worker. The
+  // throughput for each worker is computed from the time it has been busy
+  // parsing, and the total throughput from the time since the pool was
+  // started until it was stopped.
+  string Report() const;
+
+ private:
+  // Parse request.
+  struct Request {
+    Document *document;        // document to parse
+    Callback done;             // callback for parsed document
+    Clock::Timestamp queued;   // time when request was queued
+  };
+
+  // Worker thread loop.
+  void Worker(int index);
+
+  // Parser model shared by all workers.
+  const Parser *parser_;
+
+  // Number of workers.
+  int num_workers_;
+
+  // Latency budget in milliseconds for each request or zero for no budget.
+  double budget_ = 0.0;
+
+  // Fraction of budget used before switching to fast fallback.
+  double fallback_ = 0.5;
+
+  // Worker threads.
+  std::vector<std::thread> workers_;
+
+  // Profile for each worker or empty if profiling is disabled. The profiles
+  // are added to the profile for the parser when the pool is stopped.
+  std::vector<Parser::Profile *> profiles_;
+
+  // Time when the pool was started and stopped.
+  Clock::Timestamp started_ = 0;
+  Clock::Timestamp finished_ = 0;
+
+  // Queued requests. The queue is closed when the pool is stopped, and the
+  // workers terminate after the queue has been drained.
+  BoundedQueue<Request> queue_;
+
+  // Set when the pool has been stopped. This is only used by Stop(), so the
+  // pool can be stopped more than once.
+  bool stopped_ = false;
+
+  // Statistics for each worker.
+  std::vector<WorkerStats> stats_;
+
+  // Mutex for protecting statistics.
+  mutable std::mutex mu_;
+};
+
+}  // namespace nlp
+}  // namespace sling
+
+#endif  // SLING_NLP_PARSER_PARSER_POOL_H_
+
@@ -29,7 +29,6 @@ ParserState::ParserState(Store *store, int begin, int end)
       end_(end),
       current_(begin),
       done_(false),
-      frames_(store),
       nesting_(begin) {}
 
 ParserState::ParserState(const ParserState &other)
@@ -38,13 +37,11 @@ ParserState::ParserState(const ParserState &other)
       end_(other.end_),
       current_(other.current_),
       done_(other.done_),
-      frames_(other.store_),
+      frames_(other.frames_),
       mentions_(other.mentions_),
       frame_to_mention_(other.frame_to_mention_),
       attention_(other.attention_),
-      nesting_(other.nesting_) {
-  frames_.assign(other.frames_.begin(), other.frames_.end());
-}
+      nesting_(other.nesting_) {}
 
 int ParserState::MaxEvokeLength(int max_length) const {
   if (current_ == end_) return 0;
@@ -108,20 +105,6 @@ void ParserState::Apply(const ParserAction &action) {
   }
 }
 
-// Returns if 'frame' has a 'role' slot whose value is 'value'.
-static bool SlotPresent(const Frame &frame, Handle role, Handle value) {
-  for (const auto &slot : frame) {
-    if (slot.name == role && slot.value == value) return true;
-  }
-
-  return false;
-}
-
-// Returns if 'frame' has a 'role' slot whose value is the index 'value'.
-static bool SlotPresent(const Frame &frame, Handle role, int value) {
-  return SlotPresent(frame, role, Handle::Index(value));
-}
-
 bool ParserState::CanApply(const ParserAction &action) const {
   switch (action.type) {
     case ParserAction::SHIFT:
@@ -194,8 +177,7 @@ bool ParserState::CanApply(const ParserAction &action) const {
       if (source >= attention_.size()) return false;
 
       // Check that we haven't output this assignment in the past.
-      Frame frame(store_, frames_[Attention(source)]);
-      return !SlotPresent(frame, action.role, action.label);
+      return !FrameHasSlot(Attention(source), action.role, action.label);
     }
 
     case ParserAction::CONNECT: {
@@ -209,8 +191,8 @@ bool ParserState::CanApply(const ParserAction &action) const {
       if (target >= attention_.size()) return false;
 
       // Check that we haven't output this connection before.
-      Frame frame(store_, frames_[Attention(source)]);
-      return !SlotPresent(frame, action.role, Attention(target));
+      Handle value = Handle::Index(Attention(target));
+      return !FrameHasSlot(Attention(source), action.role, value);
     }
 
     case ParserAction::EMBED: {
@@ -269,10 +251,9 @@ void ParserState::Stop() {
 
 void ParserState::Evoke(int length, Handle type) {
   // Create new frame.
-  Slot slot(Handle::isa(), type);
-  Handle h = store_->AllocateFrame(&slot, &slot + 1);
   int frame = frames_.size();
-  frames_.push_back(h);
+  frames_.emplace_back();
+  frames_.back().emplace_back(Handle::isa(), type);
 
   // Create new mention.
   int index = mentions_.size();
@@ -296,23 +277,20 @@ void ParserState::Refer(int length, int index) {
 }
 
 void ParserState::Connect(int source, Handle role, int target) {
-  // Create new frame with an additional role linking source to target. The role
-  // value is encoded as an index into the frame buffer. The new frame replaces
-  // the old frame in the frame buffer.
+  // Add role linking source to target. The role value is encoded as an index
+  // into the frame buffer.
   int source_index = Attention(source);
   int target_index = Attention(target);
-  Handle value = Handle::Index(target_index);
-  frames_[source_index] = store_->Extend(frames_[source_index], role, value);
+  frames_[source_index].emplace_back(role, Handle::Index(target_index));
 
   // Move the source frame to the center of attention.
   Center(source);
 }
 
 void ParserState::Assign(int frame, Handle role, Handle value) {
-  // Create new frame with an additional role. The new frame replaces the old
-  // frame in the frame buffer.
+  // Add role to frame.
   int index = Attention(frame);
-  frames_[index] = store_->Extend(frames_[index], role, value);
+  frames_[index].emplace_back(role, value);
 
   // Move the frame to the center of attention.
   Center(frame);
@@ -321,13 +299,10 @@ void ParserState::Assign(int frame, Handle role, Handle value) {
 void ParserState::Embed(int frame, Handle role, Handle type) {
   // Create new frame with the specified type and add link to target frame.
   int target = Attention(frame);
-  Slot slots[2];
-  slots[0].name = Handle::isa();
-  slots[0].value = type;
-  slots[1].name = role;
-  slots[1].value = Handle::Index(target);
   int index = frames_.size();
-  frames_.push_back(store_->AllocateFrame(slots, slots + 2));
+  frames_.emplace_back();
+  frames_.back().emplace_back(Handle::isa(), type);
+  frames_.back().emplace_back(role, Handle::Index(target));
   embed_.emplace_back(target, type);
 
   // Add new frame to the attention buffer.
@@ -338,13 +313,12 @@ void ParserState::Elaborate(int frame, Handle role, Handle type) {
   int source_index = Attention(frame);
 
   // Create new frame with the specified type.
-  Slot slot(Handle::isa(), type);
   int target_index = frames_.size();
-  frames_.push_back(store_->AllocateFrame(&slot, &slot + 1));
+  frames_.emplace_back();
+  frames_.back().emplace_back(Handle::isa(), type);
 
   // Add link to new frame from source frame.
-  Handle value = Handle::Index(target_index);
-  frames_[source_index] = store_->Extend(frames_[source_index], role, value);
+  frames_[source_index].emplace_back(role, Handle::Index(target_index));
   elaborate_.emplace_back(source_index, type);
 
   // Add new frame to the attention buffer.
@@ -374,41 +348,23 @@ int ParserState::AttentionIndex(int index, int k) const {
 }
 
 void ParserState::GetFrames(Handles *frames) {
-  // Allocate new frames for all the frames in the frame buffer.
+  // Allocate frames in the store for all the frames in the frame buffer. The
+  // index values still refer to positions in the frame buffer.
   frames->resize(frames_.size());
   for (int i = 0; i < frames_.size(); ++i) {
-    // If the frame has any slots with index values we need to clone it and
-    // update the indices to point to the final frames. Otherwise we can just
-    // return the existing frame from the frame buffer.
-    FrameDatum *frame = store_->GetFrame(frames_[i]);
-    bool has_indices = false;
-    for (Slot *slot = frame->begin(); slot < frame->end(); ++slot) {
-      if (slot->value.IsIndex()) {
-        has_indices = true;
-        break;
-      }
-    }
-
-    if (has_indices) {
-      (*frames)[i] = store_->AllocateFrame(frame->slots());
-    } else {
-      (*frames)[i] = frames_[i];
-    }
+    std::vector<Slot> &slots = frames_[i];
+    (*frames)[i] = store_->AllocateFrame(slots.data(),
+                                         slots.data() + slots.size());
   }
 
-  // Copy slots to the new frames translating indices to frame references.
+  // Translate indices to frame references. This is done after all the frames
+  // have been allocated, since allocation can move the frames in the store.
   for (int i = 0; i < frames_.size(); ++i) {
-    FrameDatum *source = store_->GetFrame(frames_[i]);
-    FrameDatum *target = store_->GetFrame((*frames)[i]);
-    if (target == source) continue;
-    Slot *s = source->begin();
-    Slot *end = source->end();
-    Slot *t = target->begin();
-    while (s < end) {
-      t->name = s->name;
-      t->value = s->value.IsIndex() ? (*frames)[s->value.AsIndex()] : s->value;
-      s++;
-      t++;
+    FrameDatum *frame = store_->GetFrame((*frames)[i]);
+    for (Slot *slot = frame->begin(); slot < frame->end(); ++slot) {
+      if (slot->value.IsIndex()) {
+        slot->value = (*frames)[slot->value.AsIndex()];
+      }
     }
   }
 }
@@ -437,7 +393,7 @@ void ParserState::AddParseToDocument(Document *document) {
 }
 
 Handle ParserState::type(int index) const {
-  return store_->GetFrame(frames_[Attention(index)])->get(Handle::isa());
+  return FrameType(Attention(index));
 }
 
 }  // namespace nlp
@@ -56,8 +56,14 @@ class ParserState {
   // - the end of any existing span that covers the current token.
   int MaxEvokeLength(int max_length) const;
 
-  // Returns frame in frame buffer.
-  Handle frame(int index) const { return frames_[index]; }
+  // Returns the slots for frame in frame buffer. References between frames
+  // are encoded using index handles (@n) into the frame buffer.
+  const std::vector<Slot> &FrameSlots(int index) const {
+    return frames_[index];
+  }
+
+  // Returns the number of frames in the frame buffer.
+  int NumFrames() const { return frames_.size(); }
 
   // Returns the first type for a frame in the attention buffer. This will be
   // the type specified when the frame was created with EVOKE/EMBED/ELABORATE.
@@ -73,7 +79,8 @@ class ParserState {
   // limited to the top-k frames that are closest to the center of attention.
   int AttentionIndex(int index, int k = -1) const;
 
-  // Creates final set of frames that the parse has generated.
+  // Creates final set of frames that the parse has generated. The frames are
+  // only allocated in the store when this is called.
   void GetFrames(Handles *frames);
 
   // Adds frames and mentions that the parse has generated to the document.
@@ -130,9 +137,27 @@ class ParserState {
   void Embed(int frame, Handle role, Handle type);
   void Elaborate(int frame, Handle role, Handle type);
 
+  // Returns the type of the frame at the given absolute index, i.e. the value
+  // of the first isa slot.
+  Handle FrameType(int index) const {
+    for (const Slot &slot : frames_[index]) {
+      if (slot.name == Handle::isa()) return slot.value;
+    }
+    return Handle::nil();
+  }
+
   // Returns true if the frame at the given absolute index has the given type.
   bool FrameHasType(int index, Handle type) const {
-    return Frame(store_, frame(index)).GetHandle(Handle::isa()) == type;
+    return FrameType(index) == type;
+  }
+
+  // Returns true if the frame at the given absolute index has a slot with the
+  // given role and value.
+  bool FrameHasSlot(int index, Handle role, Handle value) const {
+    for (const Slot &slot : frames_[index]) {
+      if (slot.name == role && slot.value == value) return true;
+    }
+    return false;
   }
 
   // Adds frame to attention buffer. The frame will become the new center of
@@ -221,10 +246,12 @@ class ParserState {
   // When we have performed the first STOP action, the parse is done.
   bool done_;
 
-  // List of all evoked frames. References between frames are encoded using
-  // index handles (@n) into this array. Frames are modified using copy-on-write
-  // so it is safe to copy the handles when cloning a parse state.
-  Handles frames_;
+  // List of all evoked frames. Each frame is represented by its slots, and
+  // references between frames are encoded using index handles (@n) into this
+  // array. The frames are kept outside the store while parsing, so the
+  // transitions do not allocate objects in the store, and the frames are only
+  // materialized in the store when the parse is added to the document.
+  std::vector<std::vector<Slot>> frames_;
 
   // List of mentions evoking frames.
   std::vector<Mention> mentions_;
@@ -13,6 +13,10 @@
 // limitations under the License.
 
 #include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
 
 #include "sling/nlp/parser/parser.h"
 
@@ -43,6 +47,37 @@ void Parser::EnableGPU() {
   }
 }
 
+Parser::~Parser() {
+  delete sentence_workers_;
+  for (ParserInstance *instance : idle_instances_) delete instance;
+  delete profile_;
+  delete lstm_workers_;
+  delete cache_;
+  delete feature_cache_;
+}
+
+void Parser::EnableConcurrentLSTM(int workers) {
+  if (lstm_workers_ != nullptr) return;
+  lstm_workers_ = new ThreadPool(workers);
+  lstm_workers_->Start();
+}
+
+void Parser::EnableParallelSentences(int workers) {
+  if (sentence_workers_ != nullptr) return;
+  sentence_workers_ = new ThreadPool(workers);
+  sentence_workers_->Start();
+}
+
+void Parser::EnableCache(int size) {
+  if (cache_ != nullptr) return;
+  cache_ = new ParseCache(size);
+}
+
+void Parser::EnableFeatureCache(int size) {
+  if (feature_cache_ != nullptr) return;
+  feature_cache_ = new FeatureCache(size);
+}
+
 void Parser::Load(Store *store, const string &model) {
   // Register kernels for implementing parser ops.
   RegisterTensorflowLibrary(&library_);
@@ -61,6 +96,13 @@ void Parser::Load(Store *store, const string &model) {
     flow.AddOperation(ff, "ff/ArgMax", "ArgMax", {output}, {prediction});
   }
 
+  // Split input projections out of the LSTM cells, so these can be computed
+  // for the whole sentence before running the recurrences.
+  if (split_lstm_inputs_ && !use_gpu_) {
+    SplitInputProjection(&flow, "lr_lstm", input_batch_);
+    SplitInputProjection(&flow, "rl_lstm", input_batch_);
+  }
+
   // Analyze parser flow file.
   flow.Analyze(library_);
 
@@ -113,6 +155,7 @@ void Parser::Load(Store *store, const string &model) {
   num_actions_ = actions_.NumActions();
   CHECK_GT(num_actions_, 0);
   roles_.Init(actions_);
+  action_mask_.Init(actions_);
 }
 
 void Parser::InitLSTM(const string &name, LSTM *lstm, bool reverse) {
@@ -137,10 +180,10 @@ void Parser::InitLSTM(const string &name, LSTM *lstm, bool reverse) {
 
   // Get feature sizes.
   if (lstm->prefix_feature != nullptr) {
-    lstm->prefix_size = lstm->prefix_feature->elements();
+    lstm->prefix_size = lstm->prefix_feature->dim(1);
   }
   if (lstm->suffix_feature != nullptr) {
-    lstm->suffix_size = lstm->suffix_feature->elements();
+    lstm->suffix_size = lstm->suffix_feature->dim(1);
   }
 
   // Get links.
@@ -148,6 +191,149 @@ void Parser::InitLSTM(const string &name, LSTM *lstm, bool reverse) {
   lstm->c_out = GetParam(name + "/c_out");
   lstm->h_in = GetParam(name + "/h_in");
   lstm->h_out = GetParam(name + "/h_out");
+
+  // Get input projection cell and connectors.
+  lstm->input = network_.GetCell(name + "/input");
+  if (lstm->input != nullptr) {
+    for (int k = 0;; ++k) {
+      string prefix = name + "/projection/" + std::to_string(k);
+      myelin::Connector *cnx = network_.GetConnector(prefix);
+      if (cnx == nullptr) break;
+      LSTM::Projection projection;
+      projection.cnx = cnx;
+      projection.out = GetParam(prefix + "/out");
+      projection.in = GetParam(prefix + "/in");
+      lstm->projections.push_back(projection);
+    }
+    if (!lstm->projections.empty()) {
+      lstm->batch = lstm->projections[0].out->dim(0);
+    }
+  }
+}
+
+bool Parser::SplitInputProjection(myelin::Flow *flow, const string &name,
+                                  int batch) {
+  typedef myelin::Flow::Variable Variable;
+  typedef myelin::Flow::Operation Operation;
+  myelin::Flow::Function *func = flow->Func(name);
+  if (func == nullptr) return false;
+
+  // Variables linked to connectors are recurrent inputs and outputs.
+  std::unordered_set<Variable *> linked;
+  for (auto *cnx : flow->cnxs()) {
+    for (auto *link : cnx->links) linked.insert(link);
+  }
+
+  // Find the ops that only depend on the input features, i.e. on constants
+  // and on variables that are neither references nor linked to connectors.
+  std::unordered_set<Operation *> inputs;
+  bool more = true;
+  while (more) {
+    more = false;
+    for (Operation *op : func->ops) {
+      if (inputs.count(op) > 0) continue;
+      bool movable = true;
+      for (Variable *var : op->inputs) {
+        if (var->constant()) continue;
+        if (var->ref || linked.count(var) > 0) {
+          movable = false;
+        } else if (var->producer != nullptr) {
+          if (inputs.count(var->producer) == 0) movable = false;
+        }
+        if (!movable) break;
+      }
+      for (Variable *var : op->outputs) {
+        if (var->ref || linked.count(var) > 0) movable = false;
+      }
+      if (movable) {
+        inputs.insert(op);
+        more = true;
+      }
+    }
+  }
+
+  // The features must only be used by the input projections.
+  for (Operation *op : func->ops) {
+    if (inputs.count(op) > 0) continue;
+    for (Variable *var : op->inputs) {
+      if (var->constant() || var->ref || linked.count(var) > 0) continue;
+      if (var->producer == nullptr) return false;
+    }
+  }
+
+  // Only split the LSTM if there are input matmuls to take out of the
+  // recurrence.
+  bool matmul = false;
+  for (Operation *op : inputs) {
+    if (op->type == "MatMul") matmul = true;
+  }
+  if (!matmul) return false;
+
+  // Find the variables passed from the input projections to the recurrence.
+  std::vector<Variable *> projections;
+  for (Operation *op : func->ops) {
+    if (inputs.count(op) == 0) continue;
+    for (Variable *var : op->outputs) {
+      for (Operation *consumer : var->consumers) {
+        if (inputs.count(consumer) == 0) {
+          projections.push_back(var);
+          break;
+        }
+      }
+    }
+  }
+  if (projections.empty()) return false;
+  for (Variable *var : projections) {
+    if (var->type == myelin::DT_INVALID || !var->shape.defined()) return false;
+  }
+
+  // Move input projection ops to separate function.
+  myelin::Flow::Function *input = flow->AddFunction(name + "/input");
+  std::vector<Operation *> recurrent;
+  for (Operation *op : func->ops) {
+    if (inputs.count(op) > 0) {
+      op->func = nullptr;
+      input->AddOperation(op);
+    } else {
+      recurrent.push_back(op);
+    }
+  }
+  func->ops.swap(recurrent);
+
+  // Pass the projections from the input function to the LSTM function through
+  // connectors. The input function outputs the projections for a batch of
+  // tokens, which are copied to the connector channels one token per element.
+  for (int k = 0; k < projections.size(); ++k) {
+    Variable *out = projections[k];
+    string prefix = name + "/projection/" + std::to_string(k);
+    out->AddAlias(out->name);
+    out->name = prefix + "/out";
+    Variable *in = flow->AddVariable(prefix + "/in", out->type, out->shape);
+    in->ref = true;
+    for (Operation *consumer : std::vector<Operation *>(out->consumers)) {
+      if (inputs.count(consumer) == 0) consumer->ReplaceInput(out, in);
+    }
+    auto *cnx = flow->AddConnector(prefix);
+    cnx->AddLink(in);
+  }
+
+  // Compute the input projections for a batch of tokens in each computation.
+  // The features and the intermediate results get a row per token, so the
+  // input matmuls become matrix-matrix multiplications. Shapes that are not
+  // known yet are inferred from the features when the flow is analyzed.
+  std::unordered_set<Variable *> rows;
+  for (Operation *op : input->ops) {
+    for (Variable *var : op->inputs) rows.insert(var);
+    for (Variable *var : op->outputs) rows.insert(var);
+  }
+  for (Variable *var : rows) {
+    if (var->constant() || var->rank() != 2) continue;
+    if (var->dim(0) == 1 || var->dim(0) == -1) var->shape.set(0, batch);
+  }
+
+  VLOG(3) << "Split " << projections.size() << " input projections out of "
+          << name;
+  return true;
 }
 
 void Parser::InitFF(const string &name, FF *ff) {
@@ -214,137 +400,209 @@ void Parser::InitFF(const string &name, FF *ff) {
 }
 
 void Parser::Parse(Document *document) const {
+  ParserInstance data(this);
+  Parse(document, &data);
+}
+
+Parser::Deadline Parser::Deadline::Budget(Clock::Timestamp start, double ms,
+                                          double fallback) {
+  double cycles = ms * Clock::mhz() * 1000.0;
+  Deadline deadline;
+  deadline.fallback = start + static_cast<Clock::Timestamp>(cycles * fallback);
+  deadline.stop = start + static_cast<Clock::Timestamp>(cycles);
+  return deadline;
+}
+
+void Parser::Parse(Document *document, ParserInstance *instance) const {
+  Parse(document, instance, Deadline::None(), nullptr);
+}
+
+void Parser::Parse(Document *document, ParserInstance *instance,
+                   const Deadline &deadline,
+                   std::vector<Degradation> *degradation) const {
   // Extract lexical features from document.
-  DocumentFeatures features(&lexicon_);
+  DocumentFeatures features(&lexicon_, feature_cache_);
   features.Extract(*document);
 
+  // Parse sentences in parallel if enabled.
+  if (sentence_workers_ != nullptr) {
+    ParseParallel(document, features, instance, deadline, degradation);
+    return;
+  }
+
   // Parse each sentence of the document.
   for (SentenceIterator s(document); s.more(); s.next()) {
-    // Initialize parser model instance data.
-    ParserInstance data(this, document, s.begin(), s.end());
-    ParserState &state = data.state_;
+    Degradation level = ParseSentence(document, s.begin(), s.end(), features,
+                                      instance, deadline, true);
+    if (degradation != nullptr) degradation->push_back(level);
 
-    // Compute left-to-right LSTM.
-    for (int i = 0; i < s.length(); ++i) {
-      // Attach hidden and control layers.
-      data.lr_.Clear();
-      int in = i > 0 ? i - 1 : s.length();
-      int out = i;
-      data.AttachLR(in, out);
-
-      // Extract features.
-      data.ExtractFeaturesLSTM(s.begin() + out, features, lr_, &data.lr_);
-
-      // Compute LSTM cell.
-      if (profile_) data.lr_.set_profile(&profile_->lr);
-      data.lr_.Compute();
+    // Add frames for sentence to the document.
+    instance->state_->AddParseToDocument(document);
+  }
+}
+
+Parser::Degradation Parser::ParseSentence(Document *document,
+                                          int begin, int end,
+                                          const DocumentFeatures &features,
+                                          ParserInstance *data,
+                                          const Deadline &deadline,
+                                          bool concurrent) const {
+  // Replay cached actions if the sentence has been parsed before.
+  uint64 key = 0;
+  if (cache_ != nullptr) {
+    std::vector<int> cached;
+    key = ParseCache::Fingerprint(*document, features, begin, end);
+    if (cache_->Lookup(key, &cached)) {
+      data->Replay(document, begin, end, cached);
+      return FULL;
     }
+  }
+
+  // Skip the sentence if the deadline has passed. Shifting all the tokens
+  // does not produce any frames, so the sentence gets an empty parse.
+  Clock::Timestamp now = Clock::now();
+  if (now >= deadline.stop) {
+    data->Replay(document, begin, end, {});
+    return SHIFT_ONLY;
+  }
+  Degradation level = now >= deadline.fallback ? FALLBACK : FULL;
+
+  // Reset parser model instance data for sentence.
+  data->Reset(document, begin, end);
+
+  int length = end - begin;
+  if (concurrent && lstm_workers_ != nullptr) {
+    // Compute right-to-left LSTM in a worker thread while computing the
+    // left-to-right LSTM in this thread. Both directions must be done
+    // before running the FF.
+    Barrier rl_done(1);
+    lstm_workers_->Schedule([data, &features, &rl_done, length]() {
+      data->ProjectRL(features);
+      for (int i = 0; i < length; ++i) data->ComputeRL(i, features);
+      rl_done.Done();
+    });
+    data->ProjectLR(features);
+    for (int i = 0; i < length; ++i) data->ComputeLR(i, features);
+    rl_done.Wait();
+  } else {
+    // Compute left-to-right LSTM.
+    data->ProjectLR(features);
+    for (int i = 0; i < length; ++i) data->ComputeLR(i, features);
 
     // Compute right-to-left LSTM.
-    for (int i = 0; i < s.length(); ++i) {
-      // Attach hidden and control layers.
-      data.rl_.Clear();
-      int in = s.length() - i;
-      int out = in - 1;
-      data.AttachRL(in, out);
-
-      // Extract features.
-      data.ExtractFeaturesLSTM(s.begin() + out, features, rl_, &data.rl_);
-
-      // Compute LSTM cell.
-      if (profile_) data.rl_.set_profile(&profile_->rl);
-      data.rl_.Compute();
+    data->ProjectRL(features);
+    for (int i = 0; i < length; ++i) data->ComputeRL(i, features);
+  }
+
+  // Run FF to predict transitions. As the deadline approaches, the parser
+  // degrades to fast fallback and then to shifting the remaining tokens.
+  for (;;) {
+    now = Clock::now();
+    if (now >= deadline.stop) {
+      data->Shift();
+      level = SHIFT_ONLY;
+      break;
     }
+    if (level == FULL && now >= deadline.fallback) level = FALLBACK;
+    if (!data->ComputeFF(level != FULL)) break;
+  }
 
-    // Run FF to predict transitions.
-    bool done = false;
-    int steps_since_shift = 0;
-    int step = 0;
-    while (!done) {
-      // Allocate space for next step.
-      data.ff_step_.push();
-
-      // Attach instance to recurrent layers.
-      data.ff_.Clear();
-      data.AttachFF(step);
-
-      // Extract features.
-      data.ExtractFeaturesFF(step);
-
-      // Predict next action.
-      if (profile_) data.ff_.set_profile(&profile_->ff);
-      data.ff_.Compute();
-      int prediction = 0;
-      if (fast_fallback_) {
-        // Get highest scoring action.
-        prediction = *data.ff_.Get<int>(ff_.prediction);
-        const ParserAction &action = actions_.Action(prediction);
-        if (!state.CanApply(action) || actions_.Beyond(prediction)) {
-          // Fall back to SHIFT or STOP action.
-          if (state.current() == state.end()) {
-            prediction = actions_.StopIndex();
-          } else {
-            prediction = actions_.ShiftIndex();
-          }
-        }
-      } else {
-        // Get highest scoring allowed action.
-        float *output = data.ff_.Get<float>(ff_.output);
-        float max_score = -INFINITY;
-        for (int a = 0; a < num_actions_; ++a) {
-          if (output[a] > max_score) {
-            const ParserAction &action = actions_.Action(a);
-            if (state.CanApply(action) && !actions_.Beyond(a)) {
-              prediction = a;
-              max_score = output[a];
-            }
-          }
-        }
-      }
+  // Only cache parses from the full model.
+  if (cache_ != nullptr && level == FULL) {
+    cache_->Insert(key, data->predictions());
+  }
 
-      // Apply action to parser state.
-      const ParserAction &action = actions_.Action(prediction);
-      state.Apply(action);
+  return level;
+}
 
-      // Update state.
-      switch (action.type) {
-        case ParserAction::SHIFT:
-          steps_since_shift = 0;
-          break;
+void Parser::ParseParallel(Document *document,
+                           const DocumentFeatures &features,
+                           ParserInstance *instance,
+                           const Deadline &deadline,
+                           std::vector<Degradation> *degradation) const {
+  // Collect sentences in document.
+  struct Sentence {
+    int begin;
+    int end;
+    ParserState *state;
+    Degradation level;
+  };
+  std::vector<Sentence> sentences;
+  for (SentenceIterator s(document); s.more(); s.next()) {
+    sentences.push_back({s.begin(), s.end(), nullptr, FULL});
+  }
 
-        case ParserAction::STOP:
-          done = true;
-          break;
+  // Parse sentences into separate parser states. The sentences are handed out
+  // one at a time, so long sentences do not hold up the other workers.
+  std::atomic<int> next(0);
+  auto work = [&](ParserInstance *data) {
+    for (;;) {
+      int i = next++;
+      if (i >= sentences.size()) break;
+      Sentence &s = sentences[i];
+      s.level = ParseSentence(document, s.begin, s.end, features, data,
+                              deadline, false);
+      s.state = data->ReleaseState();
+    }
+  };
+  int tasks = std::min<int>(sentence_workers_->num_workers(),
+                            sentences.size() - 1);
+  if (tasks < 0) tasks = 0;
+
+  // Each worker collects profiling data in its own profile, since the
+  // profile counters are not updated atomically. The worker profiles are
+  // added to the profile for the calling instance when all workers are done.
+  std::vector<Profile *> profiles(tasks, nullptr);
+  if (instance->profile_ != nullptr) {
+    for (int t = 0; t < tasks; ++t) profiles[t] = new Profile(this);
+  }
 
-        case ParserAction::EVOKE:
-        case ParserAction::REFER:
-        case ParserAction::CONNECT:
-        case ParserAction::ASSIGN:
-        case ParserAction::EMBED:
-        case ParserAction::ELABORATE:
-          steps_since_shift++;
-          if (state.AttentionSize() > 0) {
-            int focus = state.Attention(0);
-            if (data.create_step_.size() < focus + 1) {
-              data.create_step_.resize(focus + 1);
-              data.create_step_[focus] = step;
-            }
-            if (data.focus_step_.size() < focus + 1) {
-              data.focus_step_.resize(focus + 1);
-            }
-            data.focus_step_[focus] = step;
-          }
-      }
+  Barrier done(tasks);
+  for (int t = 0; t < tasks; ++t) {
+    Profile *profile = profiles[t];
+    sentence_workers_->Schedule([this, &work, &done, profile]() {
+      ParserInstance *data = AcquireInstance();
+      data->set_profile(profile);
+      work(data);
+      data->set_profile(nullptr);
+      ReleaseInstance(data);
+      done.Done();
+    });
+  }
+  work(instance);
+  done.Wait();
 
-      // Next step.
-      step += 1;
-    }
+  for (Profile *profile : profiles) {
+    if (profile == nullptr) continue;
+    instance->profile_->Add(*profile);
+    delete profile;
+  }
 
-    // Add frames for sentence to the document.
-    state.AddParseToDocument(document);
+  // Add frames for sentences to the document in sentence order.
+  for (Sentence &s : sentences) {
+    s.state->AddParseToDocument(document);
+    delete s.state;
+    if (degradation != nullptr) degradation->push_back(s.level);
   }
 }
 
+ParserInstance *Parser::AcquireInstance() const {
+  {
+    std::unique_lock<std::mutex> lock(instance_mu_);
+    if (!idle_instances_.empty()) {
+      ParserInstance *instance = idle_instances_.back();
+      idle_instances_.pop_back();
+      return instance;
+    }
+  }
+  return new ParserInstance(this);
+}
+
+void Parser::ReleaseInstance(ParserInstance *instance) const {
+  std::unique_lock<std::mutex> lock(instance_mu_);
+  idle_instances_.push_back(instance);
+}
+
 myelin::Cell *Parser::GetCell(const string &name) {
   myelin::Cell *cell = network_.GetCell(name);
   if (cell == nullptr) {
@@ -369,10 +627,9 @@ myelin::Tensor *Parser::GetParam(const string &name, bool optional) {
   return param;
 }
 
-ParserInstance::ParserInstance(const Parser *parser, Document *document,
-                               int begin, int end)
+ParserInstance::ParserInstance(const Parser *parser)
     : parser_(parser),
-      state_(document->store(), begin, end),
+      profile_(parser->profile_),
       lr_(parser->lr_.cell),
       rl_(parser->rl_.cell),
       ff_(parser->ff_.cell),
@@ -381,15 +638,282 @@ ParserInstance::ParserInstance(const Parser *parser, Document *document,
       rl_c_(parser->rl_.control),
       rl_h_(parser->rl_.hidden),
       ff_step_(parser->ff_.step) {
-  // Add one extra element to LSTM activations for boundary element.
+  // Initialize role tracking and action mask.
+  roles_.Init(&parser->roles_);
+  mask_.resize(parser->action_mask_.words());
+
+  // Allocate input projections.
+  if (parser->lr_.input != nullptr) lr_x_ = new Projections(parser->lr_);
+  if (parser->rl_.input != nullptr) rl_x_ = new Projections(parser->rl_);
+}
+
+ParserInstance::ParserInstance(const Parser *parser, Document *document,
+                               int begin, int end)
+    : ParserInstance(parser) {
+  Reset(document, begin, end);
+}
+
+ParserInstance::~ParserInstance() {
+  delete state_;
+  delete lr_x_;
+  delete rl_x_;
+}
+
+void ParserInstance::Reset(Document *document, int begin, int end) {
+  // Initialize parser state for sentence.
+  delete state_;
+  state_ = new ParserState(document->store(), begin, end);
+
+  // Add one extra element to LSTM activations for boundary element. The
+  // channels are cleared first so all the elements are zeroed, but the
+  // channels keep their capacity from previous sentences.
   int length = end - begin;
+  lr_c_.clear();
   lr_c_.resize(length + 1);
+  lr_h_.clear();
   lr_h_.resize(length + 1);
+  rl_c_.clear();
   rl_c_.resize(length + 1);
+  rl_h_.clear();
   rl_h_.resize(length + 1);
 
-  // Reserve two transitions per token.
-  ff_step_.reserve(length * 2);
+  // Reserve two transitions per token. The channel is only grown, since
+  // reserving less than the current capacity would shrink it.
+  ff_step_.clear();
+  if (ff_step_.capacity() < length * 2) ff_step_.reserve(length * 2);
+
+  // Make room for input projections.
+  if (lr_x_ != nullptr) lr_x_->Resize(length);
+  if (rl_x_ != nullptr) rl_x_->Resize(length);
+
+  // Reset transition state.
+  create_step_.clear();
+  focus_step_.clear();
+  roles_.Reset();
+  predictions_.clear();
+  step_ = 0;
+  done_ = false;
+}
+
+ParserInstance::Projections::Projections(const Parser::LSTM &lstm)
+    : lstm(lstm), data(lstm.input) {
+  for (auto &projection : lstm.projections) {
+    channels.push_back(new myelin::Channel(projection.cnx));
+  }
+}
+
+ParserInstance::Projections::~Projections() {
+  for (auto *channel : channels) delete channel;
+}
+
+void ParserInstance::Projections::Resize(int length) {
+  for (auto *channel : channels) channel->resize(length);
+}
+
+void ParserInstance::Projections::CopyOutputs(int index, int count) {
+  for (int k = 0; k < channels.size(); ++k) {
+    myelin::Tensor *out = lstm.projections[k].out;
+    size_t bytes = out->dim(1) * out->element_size();
+    for (int r = 0; r < count; ++r) {
+      memcpy(channels[k]->at(index + r), data.GetAddress(out) + out->offset(r),
+             bytes);
+    }
+  }
+}
+
+void ParserInstance::Projections::AttachInputs(int index,
+                                               myelin::Instance *lstm_data) {
+  for (int k = 0; k < channels.size(); ++k) {
+    lstm_data->Set(lstm.projections[k].in, channels[k], index);
+  }
+}
+
+void ParserInstance::ProjectLR(const DocumentFeatures &features) {
+  if (lr_x_ == nullptr) return;
+  Project(lr_x_, features, profile_ ? profile_->lr_input : nullptr);
+}
+
+void ParserInstance::ProjectRL(const DocumentFeatures &features) {
+  if (rl_x_ == nullptr) return;
+  Project(rl_x_, features, profile_ ? profile_->rl_input : nullptr);
+}
+
+void ParserInstance::Project(Projections *projections,
+                             const DocumentFeatures &features,
+                             myelin::ProfileSummary *profile) {
+  myelin::Instance &data = projections->data;
+  const Parser::LSTM &lstm = projections->lstm;
+  for (int i = 0; i < length(); i += lstm.batch) {
+    // Extract features for the next batch of tokens. Unused rows in the last
+    // batch are left cleared.
+    int count = std::min(lstm.batch, length() - i);
+    data.Clear();
+    for (int r = 0; r < count; ++r) {
+      ExtractFeaturesLSTM(state_->begin() + i + r, features, lstm, &data, r);
+    }
+
+    // Compute input projections for batch.
+    if (profile != nullptr) data.set_profile(profile);
+    data.Compute();
+
+    // Copy projections to channels.
+    projections->CopyOutputs(i, count);
+  }
+}
+
+void ParserInstance::ComputeLR(int index, const DocumentFeatures &features) {
+  // Attach hidden and control layers.
+  lr_.Clear();
+  int in = index > 0 ? index - 1 : length();
+  int out = index;
+  AttachLR(in, out);
+
+  // Attach input projections or extract features.
+  if (lr_x_ != nullptr) {
+    lr_x_->AttachInputs(out, &lr_);
+  } else {
+    ExtractFeaturesLSTM(state_->begin() + out, features, parser_->lr_, &lr_);
+  }
+
+  // Compute LSTM cell.
+  if (profile_) lr_.set_profile(&profile_->lr);
+  lr_.Compute();
+}
+
+void ParserInstance::ComputeRL(int index, const DocumentFeatures &features) {
+  // Attach hidden and control layers.
+  rl_.Clear();
+  int in = length() - index;
+  int out = in - 1;
+  AttachRL(in, out);
+
+  // Attach input projections or extract features.
+  if (rl_x_ != nullptr) {
+    rl_x_->AttachInputs(out, &rl_);
+  } else {
+    ExtractFeaturesLSTM(state_->begin() + out, features, parser_->rl_, &rl_);
+  }
+
+  // Compute LSTM cell.
+  if (profile_) rl_.set_profile(&profile_->rl);
+  rl_.Compute();
+}
+
+bool ParserInstance::ComputeFF(bool fallback) {
+  // Allocate space for next step.
+  ff_step_.push();
+
+  // Attach instance to recurrent layers.
+  ff_.Clear();
+  AttachFF(step_);
+
+  // Extract features.
+  ExtractFeaturesFF(step_);
+
+  // Predict next action.
+  const Parser::FF &ff = parser_->ff_;
+  const ActionTable &actions = parser_->actions_;
+  if (profile_) ff_.set_profile(&profile_->ff);
+  ff_.Compute();
+  int prediction = 0;
+  if (parser_->fast_fallback_ || fallback) {
+    // Get highest scoring action.
+    if (ff.prediction != nullptr) {
+      prediction = *ff_.Get<int>(ff.prediction);
+    } else {
+      float *output = ff_.Get<float>(ff.output);
+      prediction = std::max_element(output, output + parser_->num_actions_) -
+                   output;
+    }
+    const ParserAction &action = actions.Action(prediction);
+    if (!state_->CanApply(action) || actions.Beyond(prediction)) {
+      // Fall back to SHIFT or STOP action.
+      if (state_->current() == state_->end()) {
+        prediction = actions.StopIndex();
+      } else {
+        prediction = actions.ShiftIndex();
+      }
+    }
+  } else if (parser_->use_action_mask_) {
+    // Get highest scoring allowed action using the action mask.
+    float *output = ff_.Get<float>(ff.output);
+    int best = parser_->action_mask_.Argmax(*state_, output, mask_.data());
+    if (best != -1) prediction = best;
+  } else {
+    // Get highest scoring allowed action.
+    float *output = ff_.Get<float>(ff.output);
+    float max_score = -INFINITY;
+    for (int a = 0; a < parser_->num_actions_; ++a) {
+      if (output[a] > max_score) {
+        const ParserAction &action = actions.Action(a);
+        if (state_->CanApply(action) && !actions.Beyond(a)) {
+          prediction = a;
+          max_score = output[a];
+        }
+      }
+    }
+  }
+
+  // Apply action to parser state and update the role edges.
+  const ParserAction &action = actions.Action(prediction);
+  if (parser_->frame_limit_ > 0) roles_.Apply(*state_, action, prediction);
+  state_->Apply(action);
+  predictions_.push_back(prediction);
+
+  // Update state.
+  switch (action.type) {
+    case ParserAction::SHIFT:
+      break;
+
+    case ParserAction::STOP:
+      done_ = true;
+      break;
+
+    case ParserAction::EVOKE:
+    case ParserAction::REFER:
+    case ParserAction::CONNECT:
+    case ParserAction::ASSIGN:
+    case ParserAction::EMBED:
+    case ParserAction::ELABORATE:
+      if (state_->AttentionSize() > 0) {
+        int focus = state_->Attention(0);
+        if (create_step_.size() < focus + 1) {
+          create_step_.resize(focus + 1);
+          create_step_[focus] = step_;
+        }
+        if (focus_step_.size() < focus + 1) {
+          focus_step_.resize(focus + 1);
+        }
+        focus_step_[focus] = step_;
+      }
+  }
+
+  // Next step.
+  step_ += 1;
+  transitions_ += 1;
+  return !done_;
+}
+
+void ParserInstance::Shift() {
+  // Shift the remaining tokens and stop.
+  const ActionTable &actions = parser_->actions_;
+  const ParserAction &shift = actions.Action(actions.ShiftIndex());
+  while (state_->current() < state_->end()) {
+    state_->Apply(shift);
+    predictions_.push_back(actions.ShiftIndex());
+  }
+  state_->Apply(actions.Action(actions.StopIndex()));
+  predictions_.push_back(actions.StopIndex());
+  done_ = true;
+}
+
+void ParserInstance::Replay(Document *document, int begin, int end,
+                            const std::vector<int> &actions) {
+  const ActionTable &table = parser_->actions_;
+  delete state_;
+  state_ = new ParserState(document->store(), begin, end);
+  for (int action : actions) state_->Apply(table.Action(action));
+  done_ = true;
 }
 
 void ParserInstance::AttachLR(int input, int output) {
@@ -416,16 +940,17 @@ void ParserInstance::AttachFF(int output) {
 void ParserInstance::ExtractFeaturesLSTM(int token,
                                          const DocumentFeatures &features,
                                          const Parser::LSTM &lstm,
-                                         myelin::Instance *data) {
+                                         myelin::Instance *data,
+                                         int row) {
   // Extract word feature.
   if (lstm.word_feature) {
-    *data->Get<int>(lstm.word_feature) = features.word(token);
+    *data->Get<int>(lstm.word_feature, row) = features.word(token);
   }
 
   // Extract prefix feature.
   if (lstm.prefix_feature) {
     Affix *affix = features.prefix(token);
-    int *a = data->Get<int>(lstm.prefix_feature);
+    int *a = data->Get<int>(lstm.prefix_feature, row);
     for (int n = 0; n < lstm.prefix_size; ++n) {
       if (affix != nullptr) {
         *a++ = affix->id();
@@ -439,7 +964,7 @@ void ParserInstance::ExtractFeaturesLSTM(int token,
   // Extract suffix feature.
   if (lstm.suffix_feature) {
     Affix *affix = features.suffix(token);
-    int *a = data->Get<int>(lstm.suffix_feature);
+    int *a = data->Get<int>(lstm.suffix_feature, row);
     for (int n = 0; n < lstm.suffix_size; ++n) {
       if (affix != nullptr) {
         *a++ = affix->id();
@@ -452,35 +977,35 @@ void ParserInstance::ExtractFeaturesLSTM(int token,
 
   // Extract hyphen feature.
   if (lstm.hyphen_feature) {
-    *data->Get<int>(lstm.hyphen_feature) = features.hyphen(token);
+    *data->Get<int>(lstm.hyphen_feature, row) = features.hyphen(token);
   }
 
   // Extract capitalization feature.
   if (lstm.caps_feature) {
-    *data->Get<int>(lstm.caps_feature) = features.capitalization(token);
+    *data->Get<int>(lstm.caps_feature, row) = features.capitalization(token);
   }
 
   // Extract punctuation feature.
   if (lstm.punct_feature) {
-    *data->Get<int>(lstm.punct_feature) = features.punctuation(token);
+    *data->Get<int>(lstm.punct_feature, row) = features.punctuation(token);
   }
 
   // Extract quote feature.
   if (lstm.quote_feature) {
-    *data->Get<int>(lstm.quote_feature) = features.quote(token);
+    *data->Get<int>(lstm.quote_feature, row) = features.quote(token);
   }
 
   // Extract digit feature.
   if (lstm.digit_feature) {
-    *data->Get<int>(lstm.digit_feature) = features.digit(token);
+    *data->Get<int>(lstm.digit_feature, row) = features.digit(token);
   }
 }
 
 void ParserInstance::ExtractFeaturesFF(int step) {
   // Extract LSTM focus features.
   const Parser::FF &ff = parser_->ff_;
-  int current = state_.current() - state_.begin();
-  if (state_.current() == state_.end()) current = -1;
+  int current = state_->current() - state_->begin();
+  if (state_->current() == state_->end()) current = -1;
   int *lr_focus = GetFF(ff.lr_focus_feature);
   int *rl_focus = GetFF(ff.rl_focus_feature);
   if (lr_focus != nullptr) *lr_focus = current;
@@ -496,13 +1021,13 @@ void ParserInstance::ExtractFeaturesFF(int step) {
       int att = -1;
       int created = -1;
       int focused = -1;
-      if (d < state_.AttentionSize()) {
+      if (d < state_->AttentionSize()) {
         // Get frame from attention buffer.
-        int frame = state_.Attention(d);
+        int frame = state_->Attention(d);
 
         // Get end token for phrase that evoked frame.
-        att = state_.FrameEvokeEnd(frame);
-        if (att != -1) att -= state_.begin() + 1;
+        att = state_->FrameEvokeEnd(frame);
+        if (att != -1) att -= state_->begin() + 1;
 
         // Get the step numbers that created and focused the frame.
         created = create_step_[frame];
@@ -526,15 +1051,14 @@ void ParserInstance::ExtractFeaturesFF(int step) {
 
   // Extract role features.
   if (parser_->frame_limit_ > 0) {
-    // Construct role graph for center of attention.
-    RoleGraph graph;
-    graph.Compute(state_, parser_->frame_limit_, parser_->roles_);
+    // Construct role graph for center of attention from the tracked roles.
+    graph_.Compute(*state_, parser_->frame_limit_, roles_);
 
     // Extract out roles.
     int *out = GetFF(ff.out_roles_feature);
     if (out != nullptr) {
       int *end = out + ff.out_roles_size;
-      graph.out([&out, end](int f) {
+      graph_.out([&out, end](int f) {
         if (out < end) *out++ = f;
       });
       while (out < end) *out++ = -2;
@@ -544,7 +1068,7 @@ void ParserInstance::ExtractFeaturesFF(int step) {
     int *in = GetFF(ff.in_roles_feature);
     if (in != nullptr) {
       int *end = in + ff.in_roles_size;
-      graph.in([&in, end](int f) {
+      graph_.in([&in, end](int f) {
         if (in < end) *in++ = f;
       });
       while (in < end) *in++ = -2;
@@ -554,7 +1078,7 @@ void ParserInstance::ExtractFeaturesFF(int step) {
     int *unlabeled = GetFF(ff.unlabeled_roles_feature);
     if (unlabeled != nullptr) {
       int *end = unlabeled + ff.unlabeled_roles_size;
-      graph.unlabeled([&unlabeled, end](int f) {
+      graph_.unlabeled([&unlabeled, end](int f) {
         if (unlabeled < end) *unlabeled++ = f;
       });
       while (unlabeled < end) *unlabeled++ = -2;
@@ -564,7 +1088,7 @@ void ParserInstance::ExtractFeaturesFF(int step) {
     int *labeled = GetFF(ff.labeled_roles_feature);
     if (labeled != nullptr) {
       int *end = labeled + ff.labeled_roles_size;
-      graph.labeled([&labeled, end](int f) {
+      graph_.labeled([&labeled, end](int f) {
         if (labeled < end) *labeled++ = f;
       });
       while (labeled < end) *labeled++ = -2;
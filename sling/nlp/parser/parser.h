@@ -16,10 +16,12 @@
 #define SLING_NLP_PARSER_PARSER_H_
 
 #include <limits>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "sling/base/clock.h"
 #include "sling/base/logging.h"
 #include "sling/base/types.h"
 #include "sling/file/file.h"
@@ -30,9 +32,12 @@
 #include "sling/nlp/document/document.h"
 #include "sling/nlp/document/features.h"
 #include "sling/nlp/document/lexicon.h"
+#include "sling/nlp/parser/action-mask.h"
 #include "sling/nlp/parser/action-table.h"
+#include "sling/nlp/parser/parse-cache.h"
 #include "sling/nlp/parser/parser-state.h"
 #include "sling/nlp/parser/roles.h"
+#include "sling/util/thread.h"
 
 namespace sling {
 namespace nlp {
@@ -44,15 +49,68 @@ class Parser {
  public:
   // Profile summary for each cell.
   struct Profile {
-    Profile(Parser *parser)
-      : lr(parser->lr_.cell), rl(parser->rl_.cell), ff(parser->ff_.cell) {}
+    Profile(const Parser *parser)
+      : lr(parser->lr_.cell), rl(parser->rl_.cell), ff(parser->ff_.cell) {
+      if (parser->lr_.input != nullptr) {
+        lr_input = new myelin::ProfileSummary(parser->lr_.input);
+      }
+      if (parser->rl_.input != nullptr) {
+        rl_input = new myelin::ProfileSummary(parser->rl_.input);
+      }
+    }
+    ~Profile() {
+      delete lr_input;
+      delete rl_input;
+    }
+
+    // Add profiling data from another profile for the same parser.
+    void Add(const Profile &other) {
+      lr.Add(other.lr);
+      rl.Add(other.rl);
+      ff.Add(other.ff);
+      if (lr_input != nullptr) lr_input->Add(*other.lr_input);
+      if (rl_input != nullptr) rl_input->Add(*other.rl_input);
+    }
 
     myelin::ProfileSummary lr;                // profile summary for LR LSTM
     myelin::ProfileSummary rl;                // profile summary for RL LSTM
     myelin::ProfileSummary ff;                // profile summary for FF
+
+    // Profile summaries for LSTM input projections if these are split out.
+    myelin::ProfileSummary *lr_input = nullptr;
+    myelin::ProfileSummary *rl_input = nullptr;
+  };
+
+  // Deadline for parsing a document. The parser degrades gracefully as the
+  // deadline approaches. After the fallback time, the parser uses fast
+  // fallback, i.e. it takes the highest scoring action and falls back to
+  // SHIFT or STOP if this action is not allowed. After the stop time, the
+  // remaining tokens are shifted without running the parser network.
+  struct Deadline {
+    Clock::Timestamp fallback;     // time for switching to fast fallback
+    Clock::Timestamp stop;         // time for switching to shift-only
+
+    // Deadline for a time budget in milliseconds from a start time. The
+    // parser switches to fast fallback when a fraction of the budget has been
+    // used.
+    static Deadline Budget(Clock::Timestamp start, double ms,
+                           double fallback = 0.5);
+
+    // Deadline that never expires.
+    static Deadline None() {
+      return {std::numeric_limits<Clock::Timestamp>::max(),
+              std::numeric_limits<Clock::Timestamp>::max()};
+    }
+  };
+
+  // Degradation level for sentence parsed under a deadline.
+  enum Degradation {
+    FULL,                          // parsed with the full model
+    FALLBACK,                      // parsed partly with fast fallback
+    SHIFT_ONLY,                    // tokens shifted without running network
   };
 
-  ~Parser() { delete profile_; }
+  ~Parser();
 
   // Load and initialize parser model.
   void Load(Store *store, const string &filename);
@@ -60,6 +118,19 @@ class Parser {
   // Parse document.
   void Parse(Document *document) const;
 
+  // Parse document using a parser instance that is reused across sentences.
+  // A thread can keep its own parser instance for parsing a stream of
+  // documents, so the network instances and channels are not reallocated for
+  // each sentence.
+  void Parse(Document *document, ParserInstance *instance) const;
+
+  // Parse document under a deadline. The time is checked between sentences
+  // and before each transition. The degradation level for each sentence is
+  // added to 'degradation' if it is not null.
+  void Parse(Document *document, ParserInstance *instance,
+             const Deadline &deadline,
+             std::vector<Degradation> *degradation) const;
+
   // Enable profiling. Must be called before Load().
   void EnableProfiling() {
     network_.options().profiling = true;
@@ -69,10 +140,53 @@ class Parser {
   // Enable fast fallback. Must be called before Load().
   void EnableFastFallback() { fast_fallback_ = true; }
 
+  // Split the input projections out of the LSTM cells and compute them for
+  // the whole sentence before running the recurrences. The projections are
+  // computed as matrix-matrix products over batches of tokens, so sentences
+  // up to the batch size are projected in one computation. Must be called
+  // before Load().
+  void EnableInputProjection(int batch = 8) {
+    split_lstm_inputs_ = true;
+    input_batch_ = batch;
+  }
+
+  // Select the best allowed action by scanning all the actions instead of
+  // using the action mask.
+  void DisableActionMask() { use_action_mask_ = false; }
+
   // Run parser on GPU if available. Must be called before Load().
   void EnableGPU();
 
-  // Return profile summary for parser.
+  // Compute the RL LSTM in a worker thread concurrently with the LR LSTM in
+  // the calling thread. This reduces the latency for parsing a single
+  // document when there are idle cores. Each concurrent caller of Parse()
+  // occupies one worker while its RL LSTM is computed.
+  void EnableConcurrentLSTM(int workers = 1);
+
+  // Parse the sentences of a document in parallel. The calling thread and up
+  // to 'workers' worker threads each parse sentences into their own parser
+  // state, and the parses are then added to the document in sentence order
+  // by the calling thread, so only the calling thread writes to the document
+  // store. This reduces the latency for parsing long documents.
+  void EnableParallelSentences(int workers);
+
+  // Cache the actions for up to 'size' sentences. Sentences with the same
+  // token texts and quotes as a cached sentence are parsed by replaying the
+  // cached actions without running the parser network.
+  void EnableCache(int size);
+
+  // Return parse cache or null if caching is not enabled.
+  ParseCache *cache() const { return cache_; }
+
+  // Cache the lexical features for up to 'size' out-of-vocabulary words. The
+  // cache is shared by all threads using the parser.
+  void EnableFeatureCache(int size);
+
+  // Return feature cache or null if feature caching is not enabled.
+  FeatureCache *feature_cache() const { return feature_cache_; }
+
+  // Return profile summary for parser. This is null if profiling is not
+  // enabled.
   Profile *profile() const { return profile_; }
 
  private:
@@ -105,6 +219,23 @@ class Parser {
     myelin::Tensor *c_out;                    // link to LSTM control output
     myelin::Tensor *h_in;                     // link to LSTM hidden input
     myelin::Tensor *h_out;                    // link to LSTM hidden output
+
+    // Input projection cell computing the part of the LSTM that only depends
+    // on the input features. The input cell computes the projections for a
+    // batch of tokens at a time. The projections for all the tokens in a
+    // sentence are computed before the recurrence and passed to the LSTM
+    // cell through the projection connectors. This is null if the input
+    // projections have not been split out of the LSTM cell.
+    myelin::Cell *input = nullptr;
+    int batch = 1;                            // tokens per input computation
+
+    // Projections from input cell to LSTM cell.
+    struct Projection {
+      myelin::Connector *cnx;                 // projection connector
+      myelin::Tensor *out;                    // input cell output
+      myelin::Tensor *in;                     // link to LSTM cell input
+    };
+    std::vector<Projection> projections;
   };
 
   // Feed-forward cell.
@@ -149,9 +280,38 @@ class Parser {
   // Initialize LSTM cell.
   void InitLSTM(const string &name, LSTM *lstm, bool reverse);
 
+  // Split the ops that only depend on the input features out of the LSTM
+  // function into a separate input projection function that computes the
+  // projections for a batch of tokens. Returns false if the LSTM has no input
+  // projections.
+  static bool SplitInputProjection(myelin::Flow *flow, const string &name,
+                                   int batch);
+
   // Initialize FF cell.
   void InitFF(const string &name, FF *ff);
 
+  // Parse sentence using parser instance. The parse is left in the parser
+  // state for the instance and is not added to the document. If 'concurrent'
+  // is true, the LSTMs are computed concurrently if this is enabled.
+  Degradation ParseSentence(Document *document, int begin, int end,
+                            const DocumentFeatures &features,
+                            ParserInstance *data,
+                            const Deadline &deadline,
+                            bool concurrent) const;
+
+  // Parse the sentences in a document in parallel.
+  void ParseParallel(Document *document,
+                     const DocumentFeatures &features,
+                     ParserInstance *instance,
+                     const Deadline &deadline,
+                     std::vector<Degradation> *degradation) const;
+
+  // Get idle parser instance for sentence worker.
+  ParserInstance *AcquireInstance() const;
+
+  // Return parser instance to the idle instances.
+  void ReleaseInstance(ParserInstance *instance) const;
+
   // Lookup cells, connectors, and parameters.
   myelin::Cell *GetCell(const string &name);
   myelin::Connector *GetConnector(const string &name);
@@ -181,6 +341,10 @@ class Parser {
   // Parser action table.
   ActionTable actions_;
 
+  // Action mask for selecting the best allowed action.
+  ActionMask action_mask_;
+  bool use_action_mask_ = true;
+
   // Maximum attention index considered (exclusive).
   int frame_limit_ = 5;
 
@@ -193,6 +357,28 @@ class Parser {
   // Run parser on GPU.
   bool use_gpu_ = false;
 
+  // Split input projections out of LSTM cells.
+  bool split_lstm_inputs_ = false;
+
+  // Number of tokens in each input projection computation.
+  int input_batch_ = 1;
+
+  // Worker threads for computing the RL LSTM concurrently with the LR LSTM.
+  ThreadPool *lstm_workers_ = nullptr;
+
+  // Worker threads for parsing sentences in parallel.
+  ThreadPool *sentence_workers_ = nullptr;
+
+  // Idle parser instances for sentence workers.
+  mutable std::vector<ParserInstance *> idle_instances_;
+  mutable std::mutex instance_mu_;
+
+  // Cache with parser actions for sentences.
+  ParseCache *cache_ = nullptr;
+
+  // Cache with lexical features for out-of-vocabulary words.
+  FeatureCache *feature_cache_ = nullptr;
+
   // Symbols.
   Names names_;
   Name n_document_tokens_{names_, "/s/document/tokens"};
@@ -205,8 +391,72 @@ class Parser {
 // Parser state for running an instance of the parser on a document.
 class ParserInstance {
  public:
+  // Initialize parser instance. The instance must be reset for a sentence
+  // before it can be used.
+  explicit ParserInstance(const Parser *parser);
+
+  // Initialize parser instance for sentence.
   ParserInstance(const Parser *parser, Document *document, int begin, int end);
 
+  ~ParserInstance();
+
+  // Reset the instance for parsing a new sentence. The network instances and
+  // channels are reused, so parsing a sequence of sentences with the same
+  // parser instance only allocates memory when a sentence is longer than the
+  // ones seen before.
+  void Reset(Document *document, int begin, int end);
+
+  // Compute input projections for all tokens in the sentence for LR LSTM.
+  void ProjectLR(const DocumentFeatures &features);
+
+  // Compute input projections for all tokens in the sentence for RL LSTM.
+  void ProjectRL(const DocumentFeatures &features);
+
+  // Compute LR LSTM for token position in sentence.
+  void ComputeLR(int index, const DocumentFeatures &features);
+
+  // Compute RL LSTM for the index'th token position from the end of the
+  // sentence.
+  void ComputeRL(int index, const DocumentFeatures &features);
+
+  // Run FF to predict the next transition and apply it to the parser state.
+  // If 'fallback' is true, the highest scoring action is used even if the
+  // parser is not set up for fast fallback. Returns false when the parser has
+  // stopped.
+  bool ComputeFF(bool fallback = false);
+
+  // Shift the remaining tokens in the sentence and stop the parser without
+  // running the FF.
+  void Shift();
+
+  // Set up parser state for sentence by applying a sequence of actions
+  // without running the parser network.
+  void Replay(Document *document, int begin, int end,
+              const std::vector<int> &actions);
+
+  // Release ownership of the parser state for the current sentence. The
+  // instance must be reset before it can be used again.
+  ParserState *ReleaseState() {
+    ParserState *state = state_;
+    state_ = nullptr;
+    return state;
+  }
+
+  // Number of tokens in sentence.
+  int length() const { return state_->end() - state_->begin(); }
+
+  // Total number of transitions predicted by the instance.
+  int64 transitions() const { return transitions_; }
+
+  // Actions predicted for the current sentence.
+  const std::vector<int> &predictions() const { return predictions_; }
+
+  // Collect profiling data for the instance in a separate profile instead of
+  // the profile for the parser. Threads parsing concurrently should each use
+  // their own profile, since the profile counters are not updated
+  // atomically. The profiles can be merged with Parser::Profile::Add().
+  void set_profile(Parser::Profile *profile) { profile_ = profile; }
+
   // Attach connectors for LR LSTM.
   void AttachLR(int input, int output);
 
@@ -216,16 +466,43 @@ class ParserInstance {
   // Attach connectors for FF.
   void AttachFF(int output);
 
-  // Extract features for LSTM.
+  // Extract features for LSTM. The features are extracted into the given row
+  // of the feature inputs.
   void ExtractFeaturesLSTM(int token,
                            const DocumentFeatures &features,
                            const Parser::LSTM &lstm,
-                           myelin::Instance *data);
+                           myelin::Instance *data,
+                           int row = 0);
 
   // Extract features for FF.
   void ExtractFeaturesFF(int step);
 
  private:
+  // Input projection state for LSTM.
+  struct Projections {
+    Projections(const Parser::LSTM &lstm);
+    ~Projections();
+
+    // Make room for projections for all the tokens in sentence.
+    void Resize(int length);
+
+    // Copy the projections for a batch of tokens from the input cell to the
+    // projection channels.
+    void CopyOutputs(int index, int count);
+
+    // Attach projection inputs for token to LSTM cell.
+    void AttachInputs(int index, myelin::Instance *lstm_data);
+
+    const Parser::LSTM &lstm;                 // LSTM with input projections
+    myelin::Instance data;                    // input projection instance
+    std::vector<myelin::Channel *> channels;  // projections for all tokens
+  };
+
+  // Compute input projections for all tokens in the sentence.
+  void Project(Projections *projections,
+               const DocumentFeatures &features,
+               myelin::ProfileSummary *profile);
+
   // Get feature vector for FF.
   int *GetFF(myelin::Tensor *type) {
     return type ? ff_.Get<int>(type) : nullptr;
@@ -234,8 +511,11 @@ class ParserInstance {
   // Parser model.
   const Parser *parser_;
 
-  // Parser transition state.
-  ParserState state_;
+  // Profile for collecting profiling data or null if profiling is disabled.
+  Parser::Profile *profile_;
+
+  // Parser transition state for current sentence.
+  ParserState *state_ = nullptr;
 
   // Instances for network computations.
   myelin::Instance lr_;
@@ -249,10 +529,36 @@ class ParserInstance {
   myelin::Channel rl_h_;
   myelin::Channel ff_step_;
 
+  // Input projections for LSTMs. These are null if the LSTM has no input
+  // projection cell.
+  Projections *lr_x_ = nullptr;
+  Projections *rl_x_ = nullptr;
+
   // Frame creation and focus steps.
   std::vector<int> create_step_;
   std::vector<int> focus_step_;
 
+  // Role edges for the frames in the parser state.
+  RoleTracker roles_;
+
+  // Role graph for the frames in the attention buffer.
+  RoleGraph graph_;
+
+  // Scratch space for action mask.
+  std::vector<uint64> mask_;
+
+  // Actions predicted for the current sentence.
+  std::vector<int> predictions_;
+
+  // Number of transitions predicted so far.
+  int step_ = 0;
+
+  // Total number of transitions predicted for all sentences.
+  int64 transitions_ = 0;
+
+  // Whether the parser has predicted the STOP action.
+  bool done_ = false;
+
   friend class Parser;
 };
 
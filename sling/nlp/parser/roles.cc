@@ -18,6 +18,7 @@ namespace sling {
 namespace nlp {
 
 void RoleSet::Init(const ActionTable &actions) {
+  action_roles_.resize(actions.NumActions(), -1);
   for (int i = 0; i < actions.NumActions(); ++i) {
     const auto &action = actions.Action(i);
     if (action.type == ParserAction::CONNECT ||
@@ -28,8 +29,62 @@ void RoleSet::Init(const ActionTable &actions) {
         int index = roles_.size();
         roles_[action.role] = index;
       }
+      action_roles_[i] = roles_[action.role];
     }
   }
+  isa_ = Lookup(Handle::isa());
+}
+
+int RoleTracker::AddFrame() {
+  int frame = num_frames_++;
+  if (edges_.size() < num_frames_) edges_.resize(num_frames_);
+  std::vector<Edge> &edges = edges_[frame];
+  edges.clear();
+  edges.emplace_back(roles_->isa(), -1);
+  return frame;
+}
+
+void RoleTracker::Apply(const ParserState &state,
+                        const ParserAction &action,
+                        int index) {
+  int role = roles_->ActionRole(index);
+  switch (action.type) {
+    case ParserAction::EVOKE:
+      AddFrame();
+      break;
+
+    case ParserAction::CONNECT: {
+      int source = state.Attention(action.source);
+      int target = state.Attention(action.target);
+      edges_[source].emplace_back(role, target);
+      break;
+    }
+
+    case ParserAction::ASSIGN: {
+      int source = state.Attention(action.source);
+      edges_[source].emplace_back(role, -1);
+      break;
+    }
+
+    case ParserAction::EMBED: {
+      int target = state.Attention(action.target);
+      int frame = AddFrame();
+      edges_[frame].emplace_back(role, target);
+      break;
+    }
+
+    case ParserAction::ELABORATE: {
+      int source = state.Attention(action.source);
+      int frame = AddFrame();
+      edges_[source].emplace_back(role, frame);
+      break;
+    }
+
+    case ParserAction::SHIFT:
+    case ParserAction::STOP:
+    case ParserAction::REFER:
+      break;
+  }
 }
 
 void RoleGraph::Compute(const ParserState &state,
@@ -41,16 +96,14 @@ void RoleGraph::Compute(const ParserState &state,
   edges_.clear();
   if (k > state.AttentionSize()) k = state.AttentionSize();
   for (int source = 0; source < k; ++source) {
-    Handle handle = state.frame(state.Attention(source));
-    const FrameDatum *frame = state.store()->GetFrame(handle);
-    for (const Slot *slot = frame->begin(); slot < frame->end(); ++slot) {
+    for (const Slot &slot : state.FrameSlots(state.Attention(source))) {
       int target = -1;
-      if (slot->value.IsIndex()) {
-        target = state.AttentionIndex(slot->value.AsIndex(), k);
+      if (slot.value.IsIndex()) {
+        target = state.AttentionIndex(slot.value.AsIndex(), k);
         if (target == -1) continue;
       }
 
-      int role = roles.Lookup(slot->name);
+      int role = roles.Lookup(slot.name);
       if (role == -1) continue;
 
       edges_.emplace_back(source, role, target);
@@ -58,6 +111,28 @@ void RoleGraph::Compute(const ParserState &state,
   }
 }
 
+void RoleGraph::Compute(const ParserState &state,
+                        int limit,
+                        const RoleTracker &tracker) {
+  limit_ = limit;
+  num_roles_ = tracker.roles()->size();
+  int k = limit_;
+  edges_.clear();
+  if (k > state.AttentionSize()) k = state.AttentionSize();
+  for (int source = 0; source < k; ++source) {
+    for (const RoleTracker::Edge &e : tracker.edges(state.Attention(source))) {
+      int target = -1;
+      if (e.target != -1) {
+        target = state.AttentionIndex(e.target, k);
+        if (target == -1) continue;
+      }
+      if (e.role == -1) continue;
+
+      edges_.emplace_back(source, e.role, target);
+    }
+  }
+}
+
 }  // namespace nlp
 }  // namespace sling
 
@@ -41,9 +41,65 @@ class RoleSet {
   // Return the number of roles in the role set.
   int size() const { return roles_.size(); }
 
+  // Return role id for the role of an action in the action table, or -1 if
+  // the action has no role.
+  int ActionRole(int action) const { return action_roles_[action]; }
+
+  // Return role id for the isa role. This is -1 unless some action uses isa as
+  // a role.
+  int isa() const { return isa_; }
+
  private:
   // Mapping from role handle to role id.
   HandleMap<int> roles_;
+
+  // Role id for each action in the action table.
+  std::vector<int> action_roles_;
+
+  // Role id for isa role.
+  int isa_ = -1;
+};
+
+// Role edges for all the frames in a parser state. The edges are updated
+// incrementally when actions are applied to the parser state, so role graphs
+// can be computed without reading the frames from the store and without
+// looking up role ids. The edges for each frame are kept in slot order.
+class RoleTracker {
+ public:
+  // Edge from a frame. The target is the frame index of the target frame, or
+  // -1 if the value of the role is not a frame in the parser state.
+  struct Edge {
+    Edge(int r, int t) : role(r), target(t) {}
+    int role;
+    int target;
+  };
+
+  // Initialize role tracker for role set.
+  void Init(const RoleSet *roles) { roles_ = roles; }
+
+  // Remove all frames. The allocated memory is kept for reuse.
+  void Reset() { num_frames_ = 0; }
+
+  // Update edges for action. This must be called before the action with the
+  // index in the action table is applied to the parser state.
+  void Apply(const ParserState &state, const ParserAction &action, int index);
+
+  // Return edges for frame.
+  const std::vector<Edge> &edges(int frame) const { return edges_[frame]; }
+
+  // Return the role set for the tracker.
+  const RoleSet *roles() const { return roles_; }
+
+ private:
+  // Add new frame with an isa slot and return its frame index.
+  int AddFrame();
+
+  // Role set.
+  const RoleSet *roles_ = nullptr;
+
+  // Edges for each frame. Only the first num_frames_ entries are in use.
+  std::vector<std::vector<Edge>> edges_;
+  int num_frames_ = 0;
 };
 
 // A role graph represents the roles edges between the top frames in the
@@ -57,6 +113,11 @@ class RoleGraph {
   // Compute role graph from parser state.
   void Compute(const ParserState &state, int limit, const RoleSet &roles);
 
+  // Compute role graph from parser state using incrementally tracked role
+  // edges. This produces the same graph as computing it from the frames.
+  void Compute(const ParserState &state, int limit,
+               const RoleTracker &tracker);
+
   // Emit (source, role) features.
   void out(Emit emit) const {
     for (const Edge &e : edges_) {
@@ -0,0 +1,88 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Streaming pipeline for parsing documents in record files. The documents in
+// the --input record files are decoded, parsed, encoded, and written to the
+// --output record file in input order. If --text is set, the input records
+// contain plain text which is tokenized before parsing. Each stage has its
+// own pool of worker threads, and the utilization of each stage is reported
+// at the end, so the number of workers for the bottleneck stage can be
+// adjusted.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sling/base/clock.h"
+#include "sling/base/flags.h"
+#include "sling/base/init.h"
+#include "sling/base/logging.h"
+#include "sling/base/status.h"
+#include "sling/file/file.h"
+#include "sling/frame/store.h"
+#include "sling/nlp/parser/parse-pipeline.h"
+#include "sling/nlp/parser/parser.h"
+
+DEFINE_string(parser, "", "Input file with flow model");
+DEFINE_string(input, "", "Input record file pattern");
+DEFINE_string(output, "", "Output record file");
+DEFINE_bool(text, false, "Input records contain plain text");
+DEFINE_int32(decoders, 1, "Number of decoder threads");
+DEFINE_int32(parsers, 1, "Number of parser threads");
+DEFINE_int32(encoders, 1, "Number of encoder threads");
+DEFINE_int32(queue_size, 1024, "Maximum number of documents in each queue");
+DEFINE_int32(max_in_flight, 8192, "Maximum number of documents in pipeline");
+DEFINE_int32(cache, 0, "Number of sentences in parse cache (0 = no cache)");
+
+using namespace sling;
+using namespace sling::nlp;
+
+int main(int argc, char *argv[]) {
+  InitProgram(&argc, &argv);
+  CHECK(!FLAGS_parser.empty());
+  CHECK(!FLAGS_input.empty());
+  CHECK(!FLAGS_output.empty());
+
+  // Find input files.
+  std::vector<string> inputs;
+  CHECK(File::Match(FLAGS_input, &inputs));
+  CHECK(!inputs.empty()) << "No input files match " << FLAGS_input;
+
+  // Load parser.
+  LOG(INFO) << "Load parser from " << FLAGS_parser;
+  Store commons;
+  Parser parser;
+  if (FLAGS_cache > 0) parser.EnableCache(FLAGS_cache);
+  parser.Load(&commons, FLAGS_parser);
+  commons.Freeze();
+
+  // Run pipeline.
+  ParsePipeline::Options options;
+  options.decoders = FLAGS_decoders;
+  options.parsers = FLAGS_parsers;
+  options.encoders = FLAGS_encoders;
+  options.queue_size = FLAGS_queue_size;
+  options.max_in_flight = FLAGS_max_in_flight;
+  options.text = FLAGS_text;
+  ParsePipeline pipeline(&parser, &commons, options);
+  LOG(INFO) << "Parse " << inputs.size() << " files into " << FLAGS_output;
+  Status st = pipeline.Run(inputs, FLAGS_output);
+  if (!st.ok()) LOG(ERROR) << "Parse pipeline failed: " << st;
+
+  // Output stage statistics.
+  std::cout << pipeline.Report();
+  if (parser.cache() != nullptr) LOG(INFO) << parser.cache()->Report();
+
+  return st.ok() ? 0 : 1;
+}
@@ -19,15 +19,25 @@
 //    The output frames are printed in textual form, whose indentation is
 //    controlled by --indent.
 // B. If --benchmark is true, then it runs the parser over the corpus
-//    specified via --corpus, and reports the processing speed.
+//    specified via --corpus, and reports the processing speed. The corpus is
+//    parsed by --threads threads sharing the parser, each with its own local
+//    stores, after parsing the first --warmup documents in each thread. The
+//    results are written in JSON format to --benchmark_output if it is set.
 // C. If --evaluate is true, then it takes gold documents via --corpus, runs
 //    the parser over them, and reports frame evaluation numbers.
 //
 // For B and C, --maxdocs can be used to limit the processing to the specified
 // number of documents.
 
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <new>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "sling/base/clock.h"
@@ -35,6 +45,7 @@
 #include "sling/base/logging.h"
 #include "sling/base/types.h"
 #include "sling/base/flags.h"
+#include "sling/file/file.h"
 #include "sling/frame/object.h"
 #include "sling/frame/serialization.h"
 #include "sling/nlp/document/document.h"
@@ -43,6 +54,7 @@
 #include "sling/nlp/parser/parser.h"
 #include "sling/nlp/parser/trainer/frame-evaluation.h"
 #include "sling/string/printf.h"
+#include "sling/util/thread.h"
 
 DEFINE_string(parser, "", "Input file with flow model");
 DEFINE_string(text, "", "Text to parse");
@@ -55,10 +67,38 @@ DEFINE_bool(profile, false, "Profile parser");
 DEFINE_int32(maxdocs, -1, "Maximum number of documents to process");
 DEFINE_bool(fast_fallback, false, "Use fast fallback for parser predictions");
 DEFINE_bool(gpu, false, "Run parser on GPU");
+DEFINE_bool(action_mask, true, "Use action mask for parser predictions");
+DEFINE_bool(input_projection, false, "Split input projections out of LSTMs");
+DEFINE_int32(input_projection_batch, 8, "Tokens per input projection batch");
+DEFINE_int32(cache, 0, "Number of sentences in parse cache (0 = no cache)");
+DEFINE_int32(feature_cache, 0, "Number of words in feature cache (0 = none)");
+DEFINE_int32(sentence_workers, 0, "Workers for parsing sentences in parallel");
+DEFINE_int32(threads, 1, "Number of threads for benchmark");
+DEFINE_int32(warmup, 0, "Number of warmup documents excluded from benchmark");
+DEFINE_string(benchmark_output, "", "Output file for benchmark results");
+DEFINE_string(benchmark_label, "", "Label for benchmark results");
 
 using namespace sling;
 using namespace sling::nlp;
 
+// Process-wide allocation counters for the benchmark. These count the memory
+// allocated with operator new by all threads, including the sentence workers
+// and the threads used for computing the LSTMs in parallel.
+static std::atomic<int64> num_allocations{0};
+static std::atomic<int64> allocated_bytes{0};
+
+void *operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void *ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
 Document *RemoveAnnotations(Document *document) {
   Store *store = document->store();
   Handle h_mention = store->Lookup("/s/document/mention");
@@ -124,6 +164,244 @@ class ParserEvaulationCorpus : public ParallelCorpus {
   int num_documents_ = 0;    // number of documents processed
 };
 
+// Benchmark results for thread.
+struct BenchmarkThread {
+  std::vector<double> latency;       // latency for each document in ms
+  int64 documents = 0;               // number of documents parsed
+  int64 tokens = 0;                  // number of tokens parsed
+  int64 transitions = 0;             // number of parser transitions
+  double busy = 0.0;                 // time spent parsing in seconds
+  Parser::Profile *profile = nullptr;
+};
+
+// Return latency percentile in sorted latencies.
+static double Percentile(const std::vector<double> &latency, double p) {
+  if (latency.empty()) return 0.0;
+  int index = static_cast<int>(p * latency.size());
+  if (index >= latency.size()) index = latency.size() - 1;
+  return latency[index];
+}
+
+// Return resident set size in bytes.
+static int64 ResidentMemory() {
+  int64 size = 0;
+  int64 resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f == nullptr) return 0;
+  if (fscanf(f, "%lld %lld", &size, &resident) != 2) resident = 0;
+  fclose(f);
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Return peak resident set size in bytes.
+static int64 PeakResidentMemory() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return usage.ru_maxrss * 1024LL;
+}
+
+// Return string as a quoted JSON string.
+static string JSONString(const string &str) {
+  string quoted = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      quoted.push_back('\\');
+      quoted.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      StringAppendF(&quoted, "\\u%04x", c);
+    } else {
+      quoted.push_back(c);
+    }
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+// Run benchmark of parser on corpus.
+void Benchmark(Parser *parser, Store *commons) {
+  // Read documents from corpus. The documents are kept in encoded form, so
+  // each document can be decoded into a local store in the benchmark threads.
+  LOG(INFO) << "Benchmarking parser on " << FLAGS_corpus;
+  DocumentSource *corpus = DocumentSource::Create(FLAGS_corpus);
+  std::vector<string> documents;
+  for (;;) {
+    if (FLAGS_maxdocs != -1 && documents.size() >= FLAGS_maxdocs) break;
+    Store store(commons);
+    Document *document = corpus->Next(&store);
+    if (document == nullptr) break;
+    documents.push_back(Encode(document->top()));
+    delete document;
+  }
+  delete corpus;
+
+  // Parse documents in benchmark threads. Each thread warms up on the first
+  // documents, and only the remaining documents are timed, so the warmup
+  // documents are not parsed again with hot caches.
+  int num_threads = std::max(FLAGS_threads, 1);
+  int num_warmup = std::min<int>(std::max(FLAGS_warmup, 0), documents.size());
+  std::vector<BenchmarkThread> results(num_threads);
+  std::atomic<int> next(num_warmup);
+  Barrier ready(num_threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      BenchmarkThread &result = results[t];
+      ParserInstance instance(parser);
+
+      // Warm up parser instance. The warmup is not profiled.
+      Parser::Profile *warmup = nullptr;
+      if (parser->profile() != nullptr) {
+        warmup = new Parser::Profile(parser);
+        instance.set_profile(warmup);
+      }
+      for (int i = 0; i < num_warmup; ++i) {
+        Store store(commons);
+        Document document(Decode(&store, documents[i]).AsFrame());
+        parser->Parse(&document, &instance);
+      }
+      if (warmup != nullptr) {
+        result.profile = new Parser::Profile(parser);
+        instance.set_profile(result.profile);
+        delete warmup;
+      }
+      int64 transitions = instance.transitions();
+      ready.Done();
+      ready.Wait();
+
+      // Parse documents until all documents have been parsed.
+      Clock clock;
+      for (;;) {
+        int i = next++;
+        if (i >= documents.size()) break;
+        Store store(commons);
+        Document document(Decode(&store, documents[i]).AsFrame());
+
+        clock.start();
+        parser->Parse(&document, &instance);
+        clock.stop();
+
+        result.latency.push_back(clock.ms());
+        result.busy += clock.secs();
+        result.documents++;
+        result.tokens += document.num_tokens();
+      }
+      result.transitions = instance.transitions() - transitions;
+    });
+  }
+
+  // Wait until all threads have been warmed up and then time the benchmark.
+  Clock clock;
+  ready.Wait();
+  clock.start();
+
+  // The allocations are counted over the timed part of the benchmark for the
+  // whole process, so they include decoding the documents being parsed.
+  int64 allocations = num_allocations;
+  int64 allocated = allocated_bytes;
+  for (auto &t : threads) t.join();
+  clock.stop();
+  allocations = num_allocations - allocations;
+  allocated = allocated_bytes - allocated;
+
+  // Merge results from all threads.
+  BenchmarkThread total;
+  for (BenchmarkThread &result : results) {
+    total.latency.insert(total.latency.end(),
+                         result.latency.begin(), result.latency.end());
+    total.documents += result.documents;
+    total.tokens += result.tokens;
+    total.transitions += result.transitions;
+    total.busy += result.busy;
+    if (result.profile != nullptr) {
+      parser->profile()->Add(*result.profile);
+      delete result.profile;
+    }
+  }
+  std::sort(total.latency.begin(), total.latency.end());
+  double secs = clock.secs();
+  double docs = total.documents > 0 ? total.documents : 1;
+  double mean = 0.0;
+  for (double l : total.latency) mean += l;
+  mean /= docs;
+
+  LOG(INFO) << total.documents << " documents, "
+            << total.tokens << " tokens, "
+            << num_threads << " threads, "
+            << total.tokens / secs << " tokens/sec, "
+            << total.documents / secs << " docs/sec";
+  LOG(INFO) << "latency ms: p50 " << Percentile(total.latency, 0.5)
+            << ", p90 " << Percentile(total.latency, 0.9)
+            << ", p99 " << Percentile(total.latency, 0.99)
+            << ", p999 " << Percentile(total.latency, 0.999);
+  if (total.transitions > 0) {
+    LOG(INFO) << total.transitions << " transitions, "
+              << total.busy * 1e6 / total.transitions << " us/transition";
+  }
+  LOG(INFO) << allocations / docs << " allocations/doc, "
+            << ResidentMemory() / 1048576.0 << " MB RSS, "
+            << PeakResidentMemory() / 1048576.0 << " MB peak RSS";
+  if (parser->cache() != nullptr) LOG(INFO) << parser->cache()->Report();
+  if (parser->feature_cache() != nullptr) {
+    LOG(INFO) << parser->feature_cache()->Report();
+  }
+
+  // Output benchmark results in JSON format.
+  if (!FLAGS_benchmark_output.empty()) {
+    string json = "{\n";
+    StringAppendF(&json, "  \"label\": %s,\n",
+                  JSONString(FLAGS_benchmark_label).c_str());
+    StringAppendF(&json, "  \"threads\": %d,\n", num_threads);
+    StringAppendF(&json, "  \"warmup\": %d,\n", num_warmup);
+    StringAppendF(&json, "  \"documents\": %lld,\n",
+                  static_cast<long long>(total.documents));
+    StringAppendF(&json, "  \"tokens\": %lld,\n",
+                  static_cast<long long>(total.tokens));
+    StringAppendF(&json, "  \"transitions\": %lld,\n",
+                  static_cast<long long>(total.transitions));
+    StringAppendF(&json, "  \"seconds\": %.6f,\n", secs);
+    StringAppendF(&json, "  \"tokens_per_sec\": %.3f,\n",
+                  total.tokens / secs);
+    StringAppendF(&json, "  \"docs_per_sec\": %.3f,\n",
+                  total.documents / secs);
+    StringAppendF(&json, "  \"us_per_transition\": %.6f,\n",
+                  total.transitions > 0
+                      ? total.busy * 1e6 / total.transitions : 0.0);
+    StringAppendF(&json, "  \"latency_ms\": {\"mean\": %.6f, "
+                  "\"p50\": %.6f, \"p90\": %.6f, \"p99\": %.6f, "
+                  "\"p999\": %.6f, \"max\": %.6f},\n",
+                  mean,
+                  Percentile(total.latency, 0.5),
+                  Percentile(total.latency, 0.9),
+                  Percentile(total.latency, 0.99),
+                  Percentile(total.latency, 0.999),
+                  total.latency.empty() ? 0.0 : total.latency.back());
+    StringAppendF(&json, "  \"allocations\": %lld,\n",
+                  static_cast<long long>(allocations));
+    StringAppendF(&json, "  \"allocated_bytes\": %lld,\n",
+                  static_cast<long long>(allocated));
+    if (parser->cache() != nullptr) {
+      ParseCache::Stats cache = parser->cache()->stats();
+      StringAppendF(&json, "  \"cache_hit_rate\": %.6f,\n",
+                    cache.hit_rate());
+    }
+    if (parser->feature_cache() != nullptr) {
+      FeatureCache::Stats cache = parser->feature_cache()->stats();
+      StringAppendF(&json, "  \"feature_cache_hit_rate\": %.6f,\n",
+                    cache.hit_rate());
+    }
+    StringAppendF(&json, "  \"rss_bytes\": %lld,\n",
+                  static_cast<long long>(ResidentMemory()));
+    StringAppendF(&json, "  \"peak_rss_bytes\": %lld\n",
+                  static_cast<long long>(PeakResidentMemory()));
+    json.append("}\n");
+    if (FLAGS_benchmark_output == "-") {
+      std::cout << json;
+    } else {
+      CHECK(File::WriteContents(FLAGS_benchmark_output, json));
+    }
+  }
+}
+
 int main(int argc, char *argv[]) {
   InitProgram(&argc, &argv);
 
@@ -136,6 +414,15 @@ int main(int argc, char *argv[]) {
   if (FLAGS_fast_fallback) parser.EnableFastFallback();
   if (FLAGS_profile) parser.EnableProfiling();
   if (FLAGS_gpu) parser.EnableGPU();
+  if (!FLAGS_action_mask) parser.DisableActionMask();
+  if (FLAGS_input_projection) {
+    parser.EnableInputProjection(FLAGS_input_projection_batch);
+  }
+  if (FLAGS_cache > 0) parser.EnableCache(FLAGS_cache);
+  if (FLAGS_feature_cache > 0) parser.EnableFeatureCache(FLAGS_feature_cache);
+  if (FLAGS_sentence_workers > 0) {
+    parser.EnableParallelSentences(FLAGS_sentence_workers);
+  }
   parser.Load(&commons, FLAGS_parser);
   commons.Freeze();
   clock.stop();
@@ -188,33 +475,7 @@ int main(int argc, char *argv[]) {
   // Benchmark parser on corpus.
   if (FLAGS_benchmark) {
     CHECK(!FLAGS_corpus.empty());
-    LOG(INFO) << "Benchmarking parser on " << FLAGS_corpus;
-    DocumentSource *corpus = DocumentSource::Create(FLAGS_corpus);
-    int num_documents = 0;
-    int num_tokens = 0;
-    clock.start();
-    for (;;) {
-      if (FLAGS_maxdocs != -1 && num_documents >= FLAGS_maxdocs) break;
-
-      Store store(&commons);
-      Document *document = corpus->Next(&store);
-      if (document == nullptr) break;
-
-      num_documents++;
-      num_tokens += document->num_tokens();
-      if (num_documents % 10 == 0) {
-        std::cout << num_documents << " documents\r";
-        std::cout.flush();
-      }
-      parser.Parse(document);
-
-      delete document;
-    }
-    clock.stop();
-    LOG(INFO) << num_documents << " documents, "
-              << num_tokens << " tokens, "
-              << num_tokens / clock.secs() << " tokens/sec";
-    delete corpus;
+    Benchmark(&parser, &commons);
   }
 
   // Evaluate parser on gold corpus.
@@ -238,9 +499,19 @@ int main(int argc, char *argv[]) {
 
   // Output profile report.
   if (FLAGS_profile) {
+    if (parser.profile()->lr_input != nullptr) {
+      myelin::Profile lr_input(parser.profile()->lr_input);
+      std::cout << lr_input.ASCIIReport() << "\n";
+    }
+
     myelin::Profile lr(&parser.profile()->lr);
     std::cout << lr.ASCIIReport() << "\n";
 
+    if (parser.profile()->rl_input != nullptr) {
+      myelin::Profile rl_input(parser.profile()->rl_input);
+      std::cout << rl_input.ASCIIReport() << "\n";
+    }
+
     myelin::Profile rl(&parser.profile()->rl);
     std::cout << rl.ASCIIReport() << "\n";
 
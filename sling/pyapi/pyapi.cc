@@ -17,6 +17,7 @@
 #include "sling/base/init.h"
 #include "sling/pyapi/pyarray.h"
 #include "sling/pyapi/pyframe.h"
+#include "sling/pyapi/pymyelin.h"
 #include "sling/pyapi/pyparser.h"
 #include "sling/pyapi/pyrecordio.h"
 #include "sling/pyapi/pystore.h"
@@ -44,6 +45,12 @@ static void RegisterPythonModule() {
   PyParser::Define(module);
   PyRecordReader::Define(module);
   PyRecordWriter::Define(module);
+  PyCompiler::Define(module);
+  PyNetwork::Define(module);
+  PyCell::Define(module);
+  PyInstance::Define(module);
+  PyChannel::Define(module);
+  PyTensor::Define(module);
 }
 
 }  // namespace sling
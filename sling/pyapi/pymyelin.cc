@@ -0,0 +1,723 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/pyapi/pymyelin.h"
+
+#include <string.h>
+
+#include "sling/myelin/flow.h"
+#include "sling/myelin/kernel/arithmetic.h"
+#include "sling/myelin/kernel/avx.h"
+#include "sling/myelin/kernel/dragnn.h"
+#include "sling/myelin/kernel/generic.h"
+#include "sling/myelin/kernel/precompute.h"
+#include "sling/myelin/kernel/sse.h"
+#include "sling/myelin/kernel/tensorflow.h"
+#include "sling/myelin/profile.h"
+
+namespace sling {
+
+using namespace myelin;
+
+// Kernel libraries that can be selected for the compiler.
+static const struct {
+  const char *name;
+  void (*Register)(Library *library);
+} kernel_libraries[] = {
+  {"tensorflow", RegisterTensorflowLibrary},
+  {"dragnn", RegisterDragnnLibrary},
+  {"generic", RegisterGenericLibrary},
+  {"sse", RegisterSSELibrary},
+  {"avx", RegisterAVXLibrary},
+  {"arithmetic", RegisterArithmeticLibrary},
+  {"precompute", RegisterPrecomputeLibrary},
+  {nullptr, nullptr},
+};
+
+// Return buffer format character for type or null if the type is not
+// supported by the buffer protocol.
+static const char *BufferFormat(Type type) {
+  switch (type) {
+    case DT_FLOAT: return "f";
+    case DT_DOUBLE: return "d";
+    case DT_INT64: return "q";
+    case DT_INT32: return "i";
+    case DT_INT16: return "h";
+    case DT_INT8: return "b";
+    case DT_UINT16: return "H";
+    case DT_UINT8: return "B";
+    case DT_BOOL: return "?";
+    default: return nullptr;
+  }
+}
+
+// Python type declarations.
+PyTypeObject PyCompiler::type;
+PyTypeObject PyNetwork::type;
+PyMappingMethods PyNetwork::mapping;
+PyTypeObject PyCell::type;
+PyTypeObject PyInstance::type;
+PyMappingMethods PyInstance::mapping;
+PyTypeObject PyChannel::type;
+PySequenceMethods PyChannel::sequence;
+PyTypeObject PyTensor::type;
+PyBufferProcs PyTensor::buffer;
+
+PyMethodDef PyCompiler::methods[] = {
+  {"compile", (PyCFunction) &PyCompiler::Compile, METH_KEYWORDS, ""},
+  {nullptr}
+};
+
+void PyCompiler::Define(PyObject *module) {
+  InitType(&type, "sling.api.Compiler", sizeof(PyCompiler), true);
+
+  type.tp_init = reinterpret_cast<initproc>(&PyCompiler::Init);
+  type.tp_dealloc = reinterpret_cast<destructor>(&PyCompiler::Dealloc);
+  type.tp_methods = methods;
+
+  RegisterType(&type, module, "Compiler");
+}
+
+int PyCompiler::Init(PyObject *args, PyObject *kwds) {
+  // Get arguments.
+  PyObject *names = nullptr;
+  if (!PyArg_ParseTuple(args, "|O", &names)) return -1;
+  library = new Library();
+
+  // Use the Tensorflow and Dragnn kernels by default.
+  if (names == nullptr) {
+    RegisterTensorflowLibrary(library);
+    RegisterDragnnLibrary(library);
+    return 0;
+  }
+
+  // Register selected kernel libraries.
+  PyObject *iter = PyObject_GetIter(names);
+  if (iter == nullptr) return -1;
+  PyObject *item;
+  while ((item = PyIter_Next(iter)) != nullptr) {
+    const char *name = PyString_AsString(item);
+    Py_DECREF(item);
+    if (name == nullptr) break;
+    bool found = false;
+    for (auto *lib = kernel_libraries; lib->name != nullptr; ++lib) {
+      if (strcmp(lib->name, name) == 0) {
+        lib->Register(library);
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      PyErr_Format(PyExc_ValueError, "Unknown kernel library: %s", name);
+      break;
+    }
+  }
+  Py_DECREF(iter);
+  return PyErr_Occurred() ? -1 : 0;
+}
+
+void PyCompiler::Dealloc() {
+  delete library;
+  Free();
+}
+
+PyObject *PyCompiler::Compile(PyObject *args, PyObject *kw) {
+  // Get arguments.
+  static const char *kwlist[] = {
+    "flow", "profiling", "dynamic", "parallel", nullptr
+  };
+  const char *filename;
+  bool profiling = false;
+  bool dynamic = false;
+  bool parallel = false;
+  if (!PyArg_ParseTupleAndKeywords(
+          args, kw, "s|bbb", const_cast<char **>(kwlist),
+          &filename, &profiling, &dynamic, &parallel)) {
+    return nullptr;
+  }
+
+  // Load flow.
+  Flow flow;
+  Status st = flow.Load(filename);
+  if (!st.ok()) {
+    PyErr_SetString(PyExc_IOError, st.message());
+    return nullptr;
+  }
+
+  // Analyze flow and compile network. The GIL is released while compiling.
+  Network *net = new Network();
+  net->set_profiling(profiling);
+  net->set_dynamic_allocation(dynamic);
+  net->set_parallel_compilation(parallel);
+  bool ok;
+  Py_BEGIN_ALLOW_THREADS;
+  flow.Analyze(*library);
+  ok = net->Compile(flow, *library);
+  Py_END_ALLOW_THREADS;
+  if (!ok) {
+    delete net;
+    PyErr_SetString(PyExc_RuntimeError, "Error compiling flow");
+    return nullptr;
+  }
+
+  // Create network wrapper.
+  PyNetwork *pynet = PyObject_New(PyNetwork, &PyNetwork::type);
+  pynet->Init(this, net);
+  return pynet->AsObject();
+}
+
+PyMethodDef PyNetwork::methods[] = {
+  {"channel", (PyCFunction) &PyNetwork::NewChannel, METH_VARARGS, ""},
+  {nullptr}
+};
+
+void PyNetwork::Define(PyObject *module) {
+  InitType(&type, "sling.Network", sizeof(PyNetwork), false);
+  type.tp_dealloc = reinterpret_cast<destructor>(&PyNetwork::Dealloc);
+  type.tp_methods = methods;
+
+  type.tp_as_mapping = &mapping;
+  mapping.mp_subscript = &PyNetwork::LookupCell;
+
+  RegisterType(&type, module, "Network");
+}
+
+void PyNetwork::Init(PyCompiler *pycompiler, Network *net) {
+  // Add reference to compiler to keep the kernels alive.
+  this->pycompiler = pycompiler;
+  Py_INCREF(pycompiler);
+  this->net = net;
+}
+
+void PyNetwork::Dealloc() {
+  delete net;
+  Py_DECREF(pycompiler);
+  Free();
+}
+
+PyObject *PyNetwork::LookupCell(PyObject *key) {
+  // Look up cell.
+  const char *name = PyString_AsString(key);
+  if (name == nullptr) return nullptr;
+  Cell *cell = net->GetCell(name);
+  if (cell == nullptr) {
+    PyErr_SetString(PyExc_KeyError, "Unknown cell");
+    return nullptr;
+  }
+
+  // Create cell wrapper.
+  PyCell *pycell = PyObject_New(PyCell, &PyCell::type);
+  pycell->Init(this, cell);
+  return pycell->AsObject();
+}
+
+PyObject *PyNetwork::NewChannel(PyObject *args) {
+  // Get arguments.
+  const char *name;
+  if (!PyArg_ParseTuple(args, "s", &name)) return nullptr;
+
+  // Look up connector.
+  Connector *connector = net->GetConnector(name);
+  if (connector == nullptr) {
+    PyErr_SetString(PyExc_KeyError, "Unknown connector");
+    return nullptr;
+  }
+
+  // Create channel wrapper.
+  PyChannel *pychannel = PyObject_New(PyChannel, &PyChannel::type);
+  pychannel->Init(this, connector);
+  return pychannel->AsObject();
+}
+
+PyMethodDef PyCell::methods[] = {
+  {"instance", (PyCFunction) &PyCell::NewInstance, METH_NOARGS, ""},
+  {nullptr}
+};
+
+void PyCell::Define(PyObject *module) {
+  InitType(&type, "sling.Cell", sizeof(PyCell), false);
+  type.tp_dealloc = reinterpret_cast<destructor>(&PyCell::Dealloc);
+  type.tp_str = &PyCell::Str;
+  type.tp_methods = methods;
+
+  RegisterType(&type, module, "Cell");
+}
+
+void PyCell::Init(PyNetwork *pynet, Cell *cell) {
+  // Add reference to network to keep it alive.
+  this->pynet = pynet;
+  Py_INCREF(pynet);
+  this->cell = cell;
+}
+
+void PyCell::Dealloc() {
+  Py_DECREF(pynet);
+  Free();
+}
+
+PyObject *PyCell::NewInstance() {
+  PyInstance *pyinstance = PyObject_New(PyInstance, &PyInstance::type);
+  pyinstance->Init(this);
+  return pyinstance->AsObject();
+}
+
+PyObject *PyCell::Str() {
+  string str = cell->ToString();
+  return PyString_FromStringAndSize(str.data(), str.size());
+}
+
+PyMethodDef PyInstance::methods[] = {
+  {"compute", (PyCFunction) &PyInstance::Compute, METH_NOARGS, ""},
+  {"clear", (PyCFunction) &PyInstance::Clear, METH_NOARGS, ""},
+  {"bind", (PyCFunction) &PyInstance::Bind, METH_VARARGS, ""},
+  {"link", (PyCFunction) &PyInstance::Link, METH_VARARGS, ""},
+  {"profile", (PyCFunction) &PyInstance::Profile, METH_NOARGS, ""},
+  {nullptr}
+};
+
+void PyInstance::Define(PyObject *module) {
+  InitType(&type, "sling.Instance", sizeof(PyInstance), false);
+  type.tp_dealloc = reinterpret_cast<destructor>(&PyInstance::Dealloc);
+  type.tp_str = &PyInstance::Str;
+  type.tp_methods = methods;
+
+  type.tp_as_mapping = &mapping;
+  mapping.mp_subscript = &PyInstance::LookupTensor;
+
+  RegisterType(&type, module, "Instance");
+}
+
+void PyInstance::Init(PyCell *pycell) {
+  // Add reference to cell to keep it alive.
+  this->pycell = pycell;
+  Py_INCREF(pycell);
+
+  // Create cell instance.
+  data = new Instance(pycell->cell);
+  bindings = new std::unordered_map<Tensor *, Py_buffer>();
+  links = new std::unordered_map<Tensor *, PyObject *>();
+  exports = 0;
+}
+
+void PyInstance::Dealloc() {
+  // Release bound objects.
+  while (!bindings->empty()) Unbind(bindings->begin()->first);
+  while (!links->empty()) Unbind(links->begin()->first);
+  delete bindings;
+  delete links;
+
+  // Delete instance.
+  delete data;
+
+  // Release reference to cell.
+  Py_DECREF(pycell);
+
+  // Free object.
+  Free();
+}
+
+Tensor *PyInstance::GetParameter(PyObject *key) {
+  const char *name = PyString_AsString(key);
+  if (name == nullptr) return nullptr;
+  Tensor *param = pycell->cell->GetParameter(name);
+  if (param == nullptr || param->cell() != pycell->cell) {
+    PyErr_SetString(PyExc_KeyError, "Unknown parameter");
+    return nullptr;
+  }
+  return param;
+}
+
+PyObject *PyInstance::LookupTensor(PyObject *key) {
+  // Look up parameter.
+  Tensor *param = GetParameter(key);
+  if (param == nullptr) return nullptr;
+
+  // Create tensor wrapper. The address of a reference parameter is looked up
+  // on each access, since the parameter can be rebound.
+  PyTensor *pytensor = PyObject_New(PyTensor, &PyTensor::type);
+  if (param->ref()) {
+    pytensor->Init(this, param);
+  } else {
+    pytensor->Init(AsObject(), data->GetAddress(param), param);
+  }
+  return pytensor->AsObject();
+}
+
+PyObject *PyInstance::Bind(PyObject *args) {
+  // Get arguments.
+  PyObject *key;
+  PyObject *obj;
+  if (!PyArg_ParseTuple(args, "OO", &key, &obj)) return nullptr;
+  Tensor *param = GetParameter(key);
+  if (param == nullptr) return nullptr;
+  if (!param->ref()) {
+    PyErr_SetString(PyExc_ValueError, "Parameter is not a reference");
+    return nullptr;
+  }
+
+  // Get buffer for object.
+  Py_buffer view;
+  if (PyObject_GetBuffer(obj, &view, PyBUF_RECORDS) == -1) return nullptr;
+
+  // Check that the buffer layout matches the parameter.
+  bool match = view.itemsize == param->element_size() &&
+               view.ndim == param->rank();
+  for (int d = 0; match && d < param->rank(); ++d) {
+    if (view.shape[d] != param->dim(d)) match = false;
+    if (view.shape[d] > 1 && view.strides[d] != param->stride(d)) {
+      match = false;
+    }
+  }
+  if (!match) {
+    PyBuffer_Release(&view);
+    PyErr_SetString(PyExc_ValueError, "Buffer layout does not match tensor");
+    return nullptr;
+  }
+  uintptr_t address = reinterpret_cast<uintptr_t>(view.buf);
+  if (address % param->byte_alignment() != 0) {
+    PyBuffer_Release(&view);
+    PyErr_SetString(PyExc_ValueError, "Buffer is not aligned");
+    return nullptr;
+  }
+
+  // Bind buffer to parameter.
+  if (!CheckRebindable()) {
+    PyBuffer_Release(&view);
+    return nullptr;
+  }
+  Unbind(param);
+  (*bindings)[param] = view;
+  data->SetReference(param, view.buf);
+
+  Py_RETURN_NONE;
+}
+
+PyObject *PyInstance::Link(PyObject *args) {
+  // Get arguments.
+  PyObject *key;
+  PyChannel *pychannel;
+  int index = 0;
+  if (!PyArg_ParseTuple(args, "OO|i", &key, &pychannel, &index)) {
+    return nullptr;
+  }
+  if (!PyObject_TypeCheck(pychannel, &PyChannel::type)) {
+    PyErr_SetString(PyExc_TypeError, "Channel expected");
+    return nullptr;
+  }
+  Tensor *param = GetParameter(key);
+  if (param == nullptr) return nullptr;
+  if (!param->ref()) {
+    PyErr_SetString(PyExc_ValueError, "Parameter is not a reference");
+    return nullptr;
+  }
+  if (index < 0 || index >= pychannel->channel->size()) {
+    PyErr_SetString(PyExc_IndexError, "Channel index out of bounds");
+    return nullptr;
+  }
+
+  // Link parameter to channel element. Keep a reference to the channel to
+  // keep it alive, and prevent resizing while the element is linked.
+  if (!CheckRebindable()) return nullptr;
+  Unbind(param);
+  Py_INCREF(pychannel);
+  pychannel->exports++;
+  (*links)[param] = pychannel->AsObject();
+  data->Set(param, pychannel->channel, index);
+
+  Py_RETURN_NONE;
+}
+
+void PyInstance::Unbind(Tensor *param) {
+  auto b = bindings->find(param);
+  if (b != bindings->end()) {
+    PyBuffer_Release(&b->second);
+    bindings->erase(b);
+  }
+  auto l = links->find(param);
+  if (l != links->end()) {
+    reinterpret_cast<PyChannel *>(l->second)->exports--;
+    Py_DECREF(l->second);
+    links->erase(l);
+  }
+}
+
+bool PyInstance::CheckRebindable() {
+  if (exports > 0) {
+    PyErr_SetString(PyExc_BufferError,
+                    "Reference parameters are in use by buffers");
+    return false;
+  }
+  return true;
+}
+
+PyObject *PyInstance::Compute() {
+  Py_BEGIN_ALLOW_THREADS;
+  data->Compute();
+  Py_END_ALLOW_THREADS;
+  Py_RETURN_NONE;
+}
+
+PyObject *PyInstance::Clear() {
+  // Clearing the instance also clears the reference parameters, so all bound
+  // objects are released.
+  if (!CheckRebindable()) return nullptr;
+  while (!bindings->empty()) Unbind(bindings->begin()->first);
+  while (!links->empty()) Unbind(links->begin()->first);
+  data->Clear();
+  Py_RETURN_NONE;
+}
+
+PyObject *PyInstance::Profile() {
+  if (pycell->cell->profile() == nullptr) {
+    PyErr_SetString(PyExc_ValueError, "Profiling not enabled");
+    return nullptr;
+  }
+  myelin::Profile profile(data);
+  string report = profile.ASCIIReport();
+  return PyString_FromStringAndSize(report.data(), report.size());
+}
+
+PyObject *PyInstance::Str() {
+  string str = data->ToString();
+  return PyString_FromStringAndSize(str.data(), str.size());
+}
+
+PyMethodDef PyChannel::methods[] = {
+  {"resize", (PyCFunction) &PyChannel::Resize, METH_VARARGS, ""},
+  {"push", (PyCFunction) &PyChannel::Push, METH_NOARGS, ""},
+  {nullptr}
+};
+
+void PyChannel::Define(PyObject *module) {
+  InitType(&type, "sling.Channel", sizeof(PyChannel), false);
+  type.tp_dealloc = reinterpret_cast<destructor>(&PyChannel::Dealloc);
+  type.tp_methods = methods;
+
+  type.tp_as_sequence = &sequence;
+  sequence.sq_length = &PyChannel::Size;
+  sequence.sq_item = &PyChannel::GetItem;
+
+  RegisterType(&type, module, "Channel");
+}
+
+void PyChannel::Init(PyNetwork *pynet, Connector *connector) {
+  // Add reference to network to keep it alive.
+  this->pynet = pynet;
+  Py_INCREF(pynet);
+  this->connector = connector;
+  channel = new Channel(connector);
+  exports = 0;
+}
+
+void PyChannel::Dealloc() {
+  delete channel;
+  Py_DECREF(pynet);
+  Free();
+}
+
+Py_ssize_t PyChannel::Size() {
+  return channel->size();
+}
+
+PyObject *PyChannel::GetItem(Py_ssize_t index) {
+  // Check channel bounds.
+  if (index < 0 || index >= channel->size()) {
+    PyErr_SetString(PyExc_IndexError, "Channel index out of bounds");
+    return nullptr;
+  }
+
+  // Create tensor wrapper for channel element.
+  PyTensor *pytensor = PyObject_New(PyTensor, &PyTensor::type);
+  pytensor->Init(this, index);
+  return pytensor->AsObject();
+}
+
+PyObject *PyChannel::Resize(PyObject *args) {
+  int size;
+  if (!PyArg_ParseTuple(args, "i", &size)) return nullptr;
+  if (size < 0) {
+    PyErr_SetString(PyExc_ValueError, "Invalid channel size");
+    return nullptr;
+  }
+  if (!CheckResizable()) return nullptr;
+  channel->resize(size);
+  Py_RETURN_NONE;
+}
+
+PyObject *PyChannel::Push() {
+  if (!CheckResizable()) return nullptr;
+  channel->push();
+  return GetItem(channel->size() - 1);
+}
+
+bool PyChannel::CheckResizable() {
+  if (exports > 0) {
+    PyErr_SetString(PyExc_BufferError,
+                    "Channel elements are in use by buffers or instances");
+    return false;
+  }
+  return true;
+}
+
+PyMethodDef PyTensor::methods[] = {
+  {"shape", (PyCFunction) &PyTensor::Shape, METH_NOARGS, ""},
+  {"type", (PyCFunction) &PyTensor::Type, METH_NOARGS, ""},
+  {nullptr}
+};
+
+void PyTensor::Define(PyObject *module) {
+  InitType(&type, "sling.Tensor", sizeof(PyTensor), false);
+  type.tp_dealloc = reinterpret_cast<destructor>(&PyTensor::Dealloc);
+  type.tp_str = &PyTensor::Str;
+  type.tp_methods = methods;
+
+  type.tp_as_buffer = &buffer;
+  type.tp_flags |= Py_TPFLAGS_HAVE_NEWBUFFER;
+  buffer.bf_getbuffer = &PyTensor::GetBuffer;
+  buffer.bf_releasebuffer = &PyTensor::ReleaseBuffer;
+
+  RegisterType(&type, module, "Tensor");
+}
+
+void PyTensor::Init(PyObject *owner, char *data, const Tensor *format) {
+  // Add reference to owner to keep the data alive.
+  this->owner = owner;
+  Py_INCREF(owner);
+  this->data = data;
+  this->format = format;
+  pychannel = nullptr;
+  index = 0;
+  pyinstance = nullptr;
+  param = nullptr;
+
+  // Set up shape and strides for buffer views. Connector types have an
+  // unspecified first dimension, which is one for a single channel element.
+  int rank = format->rank();
+  shape = new Py_ssize_t[rank];
+  strides = new Py_ssize_t[rank];
+  for (int d = 0; d < rank; ++d) {
+    shape[d] = format->dim(d) == -1 ? 1 : format->dim(d);
+    strides[d] = format->stride(d);
+  }
+}
+
+void PyTensor::Init(PyChannel *pychannel, int index) {
+  Init(pychannel->AsObject(), nullptr, pychannel->connector->type());
+  this->pychannel = pychannel;
+  this->index = index;
+}
+
+void PyTensor::Init(PyInstance *pyinstance, Tensor *param) {
+  Init(pyinstance->AsObject(), nullptr, param);
+  this->pyinstance = pyinstance;
+  this->param = param;
+}
+
+void PyTensor::Dealloc() {
+  delete [] shape;
+  delete [] strides;
+  Py_DECREF(owner);
+  Free();
+}
+
+PyObject *PyTensor::Str() {
+  string str = format->TypeString() + " " + format->name();
+  return PyString_FromStringAndSize(str.data(), str.size());
+}
+
+PyObject *PyTensor::Shape() {
+  int rank = format->rank();
+  PyObject *tuple = PyTuple_New(rank);
+  for (int d = 0; d < rank; ++d) {
+    PyTuple_SET_ITEM(tuple, d, PyInt_FromLong(shape[d]));
+  }
+  return tuple;
+}
+
+PyObject *PyTensor::Type() {
+  const string &name = TypeTraits::of(format->type()).name();
+  return PyString_FromStringAndSize(name.data(), name.size());
+}
+
+int PyTensor::GetBuffer(Py_buffer *view, int flags) {
+  // Check that tensor type is supported.
+  const char *fmt = BufferFormat(format->type());
+  if (fmt == nullptr) {
+    PyErr_SetString(PyExc_BufferError, "Unsupported tensor type");
+    return -1;
+  }
+
+  // Tensors with padding or column-major order can only be accessed through
+  // strided buffers.
+  int rank = format->rank();
+  bool contiguous = true;
+  Py_ssize_t size = format->element_size();
+  for (int d = rank - 1; d >= 0; --d) {
+    if (shape[d] > 1 && strides[d] != size) contiguous = false;
+    size *= shape[d];
+  }
+  if (!contiguous && (flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+    PyErr_SetString(PyExc_BufferError, "Tensor is not contiguous");
+    return -1;
+  }
+
+  // Get tensor data.
+  char *ptr = GetData();
+  if (ptr == nullptr) return -1;
+
+  // Fill in buffer view. Channel elements cannot be moved and reference
+  // parameters cannot be rebound while there are buffer views for them.
+  if (pychannel != nullptr) pychannel->exports++;
+  if (pyinstance != nullptr) pyinstance->exports++;
+  view->buf = ptr;
+  view->obj = AsObject();
+  Py_INCREF(view->obj);
+  view->len = size;
+  view->readonly = 0;
+  view->itemsize = format->element_size();
+  view->format = (flags & PyBUF_FORMAT) ? const_cast<char *>(fmt) : nullptr;
+  view->ndim = rank;
+  view->shape = (flags & PyBUF_ND) == PyBUF_ND ? shape : nullptr;
+  view->strides =
+      (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? strides : nullptr;
+  view->suboffsets = nullptr;
+  view->internal = nullptr;
+  return 0;
+}
+
+void PyTensor::ReleaseBuffer(Py_buffer *view) {
+  // The buffer view does not own any memory.
+  if (pychannel != nullptr) pychannel->exports--;
+  if (pyinstance != nullptr) pyinstance->exports--;
+}
+
+char *PyTensor::GetData() {
+  if (pychannel != nullptr) {
+    if (index >= pychannel->channel->size()) {
+      PyErr_SetString(PyExc_IndexError, "Channel element no longer exists");
+      return nullptr;
+    }
+    return pychannel->channel->at(index);
+  }
+  if (pyinstance != nullptr) {
+    char *ptr = *reinterpret_cast<char **>(pyinstance->data->GetAddress(param));
+    if (ptr == nullptr) {
+      PyErr_SetString(PyExc_ValueError, "Reference parameter is not bound");
+    }
+    return ptr;
+  }
+  return data;
+}
+
+}  // namespace sling
@@ -0,0 +1,277 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_PYAPI_PYMYELIN_H_
+#define SLING_PYAPI_PYMYELIN_H_
+
+#include <unordered_map>
+
+#include "sling/myelin/compute.h"
+#include "sling/pyapi/pybase.h"
+
+namespace sling {
+
+// Python wrapper for Myelin compiler.
+struct PyCompiler : public PyBase {
+  // Initialize compiler wrapper. The optional argument is a list of names of
+  // the kernel libraries to use for compiling flows.
+  int Init(PyObject *args, PyObject *kwds);
+
+  // Deallocate compiler wrapper.
+  void Dealloc();
+
+  // Load flow from file and compile it into a network.
+  PyObject *Compile(PyObject *args, PyObject *kw);
+
+  // Kernel library for compiling flows.
+  myelin::Library *library;
+
+  // Registration.
+  static PyTypeObject type;
+  static PyMethodDef methods[];
+  static void Define(PyObject *module);
+};
+
+// Python wrapper for Myelin network.
+struct PyNetwork : public PyBase {
+  // Initialize network wrapper.
+  void Init(PyCompiler *pycompiler, myelin::Network *net);
+
+  // Deallocate network wrapper.
+  void Dealloc();
+
+  // Return cell in network.
+  PyObject *LookupCell(PyObject *key);
+
+  // Create new channel for connector.
+  PyObject *NewChannel(PyObject *args);
+
+  // Compiler used for compiling the network. This keeps the kernels alive.
+  PyCompiler *pycompiler;
+
+  // Compiled network.
+  myelin::Network *net;
+
+  // Registration.
+  static PyTypeObject type;
+  static PyMappingMethods mapping;
+  static PyMethodDef methods[];
+  static void Define(PyObject *module);
+};
+
+// Python wrapper for Myelin cell.
+struct PyCell : public PyBase {
+  // Initialize cell wrapper.
+  void Init(PyNetwork *pynet, myelin::Cell *cell);
+
+  // Deallocate cell wrapper.
+  void Dealloc();
+
+  // Create new instance of cell.
+  PyObject *NewInstance();
+
+  // Return cell in text format.
+  PyObject *Str();
+
+  // Network for cell.
+  PyNetwork *pynet;
+
+  // Compiled cell.
+  myelin::Cell *cell;
+
+  // Registration.
+  static PyTypeObject type;
+  static PyMethodDef methods[];
+  static void Define(PyObject *module);
+};
+
+// Python wrapper for Myelin cell instance.
+struct PyInstance : public PyBase {
+  // Initialize instance wrapper.
+  void Init(PyCell *pycell);
+
+  // Deallocate instance wrapper.
+  void Dealloc();
+
+  // Return parameter tensor in instance.
+  PyObject *LookupTensor(PyObject *key);
+
+  // Bind an object supporting the buffer protocol to a reference parameter.
+  // The object is used in the computation without copying, so it must keep
+  // its layout until it is unbound or the instance is deleted.
+  PyObject *Bind(PyObject *args);
+
+  // Link reference parameter to element in channel.
+  PyObject *Link(PyObject *args);
+
+  // Run cell computation. The GIL is released during the computation.
+  PyObject *Compute();
+
+  // Clear instance.
+  PyObject *Clear();
+
+  // Return profile report for instance.
+  PyObject *Profile();
+
+  // Return all parameters in text format.
+  PyObject *Str();
+
+  // Release object bound to reference parameter.
+  void Unbind(myelin::Tensor *param);
+
+  // Get parameter in cell. Sets Python error if the parameter is unknown.
+  myelin::Tensor *GetParameter(PyObject *key);
+
+  // Check that the reference parameters can be rebound. Sets Python error if
+  // reference parameters are in use by buffer views.
+  bool CheckRebindable();
+
+  // Cell for instance.
+  PyCell *pycell;
+
+  // Cell instance.
+  myelin::Instance *data;
+
+  // Buffers bound to reference parameters.
+  std::unordered_map<myelin::Tensor *, Py_buffer> *bindings;
+
+  // Objects linked to reference parameters.
+  std::unordered_map<myelin::Tensor *, PyObject *> *links;
+
+  // Number of buffer views for reference parameters. The reference parameters
+  // cannot be rebound while they are in use, because the buffer views refer
+  // to the bound objects.
+  int exports;
+
+  // Registration.
+  static PyTypeObject type;
+  static PyMappingMethods mapping;
+  static PyMethodDef methods[];
+  static void Define(PyObject *module);
+};
+
+// Python wrapper for Myelin channel.
+struct PyChannel : public PyBase {
+  // Initialize channel wrapper.
+  void Init(PyNetwork *pynet, myelin::Connector *connector);
+
+  // Deallocate channel wrapper.
+  void Dealloc();
+
+  // Return the number of elements in channel.
+  Py_ssize_t Size();
+
+  // Get element in channel.
+  PyObject *GetItem(Py_ssize_t index);
+
+  // Change size of channel.
+  PyObject *Resize(PyObject *args);
+
+  // Add element to channel and return it.
+  PyObject *Push();
+
+  // Check that the channel can be resized. Sets Python error if elements are
+  // in use by buffer views or linked instances.
+  bool CheckResizable();
+
+  // Network for channel.
+  PyNetwork *pynet;
+
+  // Connector for channel elements.
+  myelin::Connector *connector;
+
+  // Channel.
+  myelin::Channel *channel;
+
+  // Number of buffer views and instance links referring to channel elements.
+  // The channel cannot be resized while elements are in use, because resizing
+  // can move the elements.
+  int exports;
+
+  // Registration.
+  static PyTypeObject type;
+  static PySequenceMethods sequence;
+  static PyMethodDef methods[];
+  static void Define(PyObject *module);
+};
+
+// Python wrapper for tensor data in an instance or channel. The tensor
+// supports the buffer protocol, so it can be accessed as a numpy array
+// without copying the data.
+struct PyTensor : public PyBase {
+  // Initialize tensor wrapper.
+  void Init(PyObject *owner, char *data, const myelin::Tensor *format);
+
+  // Initialize tensor wrapper for channel element.
+  void Init(PyChannel *pychannel, int index);
+
+  // Initialize tensor wrapper for reference parameter in instance.
+  void Init(PyInstance *pyinstance, myelin::Tensor *param);
+
+  // Deallocate tensor wrapper.
+  void Dealloc();
+
+  // Return tensor in text format.
+  PyObject *Str();
+
+  // Return tensor shape as tuple.
+  PyObject *Shape();
+
+  // Return tensor type name.
+  PyObject *Type();
+
+  // Fill in buffer view for tensor.
+  int GetBuffer(Py_buffer *view, int flags);
+
+  // Release buffer view for tensor.
+  void ReleaseBuffer(Py_buffer *view);
+
+  // Return address of tensor data. Sets Python error if the channel element
+  // no longer exists or the reference parameter is not bound.
+  char *GetData();
+
+  // Object owning the data, i.e. an instance or a channel.
+  PyObject *owner;
+
+  // Tensor data for instance tensors.
+  char *data;
+
+  // Channel and element index for channel tensors. The address of the element
+  // is looked up on each access, because the channel buffer can move.
+  PyChannel *pychannel;
+  int index;
+
+  // Instance and parameter for reference parameter tensors. The address of
+  // the bound object is looked up on each access, because the parameter can
+  // be rebound.
+  PyInstance *pyinstance;
+  myelin::Tensor *param;
+
+  // Tensor format.
+  const myelin::Tensor *format;
+
+  // Shape and strides for buffer views.
+  Py_ssize_t *shape;
+  Py_ssize_t *strides;
+
+  // Registration.
+  static PyTypeObject type;
+  static PyBufferProcs buffer;
+  static PyMethodDef methods[];
+  static void Define(PyObject *module);
+};
+
+}  // namespace sling
+
+#endif  // SLING_PYAPI_PYMYELIN_H_
@@ -0,0 +1,67 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sling/util/thread.h"
+
+namespace sling {
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  nonempty_.notify_all();
+  for (auto &t : workers_) t.join();
+}
+
+void ThreadPool::Start() {
+  for (int i = 0; i < num_workers_; ++i) {
+    workers_.emplace_back([this]() { Worker(); });
+  }
+}
+
+void ThreadPool::Schedule(Closure closure) {
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    queue_.push_back(std::move(closure));
+  }
+  nonempty_.notify_one();
+}
+
+void ThreadPool::Worker() {
+  for (;;) {
+    Closure closure;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      nonempty_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) return;
+      closure = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    closure();
+  }
+}
+
+void Barrier::Done() {
+  std::unique_lock<std::mutex> lock(mu_);
+  if (--count_ == 0) done_.notify_all();
+}
+
+void Barrier::Wait() {
+  std::unique_lock<std::mutex> lock(mu_);
+  done_.wait(lock, [this]() { return count_ <= 0; });
+}
+
+}  // namespace sling
+
@@ -0,0 +1,160 @@
+// Copyright 2017 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SLING_UTIL_THREAD_H_
+#define SLING_UTIL_THREAD_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sling/base/logging.h"
+#include "sling/base/types.h"
+
+namespace sling {
+
+// Pool of worker threads executing closures from a shared queue.
+class ThreadPool {
+ public:
+  typedef std::function<void()> Closure;
+
+  // Initialize pool with a number of worker threads.
+  explicit ThreadPool(int num_workers) : num_workers_(num_workers) {}
+
+  // Wait for all scheduled closures to complete and stop the workers.
+  ~ThreadPool();
+
+  // Start worker threads.
+  void Start();
+
+  // Schedule closure for execution by one of the workers.
+  void Schedule(Closure closure);
+
+  // Number of worker threads.
+  int num_workers() const { return num_workers_; }
+
+ private:
+  // Worker thread loop.
+  void Worker();
+
+  // Number of worker threads.
+  int num_workers_;
+
+  // Worker threads.
+  std::vector<std::thread> workers_;
+
+  // Queue of closures waiting to be executed.
+  std::deque<Closure> queue_;
+
+  // Set when workers should terminate after the queue has been drained.
+  bool stop_ = false;
+
+  // Mutex and condition variable for protecting the queue.
+  std::mutex mu_;
+  std::condition_variable nonempty_;
+};
+
+// Completion counter for waiting on a number of scheduled tasks.
+class Barrier {
+ public:
+  explicit Barrier(int count) : count_(count) {}
+
+  // Signal that one task has completed.
+  void Done();
+
+  // Wait until all tasks have completed.
+  void Wait();
+
+ private:
+  int count_;
+  std::mutex mu_;
+  std::condition_variable done_;
+};
+
+// Bounded queue for passing elements between threads. Producers block when
+// the queue is full and consumers block when it is empty. The queue is closed
+// when all the producers are done, and consumers then drain the remaining
+// elements.
+template <typename T> class BoundedQueue {
+ public:
+  // Initialize queue with a maximum number of elements and a number of
+  // producers.
+  BoundedQueue(int capacity, int producers = 1)
+      : capacity_(capacity), producers_(producers) {
+    CHECK_GT(capacity, 0);
+  }
+
+  // Add element to queue. This blocks if the queue is full.
+  void Put(T element) {
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      CHECK_GT(producers_, 0) << "Queue has been closed";
+      nonfull_.wait(lock, [this]() { return elements_.size() < capacity_; });
+      elements_.push_back(std::move(element));
+    }
+    nonempty_.notify_one();
+  }
+
+  // Remove element from queue. This blocks if the queue is empty. Returns
+  // false when the queue is empty and all the producers are done.
+  bool Get(T *element) {
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      nonempty_.wait(lock, [this]() {
+        return !elements_.empty() || producers_ == 0;
+      });
+      if (elements_.empty()) return false;
+      *element = std::move(elements_.front());
+      elements_.pop_front();
+    }
+    nonfull_.notify_one();
+    return true;
+  }
+
+  // Signal that a producer is done.
+  void Close() {
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      CHECK_GT(producers_, 0);
+      producers_--;
+    }
+    nonempty_.notify_all();
+  }
+
+  // Maximum number of elements in queue.
+  int capacity() const { return capacity_; }
+
+ private:
+  // Elements in queue.
+  std::deque<T> elements_;
+
+  // Maximum number of elements in queue.
+  int capacity_;
+
+  // Number of producers that are not done yet.
+  int producers_;
+
+  // Mutex and condition variables for protecting the queue.
+  std::mutex mu_;
+  std::condition_variable nonempty_;
+  std::condition_variable nonfull_;
+};
+
+}  // namespace sling
+
+#endif  // SLING_UTIL_THREAD_H_
+